@@ -127,6 +127,13 @@ if(OPTION_USE_POLL)
    CHECK_FUNCTION_EXISTS(poll USE_POLL)
 endif(OPTION_USE_POLL)
 
+option(OPTION_USE_EPOLL "use epoll if available" ON)
+mark_as_advanced(OPTION_USE_EPOLL)
+
+if(OPTION_USE_EPOLL)
+   CHECK_FUNCTION_EXISTS(epoll_create1 USE_EPOLL)
+endif(OPTION_USE_EPOLL)
+
 #######################################################################
 option(OPTION_BUILD_SHARED_LIBS
     "Build shared libraries(in addition to static libraries)"
@@ -546,6 +553,18 @@ else()
    set(FLTK_XDBE_FOUND FALSE)
 endif(OPTION_USE_XDBE AND HAVE_XDBE_H)
 
+#######################################################################
+if(X11_FOUND)
+   option(OPTION_USE_XSHM "use the X shared memory extension" ON)
+endif(X11_FOUND)
+
+if(OPTION_USE_XSHM AND HAVE_XSHM_H AND X11_Xext_FOUND)
+   set(HAVE_XSHM 1)
+   set(FLTK_XSHM_FOUND TRUE)
+else()
+   set(FLTK_XSHM_FOUND FALSE)
+endif(OPTION_USE_XSHM AND HAVE_XSHM_H AND X11_Xext_FOUND)
+
 #######################################################################
 set(FL_NO_PRINT_SUPPORT FALSE)
 if(X11_FOUND AND NOT OPTION_PRINT_SUPPORT)
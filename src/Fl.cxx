@@ -2023,6 +2023,11 @@ int Fl::clipboard_contains(const char *type)
  FL_READ, FL_WRITE, and FL_EXCEPT defined,
  to indicate when the callback should be done.
 
+ Adding FL_EDGE requests edge-triggered notification: the callback is
+ done when the fd becomes ready, not as long as it is ready, so it must
+ read or write until the operation would block. This is supported by
+ the epoll backend on Linux and ignored on other platforms.
+
  There can only be one callback of each type for a file descriptor.
  Fl::remove_fd() gets rid of <I>all</I> the callbacks for a given
  file descriptor.
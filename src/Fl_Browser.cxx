@@ -32,7 +32,7 @@
 // so that the number of items in the browser and size of those items
 // is unlimited. The only problem is that the old browser used an
 // index number to identify a line, and it is slow to convert from/to
-// a pointer. I use a cache of the last match to try to speed this up.
+// a pointer. The lines are therefore also kept in an index, see below.
 
 // Also added the ability to "hide" a line. This sets its height to
 // zero, so the Fl_Browser_ cannot pick it.
@@ -40,6 +40,15 @@
 #define SELECTED 1
 #define NOTDISPLAYED 2
 
+// In virtual mode (line_cb_ set) there are no FL_BLINEs, the items are
+// the line numbers cast to pointers, all lines have the height line_h_
+// and their selection is kept in the bit array selected_bits_.
+
+#define VLINE(item) ((int)(fl_intptr_t)(item))
+#define VITEM(line) ((void*)(fl_intptr_t)(line))
+
+struct FL_BCHUNK;
+
 // WARNING:
 //       Fl_File_Chooser.cxx also has a definition of this structure (FL_BLINE).
 //       Changes to FL_BLINE *must* be reflected in Fl_File_Chooser.cxx as well.
@@ -50,11 +59,194 @@ struct FL_BLINE {	// data is in a linked list of these
   FL_BLINE* next;
   void* data;
   Fl_Image* icon;
+  FL_BCHUNK* chunk;	// index chunk holding this line
+  int height;		// height of this line in the index
   short length;		// sizeof(txt)-1, may be longer than string
   char flags;		// selected, displayed
   char txt[1];		// start of allocated array
 };
 
+// The line index: the lines are also stored, in list order, in an array
+// of chunks of up to FL_BCHUNK_SIZE lines each. Two Fenwick trees over
+// the chunks hold the number of lines and the height of each chunk, so
+// that finding a line by number or by y position, and the number or y
+// position of a line, only takes a tree descent and a search in one
+// chunk. Adding or removing a chunk marks the trees dirty, they are
+// rebuilt by the next lookup.
+
+#define FL_BCHUNK_SIZE 256
+
+struct FL_BCHUNK {
+  int n;			// number of lines
+  int height;			// sum of their heights
+  int index;			// position in FL_BINDEX::chunk, if not dirty
+  FL_BLINE* line[FL_BCHUNK_SIZE];
+};
+
+struct FL_BINDEX {
+  FL_BCHUNK** chunk;		// the chunks in list order
+  int nchunks, alloc;
+  int* count_tree;		// Fenwick tree of the chunk sizes (1 based)
+  int* height_tree;		// Fenwick tree of the chunk heights (1 based)
+  int top;			// highest power of 2 <= nchunks
+  int dirty;			// trees and FL_BCHUNK::index must be rebuilt
+};
+
+static void index_build(FL_BINDEX* x) {
+  if (!x->dirty) return;
+  int n = x->nchunks;
+  for (int i = 1; i <= n; i++) {
+    x->chunk[i-1]->index = i-1;
+    x->count_tree[i] = x->chunk[i-1]->n;
+    x->height_tree[i] = x->chunk[i-1]->height;
+  }
+  for (int i = 1; i <= n; i++) {
+    int j = i + (i & -i);
+    if (j <= n) {
+      x->count_tree[j] += x->count_tree[i];
+      x->height_tree[j] += x->height_tree[i];
+    }
+  }
+  for (x->top = 1; x->top*2 <= n; x->top *= 2) {}
+  x->dirty = 0;
+}
+
+// chunk c got dn more lines and dh more pixels:
+static void index_update(FL_BINDEX* x, FL_BCHUNK* c, int dn, int dh) {
+  c->n += dn;
+  c->height += dh;
+  if (x->dirty) return;
+  for (int i = c->index+1; i <= x->nchunks; i += i & -i) {
+    x->count_tree[i] += dn;
+    x->height_tree[i] += dh;
+  }
+}
+
+// sums of the chunks before chunk i, trees must be built:
+static int index_count_before(const FL_BINDEX* x, int i) {
+  int s = 0;
+  for (; i > 0; i -= i & -i) s += x->count_tree[i];
+  return s;
+}
+
+static int index_height_before(const FL_BINDEX* x, int i) {
+  int s = 0;
+  for (; i > 0; i -= i & -i) s += x->height_tree[i];
+  return s;
+}
+
+// insert an empty chunk at position i:
+static FL_BCHUNK* index_new_chunk(FL_BINDEX* x, int i) {
+  if (x->nchunks >= x->alloc) {
+    x->alloc = x->alloc ? 2*x->alloc : 16;
+    x->chunk = (FL_BCHUNK**)realloc(x->chunk, x->alloc*sizeof(FL_BCHUNK*));
+    x->count_tree = (int*)realloc(x->count_tree, (x->alloc+1)*sizeof(int));
+    x->height_tree = (int*)realloc(x->height_tree, (x->alloc+1)*sizeof(int));
+  }
+  FL_BCHUNK* c = (FL_BCHUNK*)malloc(sizeof(FL_BCHUNK));
+  c->n = c->height = 0;
+  c->index = i;
+  memmove(x->chunk+i+1, x->chunk+i, (x->nchunks-i)*sizeof(FL_BCHUNK*));
+  x->chunk[i] = c;
+  x->nchunks++;
+  if (i < x->nchunks-1) {
+    x->dirty = 1;
+  } else if (!x->dirty) {
+    // appending only needs the new tree node, which sums the chunks
+    // lo+1 .. k, the last of them being the new, empty one:
+    int k = x->nchunks, lo = k - (k & -k);
+    x->count_tree[k] = index_count_before(x, k-1) - index_count_before(x, lo);
+    x->height_tree[k] = index_height_before(x, k-1) - index_height_before(x, lo);
+    if (!x->top) x->top = 1;
+    else if (x->top*2 <= k) x->top *= 2;
+  }
+  return c;
+}
+
+static void index_delete_chunk(FL_BINDEX* x, FL_BCHUNK* c) {
+  index_build(x);
+  int i = c->index;
+  memmove(x->chunk+i, x->chunk+i+1, (x->nchunks-i-1)*sizeof(FL_BCHUNK*));
+  x->nchunks--;
+  x->dirty = 1;
+  free(c);
+}
+
+static int index_slot(const FL_BLINE* l) {
+  FL_BCHUNK* c = l->chunk;
+  int i = 0;
+  while (c->line[i] != l) i++;
+  return i;
+}
+
+// insert item with height h before line b, or at the end if b is NULL:
+static void index_insert(FL_BINDEX* x, FL_BLINE* item, FL_BLINE* b, int h) {
+  FL_BCHUNK* c;
+  int i;
+  if (b) {
+    c = b->chunk;
+    i = index_slot(b);
+  } else {
+    if (!x->nchunks) index_new_chunk(x, 0);
+    c = x->chunk[x->nchunks-1];
+    i = c->n;
+  }
+  if (c->n == FL_BCHUNK_SIZE) {
+    index_build(x);
+    if (i == FL_BCHUNK_SIZE) {
+      // appending to a full chunk starts the next one:
+      c = index_new_chunk(x, c->index+1);
+      i = 0;
+    } else {
+      // split the chunk in two halves:
+      FL_BCHUNK* d = index_new_chunk(x, c->index+1);
+      int k = FL_BCHUNK_SIZE/2, dh = 0;
+      d->n = FL_BCHUNK_SIZE-k;
+      memcpy(d->line, c->line+k, d->n*sizeof(FL_BLINE*));
+      for (int j = 0; j < d->n; j++) {
+        d->line[j]->chunk = d;
+        dh += d->line[j]->height;
+      }
+      d->height = dh;
+      c->n = k;
+      c->height -= dh;
+      x->dirty = 1;
+      if (i > k) {c = d; i -= k;}
+    }
+  }
+  memmove(c->line+i+1, c->line+i, (c->n-i)*sizeof(FL_BLINE*));
+  c->line[i] = item;
+  item->height = h;
+  item->chunk = c;
+  index_update(x, c, 1, h);
+}
+
+// remove item from the index and return its height:
+static int index_remove(FL_BINDEX* x, FL_BLINE* item) {
+  FL_BCHUNK* c = item->chunk;
+  int i = index_slot(item);
+  int h = item->height;
+  memmove(c->line+i, c->line+i+1, (c->n-i-1)*sizeof(FL_BLINE*));
+  index_update(x, c, -1, -h);
+  if (!c->n) {
+    index_delete_chunk(x, c);
+  } else if (c->n < FL_BCHUNK_SIZE/4) {
+    // merge small chunks with the previous one so they don't pile up:
+    index_build(x);
+    if (c->index > 0) {
+      FL_BCHUNK* p = x->chunk[c->index-1];
+      if (p->n + c->n <= FL_BCHUNK_SIZE/2) {
+        memcpy(p->line+p->n, c->line, c->n*sizeof(FL_BLINE*));
+        for (int j = 0; j < c->n; j++) c->line[j]->chunk = p;
+        p->n += c->n;
+        p->height += c->height;
+        index_delete_chunk(x, c);
+      }
+    }
+  }
+  return h;
+}
+
 /**
   Returns the very first item in the list.
   Example of use:
@@ -67,7 +259,10 @@ struct FL_BLINE {	// data is in a linked list of these
   \returns The first item, or NULL if list is empty.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_first() const {return first;}
+void* Fl_Browser::item_first() const {
+  if (line_cb_) return lines ? VITEM(1) : 0;
+  return first;
+}
 
 /**
   Returns the next item after \p item.
@@ -75,7 +270,10 @@ void* Fl_Browser::item_first() const {return first;}
   \returns The next item after \p item, or NULL if there are none after this one.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_next(void* item) const {return ((FL_BLINE*)item)->next;}
+void* Fl_Browser::item_next(void* item) const {
+  if (line_cb_) return VLINE(item) < lines ? VITEM(VLINE(item)+1) : 0;
+  return ((FL_BLINE*)item)->next;
+}
 
 /**
   Returns the previous item before \p item.
@@ -83,7 +281,10 @@ void* Fl_Browser::item_next(void* item) const {return ((FL_BLINE*)item)->next;}
   \returns The previous item before \p item, or NULL if there are none before this one.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_prev(void* item) const {return ((FL_BLINE*)item)->prev;}
+void* Fl_Browser::item_prev(void* item) const {
+  if (line_cb_) return VLINE(item) > 1 ? VITEM(VLINE(item)-1) : 0;
+  return ((FL_BLINE*)item)->prev;
+}
 
 /**
   Returns the very last item in the list.
@@ -97,7 +298,10 @@ void* Fl_Browser::item_prev(void* item) const {return ((FL_BLINE*)item)->prev;}
   \returns The last item, or NULL if list is empty.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_last() const {return last;}
+void* Fl_Browser::item_last() const {
+  if (line_cb_) return lines ? VITEM(lines) : 0;
+  return last;
+}
 
 /**
   See if \p item is selected.
@@ -106,6 +310,10 @@ void* Fl_Browser::item_last() const {return last;}
   \see select(), selected(), value(), item_select(), item_selected()
 */
 int Fl_Browser::item_selected(void* item) const {
+  if (line_cb_) {
+    int i = VLINE(item) - 1;
+    return i < bits_size_ && (selected_bits_[i>>3] >> (i&7)) & 1;
+  }
   return ((FL_BLINE*)item)->flags&SELECTED;
 }
 /**
@@ -115,6 +323,20 @@ int Fl_Browser::item_selected(void* item) const {
   \see select(), selected(), value(), item_select(), item_selected()
 */
 void Fl_Browser::item_select(void *item, int val) {
+  if (line_cb_) {
+    int i = VLINE(item) - 1;
+    if (i >= bits_size_) {
+      if (!val) return;
+      // the bit array is allocated by the first selection:
+      int n = (lines+7)/8, old = (bits_size_+7)/8;
+      selected_bits_ = (unsigned char*)realloc(selected_bits_, n);
+      memset(selected_bits_+old, 0, n-old);
+      bits_size_ = lines;
+    }
+    if (val) selected_bits_[i>>3] |= (unsigned char)(1 << (i&7));
+    else selected_bits_[i>>3] &= (unsigned char)~(1 << (i&7));
+    return;
+  }
   if (val) ((FL_BLINE*)item)->flags |= SELECTED;
   else     ((FL_BLINE*)item)->flags &= ~SELECTED;
 }
@@ -125,19 +347,20 @@ void Fl_Browser::item_select(void *item, int val) {
   \returns The item's text string. (Can be NULL)
 */
 const char *Fl_Browser::item_text(void *item) const { 
+  if (line_cb_) {
+    Fl_Browser_Line info;
+    virtual_line(VLINE(item), &info);
+    return info.text;
+  }
   return ((FL_BLINE*)item)->txt;
 }
 
 /**
   Returns the item for specified \p line.
 
-  Note: This call is slow. It's fine for e.g. responding to user
-  clicks, but slow if called often, such as in a tight sorting loop.
-  Finding an item 'by line' involves a linear lookup on the internal
-  linked list. The performance hit can be significant if the browser's
-  contents is large, and the method is called often (e.g. during a sort).
-  If you're writing a subclass, use the protected methods item_first(),
-  item_next(), etc. to access the internal linked list more efficiently.
+  This uses the line index and takes O(log n) time, but it is still
+  faster to walk the list with the protected methods item_first(),
+  item_next(), etc. if you are writing a subclass that visits every line.
 
   \param[in] line The line number of the item to return. (1 based)
   \retval item that was found.
@@ -145,25 +368,25 @@ const char *Fl_Browser::item_text(void *item) const {
   \see item_at(), find_line(), lineno()
 */
 FL_BLINE* Fl_Browser::find_line(int line) const {
-  int n; FL_BLINE* l;
-  if (line == cacheline) return cache;
-  if (cacheline && line > (cacheline/2) && line < ((cacheline+lines)/2)) {
-    n = cacheline; l = cache;
-  } else if (line <= (lines/2)) {
-    n = 1; l = first;
-  } else {
-    n = lines; l = last;
+  if (line < 1 || line > lines) return 0;
+  if (line_cb_) return (FL_BLINE*)VITEM(line);
+  if (line == 1) return first;
+  if (line == lines) return last;
+  FL_BINDEX* x = index_;
+  index_build(x);
+  int i = 0;
+  for (int step = x->top; step; step /= 2) {
+    if (i+step <= x->nchunks && x->count_tree[i+step] < line) {
+      i += step;
+      line -= x->count_tree[i];
+    }
   }
-  for (; n < line && l; n++) l = l->next;
-  for (; n > line && l; n--) l = l->prev;
-  ((Fl_Browser*)this)->cacheline = line;
-  ((Fl_Browser*)this)->cache = l;
-  return l;
+  return x->chunk[i]->line[line-1];
 }
 
 /**
   Returns line number corresponding to \p item, or zero if not found.
-  Caveat: See efficiency note in find_line().
+  This uses the line index and takes O(log n) time.
   \param[in] item The item to be found
   \returns The line number of the item, or 0 if not found.
   \see item_at(), find_line(), lineno()
@@ -171,33 +394,93 @@ FL_BLINE* Fl_Browser::find_line(int line) const {
 int Fl_Browser::lineno(void *item) const {
   FL_BLINE* l = (FL_BLINE*)item;
   if (!l) return 0;
-  if (l == cache) return cacheline;
+  if (line_cb_) return VLINE(item);
   if (l == first) return 1;
   if (l == last) return lines;
-  if (!cache) {
-    ((Fl_Browser*)this)->cache = first;
-    ((Fl_Browser*)this)->cacheline = 1;
+  index_build(index_);
+  return index_count_before(index_, l->chunk->index) + index_slot(l) + 1;
+}
+
+/**
+  Returns the vertical position of \p item in pixels from the top
+  of the list, using the line index.
+  \param[in] item The item whose position is returned.
+  \returns The sum of the heights of the lines before \p item.
+  \see item_at_position(), lineposition()
+  \since FLTK 1.4.0
+*/
+int Fl_Browser::item_position(void *item) const {
+  FL_BLINE* l = (FL_BLINE*)item;
+  if (!l) return -1;
+  if (line_cb_) return (VLINE(item)-1) * line_h_;
+  FL_BCHUNK* c = l->chunk;
+  index_build(index_);
+  int p = index_height_before(index_, c->index);
+  for (int i = 0; c->line[i] != l; i++) p += c->line[i]->height;
+  return p;
+}
+
+/**
+  Returns the item at vertical position \p pos of the list, using the
+  line index. Hidden lines are skipped, and the last line is returned
+  if \p pos is at or below the end of the list.
+  \param[in] pos The position in pixels from the top of the list.
+  \param[out] item_pos The position of the returned item.
+  \returns The item, or NULL if the browser is empty.
+  \see item_position(), lineposition()
+  \since FLTK 1.4.0
+*/
+void *Fl_Browser::item_at_position(int pos, int *item_pos) const {
+  if (!lines) return 0;
+  if (line_cb_) {
+    int i = pos < 0 ? 0 : pos / line_h_;
+    if (i >= lines) i = lines-1;
+    *item_pos = i * line_h_;
+    return VITEM(i+1);
   }
-  // assume it is near cache, search both directions:
-  FL_BLINE* b = cache->prev;
-  int bnum = cacheline-1;
-  FL_BLINE* f = cache->next;
-  int fnum = cacheline+1;
-  int n = 0;
-  for (;;) {
-    if (b == l) {n = bnum; break;}
-    if (f == l) {n = fnum; break;}
-    if (b) {b = b->prev; bnum--;}
-    if (f) {f = f->next; fnum++;}
+  if (pos >= full_height_) {
+    *item_pos = full_height_ - last->height;
+    return last;
   }
-  ((Fl_Browser*)this)->cache = l;
-  ((Fl_Browser*)this)->cacheline = n;
-  return n;
+  if (pos < 0) pos = 0;
+  FL_BINDEX* x = index_;
+  index_build(x);
+  int i = 0, p = 0;
+  for (int step = x->top; step; step /= 2) {
+    if (i+step <= x->nchunks && x->height_tree[i+step] <= pos) {
+      i += step;
+      pos -= x->height_tree[i];
+      p += x->height_tree[i];
+    }
+  }
+  FL_BCHUNK* c = x->chunk[i];
+  int j = 0;
+  for (; j < c->n-1 && pos >= c->line[j]->height; j++) {
+    pos -= c->line[j]->height;
+    p += c->line[j]->height;
+  }
+  *item_pos = p;
+  return c->line[j];
+}
+
+/**
+  Changes the height of \p item kept in the line index to \p h, and updates
+  full_height().
+  Call this when item_height() of the item changes.
+  \param[in] item The item whose height changed.
+  \param[in] h The new height, as returned by item_height().
+  \since FLTK 1.4.0
+*/
+void Fl_Browser::line_height(FL_BLINE *item, int h) {
+  int dh = h - item->height;
+  if (!dh) return;
+  item->height = h;
+  full_height_ += dh;
+  index_update(index_, item->chunk, 0, dh);
 }
 
 /**
   Removes the item at the specified \p line.
-  Caveat: See efficiency note in find_line().
   You must call redraw() to make any changes visible.
   \param[in] line The line number to be removed. (1 based) Must be in range!
   \returns Pointer to browser item that was removed (and is no longer valid).
@@ -207,10 +490,8 @@ FL_BLINE* Fl_Browser::_remove(int line) {
   FL_BLINE* ttt = find_line(line);
   deleting(ttt);
 
-  cacheline = line-1;
-  cache = ttt->prev;
   lines--;
-  full_height_ -= item_height(ttt);
+  full_height_ -= index_remove(index_, ttt);
   if (ttt->prev) ttt->prev->next = ttt->next;
   else first = ttt->next;
   if (ttt->next) ttt->next->prev = ttt->prev;
@@ -227,7 +508,7 @@ FL_BLINE* Fl_Browser::_remove(int line) {
   \see add(), insert(), remove(), swap(int,int), clear()
 */
 void Fl_Browser::remove(int line) {
-  if (line < 1 || line > lines) return;
+  if (line < 1 || line > lines || line_cb_) return;
   free(_remove(line));
 }
 
@@ -235,16 +516,17 @@ void Fl_Browser::remove(int line) {
   Insert specified \p item above \p line.
   If \p line > size() then the line is added to the end.
 
-  Caveat: See efficiency note in find_line().
-
   \param[in] line  The new line will be inserted above this line (1 based).
   \param[in] item  The item to be added.
 */
 void Fl_Browser::insert(int line, FL_BLINE* item) {
+  FL_BLINE* n = 0;		// the line item is inserted before
+  if (!index_) index_ = (FL_BINDEX*)calloc(1, sizeof(FL_BINDEX));
   if (!first) {
     item->prev = item->next = 0;
     first = last = item;
   } else if (line <= 1) {
+    n = first;
     inserting(first, item);
     item->prev = 0;
     item->next = first;
@@ -256,17 +538,17 @@ void Fl_Browser::insert(int line, FL_BLINE* item) {
     item->next = 0;
     last = item;
   } else {
-    FL_BLINE* n = find_line(line);
+    n = find_line(line);
     inserting(n, item);
     item->next = n;
     item->prev = n->prev;
     item->prev->next = item;
     n->prev = item;
   }
-  cacheline = line;
-  cache = item;
   lines++;
-  full_height_ += item_height(item);
+  int h = item_height(item);
+  full_height_ += h;
+  index_insert(index_, item, n, h);
   redraw_line(item);
 }
 
@@ -284,6 +566,7 @@ void Fl_Browser::insert(int line, FL_BLINE* item) {
   \param[in] d Optional pointer to user data to be associated with the new line.
 */
 void Fl_Browser::insert(int line, const char* newtext, void* d) {
+  if (line_cb_) return;
   if (!newtext) newtext = "";		// STR #3269
   int l = (int) strlen(newtext);
   FL_BLINE* t = (FL_BLINE*)malloc(sizeof(FL_BLINE)+l);
@@ -302,7 +585,7 @@ void Fl_Browser::insert(int line, const char* newtext, void* d) {
   \param[in] from Line number of item to be moved
 */
 void Fl_Browser::move(int to, int from) {
-  if (from < 1 || from > lines) return;
+  if (from < 1 || from > lines || line_cb_) return;
   insert(to, _remove(from));
 }
 
@@ -318,16 +601,18 @@ void Fl_Browser::move(int to, int from) {
   \param[in] newtext The new string to be assigned to the item.
 */
 void Fl_Browser::text(int line, const char* newtext) {
-  if (line < 1 || line > lines) return;
+  if (line < 1 || line > lines || line_cb_) return;
   FL_BLINE* t = find_line(line);
   if (!newtext) newtext = "";		// STR #3269
   int l = (int) strlen(newtext);
   if (l > t->length) {
     FL_BLINE* n = (FL_BLINE*)malloc(sizeof(FL_BLINE)+l);
     replacing(t, n);
-    cache = n;
     n->data = t->data;
     n->icon = t->icon;
+    n->chunk = t->chunk;
+    n->height = t->height;
+    n->chunk->line[index_slot(t)] = n;
     n->length = (short)l;
     n->flags = t->flags;
     n->prev = t->prev;
@@ -338,6 +623,7 @@ void Fl_Browser::text(int line, const char* newtext) {
     t = n;
   }
   strcpy(t->txt, newtext);
+  line_height(t, item_height(t));
   redraw_line(t);
 }
 
@@ -348,7 +634,7 @@ void Fl_Browser::text(int line, const char* newtext) {
   \param[in] d The new data to be assigned to the item. (can be NULL)
 */
 void Fl_Browser::data(int line, void* d) {
-  if (line < 1 || line > lines) return;
+  if (line < 1 || line > lines || line_cb_) return;
   find_line(line)->data = d;
 }
 
@@ -361,12 +647,17 @@ void Fl_Browser::data(int line, void* d) {
        incr_height(), full_height()
 */
 int Fl_Browser::item_height(void *item) const {
+  if (line_cb_) return line_h_;
   FL_BLINE* l = (FL_BLINE*)item;
   if (l->flags & NOTDISPLAYED) return 0;
+  return text_height(l->txt, l->icon);
+}
 
+// Returns the height of a line with the text txt and the icon:
+int Fl_Browser::text_height(const char *txt, Fl_Image *icon) const {
   int hmax = 2; // use 2 to insure we don't return a zero!
 
-  if (!l->txt[0]) {
+  if (!txt[0]) {
     // For blank lines set the height to exactly 1 line!
     fl_font(textfont(), textsize());
     int hh = fl_height();
@@ -374,7 +665,7 @@ int Fl_Browser::item_height(void *item) const {
   } else {
     const int* i = column_widths();
     // do each column separately as they may all set different fonts:
-    for (char* str = l->txt; str && *str; str++) {
+    for (char* str = (char*)txt; str && *str; str++) {
       Fl_Font font = textfont(); // default font
       int tsize = textsize();    // default size
       if ( format_char() ) {     // can be NULL
@@ -406,8 +697,8 @@ int Fl_Browser::item_height(void *item) const {
     }
   }
 
-  if (l->icon && (l->icon->h()+2)>hmax) {
-    hmax = l->icon->h() + 2;	// leave 2px above/below
+  if (icon && (icon->h()+2)>hmax) {
+    hmax = icon->h() + 2;	// leave 2px above/below
   }
   return hmax; // previous version returned hmax+2!
 }
@@ -421,8 +712,18 @@ int Fl_Browser::item_height(void *item) const {
        incr_height(), full_height()
 */
 int Fl_Browser::item_width(void *item) const {
+  if (line_cb_) {
+    Fl_Browser_Line info;
+    virtual_line(VLINE(item), &info);
+    return text_width(info.text, info.icon);
+  }
   FL_BLINE* l=(FL_BLINE*)item;
-  char* str = l->txt;
+  return text_width(l->txt, l->icon);
+}
+
+// Returns the width of a line with the text txt and the icon:
+int Fl_Browser::text_width(const char *txt, Fl_Image *icon) const {
+  char* str = (char*)txt;
   const int* i = column_widths();
   int ww = 0;
 
@@ -465,7 +766,7 @@ int Fl_Browser::item_width(void *item) const {
       str ++;
   }
 
-  if (ww==0 && l->icon) ww = l->icon->w();
+  if (ww==0 && icon) ww = icon->w();
 
   fl_font(font, tsize);
   return ww + int(fl_width(str)) + 6;
@@ -480,6 +781,7 @@ int Fl_Browser::item_width(void *item) const {
        incr_height(), full_height()
 */
 int Fl_Browser::full_height() const {
+  if (line_cb_) return lines * line_h_;
   return full_height_;
 }
 
@@ -502,8 +804,26 @@ int Fl_Browser::incr_height() const {
   \param[in] X,Y,W,H position and size.
 */
 void Fl_Browser::item_draw(void* item, int X, int Y, int W, int H) const {
+  if (line_cb_) {
+    // copy the text, text_draw() changes it while it draws:
+    Fl_Browser_Line info;
+    virtual_line(VLINE(item), &info);
+    char buf[256];
+    size_t n = strlen(info.text) + 1;
+    char* str = n <= sizeof(buf) ? buf : (char*)malloc(n);
+    memcpy(str, info.text, n);
+    text_draw(str, info.icon, item_selected(item), X, Y, W, H);
+    if (str != buf) free(str);
+    return;
+  }
   FL_BLINE* l = (FL_BLINE*)item;
-  char* str = l->txt;
+  text_draw(l->txt, l->icon, l->flags & SELECTED, X, Y, W, H);
+}
+
+// Draws a line with the text str and the icon. The column separators
+// in str are replaced by 0 while the columns are drawn.
+void Fl_Browser::text_draw(char *str, Fl_Image *icon, int sel,
+                           int X, int Y, int W, int H) const {
   const int* i = column_widths();
 
   bool firstLoop = true;	// for icon
@@ -517,9 +837,9 @@ void Fl_Browser::item_draw(void* item, int X, int Y, int W, int H) const {
     // Icon drawing code
     if (firstLoop) {
       firstLoop = false;
-      if (l->icon) {
-	l->icon->draw(X+2,Y+1);	// leave 2px left, 1px above
-	int iconw = l->icon->w()+2;
+      if (icon) {
+	icon->draw(X+2,Y+1);	// leave 2px left, 1px above
+	int iconw = icon->w()+2;
 	X += iconw; W -= iconw; w1 -= iconw;
       }
     }
@@ -543,7 +863,7 @@ void Fl_Browser::item_draw(void* item, int X, int Y, int W, int H) const {
 	case 'c': talign = FL_ALIGN_CENTER; break;
 	case 'r': talign = FL_ALIGN_RIGHT; break;
 	case 'B': 
-	  if (!(l->flags & SELECTED)) {
+	  if (!sel) {
 	    fl_color((Fl_Color)strtoul(str, &str, 10));
 	    fl_rectf(X, Y, w1, H);
 	  } else while (isdigit(*str & 255)) str++; // skip digits
@@ -578,7 +898,7 @@ void Fl_Browser::item_draw(void* item, int X, int Y, int W, int H) const {
     }
   BREAK:
     fl_font(font, tsize);
-    if (l->flags & SELECTED)
+    if (sel)
       lcol = fl_contrast(lcol, selection_color());
     if (!active_r()) lcol = fl_inactive(lcol);
     fl_color(lcol);
@@ -603,10 +923,15 @@ Fl_Browser::Fl_Browser(int X, int Y, int W, int H, const char *L)
   column_widths_ = no_columns;
   lines = 0;
   full_height_ = 0;
-  cacheline = 0;
+  index_ = 0;
+  line_cb_ = 0;
+  line_data_ = 0;
+  selected_bits_ = 0;
+  bits_size_ = 0;
+  line_h_ = 0;
   format_char_ = '@';
   column_char_ = '\t';
-  first = last = cache = 0;
+  first = last = 0;
 }
 
 /**
@@ -620,9 +945,11 @@ void Fl_Browser::lineposition(int line, Fl_Line_Position pos) {
   if (line>lines) line = lines;
   int p = 0;
 
-  FL_BLINE* l;
-  for (l=first; l && line>1; l = l->next) {
-    line--; p += item_height(l);
+  FL_BLINE* l = find_line(line);
+  if (l && (p = item_position(l)) < 0) {
+    // subclass does not use the line index, add up the heights:
+    p = 0;
+    for (FL_BLINE* m = first; m != l; m = m->next) p += item_height(m);
   }
   if (l && (pos == BOTTOM)) p += item_height (l);
 
@@ -669,10 +996,13 @@ void Fl_Browser::textsize(Fl_Fontsize newSize) {
     return; // avoid recalculation
   Fl_Browser_::textsize(newSize);
   new_list();
-  full_height_ = 0;
+  if (line_cb_) {
+    virtual_lines(lines, line_cb_, line_data_);	// measures the lines again
+    return;
+  }
   if (lines == 0) return;
   for (FL_BLINE* itm=(FL_BLINE *)item_first(); itm; itm=(FL_BLINE *)item_next(itm)) {
-    full_height_ += item_height(itm);
+    line_height(itm, item_height(itm));
   }
 }
 
@@ -686,6 +1016,19 @@ void Fl_Browser::clear() {
     free(l);
     l = n;
   }
+  if (index_) {
+    for (int i = 0; i < index_->nchunks; i++) free(index_->chunk[i]);
+    free(index_->chunk);
+    free(index_->count_tree);
+    free(index_->height_tree);
+    free(index_);
+    index_ = 0;
+  }
+  free(selected_bits_);
+  selected_bits_ = 0;
+  bits_size_ = 0;
+  line_cb_ = 0;
+  line_data_ = 0;
   full_height_ = 0;
   first = 0;
   last = 0;
@@ -719,6 +1062,7 @@ void Fl_Browser::add(const char* newtext, void* d) {
 */
 const char* Fl_Browser::text(int line) const {
   if (line < 1 || line > lines) return 0;
+  if (line_cb_) return item_text(VITEM(line));
   return find_line(line)->txt;
 }
 
@@ -731,7 +1075,7 @@ const char* Fl_Browser::text(int line) const {
 
 */
 void* Fl_Browser::data(int line) const {
-  if (line < 1 || line > lines) return 0;
+  if (line < 1 || line > lines || line_cb_) return 0;
   return find_line(line)->data;
 }
 
@@ -756,6 +1100,7 @@ int Fl_Browser::select(int line, int val) {
   */
 int Fl_Browser::selected(int line) const {
   if (line < 1 || line > lines) return 0;
+  if (line_cb_) return item_selected(VITEM(line));
   return find_line(line)->flags & SELECTED;
 }
 
@@ -768,10 +1113,11 @@ int Fl_Browser::selected(int line) const {
   \see show(int), hide(int), display(), visible(), make_visible()
 */
 void Fl_Browser::show(int line) {
+  if (line_cb_) return;
   FL_BLINE* t = find_line(line);
   if (t->flags & NOTDISPLAYED) {
     t->flags &= ~NOTDISPLAYED;
-    full_height_ += item_height(t);
+    line_height(t, item_height(t));
     if (Fl_Browser_::displayed(t)) redraw();
   }
 }
@@ -786,10 +1132,11 @@ void Fl_Browser::show(int line) {
   \see show(int), hide(int), display(), visible(), make_visible()
 */
 void Fl_Browser::hide(int line) {
+  if (line_cb_) return;
   FL_BLINE* t = find_line(line);
   if (!(t->flags & NOTDISPLAYED)) {
-    full_height_ -= item_height(t);
     t->flags |= NOTDISPLAYED;
+    line_height(t, 0);
     if (Fl_Browser_::displayed(t)) redraw();
   }
 }
@@ -813,6 +1160,7 @@ void Fl_Browser::display(int line, int val) {
 */
 int Fl_Browser::visible(int line) const {
   if (line < 1 || line > lines) return 0;
+  if (line_cb_) return 1;
   return !(find_line(line)->flags&NOTDISPLAYED);
 }
 
@@ -865,9 +1213,206 @@ void Fl_Browser::swap(FL_BLINE *a, FL_BLINE *b) {
      if ( bprev ) bprev->next = a; else first = a;
      a->next = bnext;
   }
-  // Disable cache -- we played around with positions
-  cacheline = 0;
-  cache = 0;
+  // exchange the places of a and b in the index:
+  FL_BCHUNK* ac = a->chunk;
+  FL_BCHUNK* bc = b->chunk;
+  int ai = index_slot(a), bi = index_slot(b);
+  ac->line[ai] = b; b->chunk = ac;
+  bc->line[bi] = a; a->chunk = bc;
+  if (ac != bc) {
+    index_update(index_, ac, 0, b->height-a->height);
+    index_update(index_, bc, 0, a->height-b->height);
+  }
+}
+
+/**
+  Relinks the lines in the order of \p items, which is used by sort().
+  This is faster than moving them with swap().
+  \param[in] items All lines of the browser in their new order.
+  \param[in] n The number of lines.
+  \since FLTK 1.4.0
+*/
+void Fl_Browser::item_reorder(void **items, int n) {
+  if (line_cb_) return;		// the lines are in the order of the callback
+  if (n != lines) {		// not a reordering of all lines
+    Fl_Browser_::item_reorder(items, n);
+    return;
+  }
+  FL_BLINE** l = (FL_BLINE**)items;
+  first = l[0];
+  last = l[n-1];
+  for (int i = 0; i < n; i++) {
+    l[i]->prev = i > 0 ? l[i-1] : 0;
+    l[i]->next = i < n-1 ? l[i+1] : 0;
+  }
+  // refill the index chunks in the new order, they keep their sizes:
+  int k = 0;
+  for (int i = 0; i < index_->nchunks; i++) {
+    FL_BCHUNK* c = index_->chunk[i];
+    c->height = 0;
+    for (int j = 0; j < c->n; j++, k++) {
+      c->line[j] = l[k];
+      l[k]->chunk = c;
+      c->height += l[k]->height;
+    }
+  }
+  index_->dirty = 1;
+}
+
+struct Fl_Browser_Column_Sort {
+  int column;
+  int flags;
+  char format_char;
+  char column_char;
+};
+
+// Return the text of a sort column, after its format codes:
+static const char *sort_column(const char *str, const Fl_Browser_Column_Sort *cs) {
+  for (int i = cs->column; i > 0; i--) {
+    str = cs->column_char ? strchr(str, cs->column_char) : 0;
+    if (!str) return "";
+    str++;
+  }
+  char fc = cs->format_char;
+  if (fc) {
+    while (*str == fc && *++str && *str != fc) {
+      switch (*str++) {
+      case 'B': case 'C': case 'F': case 'S':
+	while (isdigit(*str & 255)) str++; // skip a number
+	break;
+      case '.':
+	return str;
+      }
+    }
+  }
+  return str;
+}
+
+static int column_compare(const char *a, const char *b, void *data) {
+  const Fl_Browser_Column_Sort *cs = (const Fl_Browser_Column_Sort *)data;
+  return Fl_Browser_::compare(sort_column(a, cs), sort_column(b, cs),
+                              cs->flags, cs->column_char);
+}
+
+/**
+  Sorts the lines by the text of one of their columns.
+  The columns are the parts of the text between column_char() separators,
+  and the format codes at the start of the column (see format_char())
+  are not compared. Lines with fewer columns sort as if the column was empty.
+  Lines whose columns are equal keep their order.
+  \param[in] flags FL_SORT_ASCENDING, FL_SORT_DESCENDING,
+                   FL_SORT_CASEINSENSITIVE and FL_SORT_NUMERIC
+  \param[in] column The column to compare, 0 is the first one.
+  \since FLTK 1.4.0
+*/
+void Fl_Browser::sort(int flags, int column) {
+  if (line_cb_) return;
+  Fl_Browser_Column_Sort cs;
+  cs.column = column;
+  cs.flags = flags;
+  cs.format_char = format_char_;
+  cs.column_char = column_char_;
+  Fl_Browser_::sort(column_compare, &cs, flags & FL_SORT_DESCENDING);
+}
+
+// Asks the callback of the virtual mode for the text and icon of line:
+void Fl_Browser::virtual_line(int line, Fl_Browser_Line *info) const {
+  info->text = 0;
+  info->icon = 0;
+  line_cb_(line, info, line_data_);
+  if (!info->text) info->text = "";
+}
+
+/**
+  Switches the browser to virtual mode with \p n lines, or changes the
+  number of lines in virtual mode.
+
+  In virtual mode the browser does not store any lines. It calls \p cb
+  with \p data for the text and icon of each line it draws or measures,
+  and for text(int), item_text() and icon(int). The text may contain
+  format and column characters like the text of other lines. The browser
+  keeps the selection in an array of one bit per line, which is allocated
+  when the first line is selected. Switching to virtual mode with a million
+  lines therefore takes constant time and memory, and drawing the browser
+  only calls \p cb for the lines that are shown.
+
+  All lines have the same height, the height of line 1 when virtual_lines()
+  or textsize() is called. The lines cannot be changed with add(),
+  insert(), remove(), move(), swap(int,int), text(int, const char*),
+  data(int, void*), icon(int, Fl_Image*), show(int) or hide(int), which do
+  nothing, data(int) returns NULL and sort() does nothing. Call redraw()
+  when the text of shown lines changes.
+
+  Calling virtual_lines() again with the same \p cb and \p data changes
+  the number of lines and keeps the scroll position and the selection of
+  the remaining lines, for instance when lines are added to a log. Another
+  callback clears the browser first. clear(), load() or a NULL \p cb leave
+  virtual mode.
+
+  Subclasses that replace item_first(), item_last() or item_at_position()
+  with functions that expect items to be stored lines, like Fl_File_Browser,
+  do not support virtual mode. virtual_lines() then calls Fl::error() and
+  leaves the browser empty.
+
+  \code
+  static void line_cb(int line, Fl_Browser_Line *info, void *data) {
+    info->text = ((const char **)data)[line-1];
+  }
+  ...
+  browser->virtual_lines(count, line_cb, strings);
+  \endcode
+
+  \param[in] n The number of lines.
+  \param[in] cb The callback that describes a line, NULL to leave virtual mode.
+  \param[in] data The data passed to \p cb.
+  \see virtual_lines() const, Fl_Browser_Line
+  \since FLTK 1.4.0
+*/
+void Fl_Browser::virtual_lines(int n, Fl_Browser_Line_Cb *cb, void *data) {
+  if (n < 0) n = 0;
+  if (!cb || cb != line_cb_ || data != line_data_) {
+    clear();
+    if (!cb) return;
+    line_cb_ = cb;
+    line_data_ = data;
+    // these do not take an item, so they can be asked about a line even
+    // if a subclass replaced them:
+    lines = 1;
+    line_h_ = 1;
+    int y;
+    if (item_first() != VITEM(1) || item_last() != VITEM(1) ||
+        item_at_position(0, &y) != VITEM(1)) {
+      clear();
+      Fl::error("Fl_Browser::virtual_lines(): not supported by this subclass");
+      return;
+    }
+    lines = n;
+  } else if (n < lines) {
+    // Fl_Browser_ may point at the removed lines, reset it and restore
+    // the scroll position and the selection of the remaining lines:
+    int p = position(), hp = hposition(), sel = value();
+    if (bits_size_ > n) {
+      int nb = (n+7)/8;
+      memset(selected_bits_+nb, 0, (bits_size_+7)/8-nb);
+      if (n&7) selected_bits_[n>>3] &= (unsigned char)((1 << (n&7)) - 1);
+      bits_size_ = n;
+    }
+    lines = n;
+    new_list();
+    // in a multi browser the line of value() need not be selected:
+    if (sel && sel <= n) Fl_Browser_::select(VITEM(sel), item_selected(VITEM(sel)));
+    int X, Y, W, H;
+    bbox(X, Y, W, H);
+    if (p > n*line_h_ - H) p = n*line_h_ - H;
+    position(p);
+    hposition(hp);
+  } else {
+    lines = n;
+  }
+  Fl_Browser_Line info = { "", 0 };
+  if (lines) virtual_line(1, &info);
+  line_h_ = text_height(info.text, info.icon);
+  redraw();
 }
 
 /**
@@ -877,7 +1422,7 @@ void Fl_Browser::swap(FL_BLINE *a, FL_BLINE *b) {
   \see swap(int,int), item_swap()
 */
 void Fl_Browser::swap(int a, int b) {
-  if (a < 1 || a > lines || b < 1 || b > lines) return;
+  if (a < 1 || a > lines || b < 1 || b > lines || line_cb_) return;
   FL_BLINE* ai = find_line(a);
   FL_BLINE* bi = find_line(b);
   swap(ai,bi);
@@ -893,20 +1438,16 @@ void Fl_Browser::swap(int a, int b) {
 */
 void Fl_Browser::icon(int line, Fl_Image* icon) {
 
-  if (line<1 || line > lines) return;
+  if (line<1 || line > lines || line_cb_) return;
 
   FL_BLINE* bl = find_line(line);
 
-  int old_h = bl->icon ? bl->icon->h()+2 : 0;	// init with *old* icon height
-  bl->icon = 0;					// remove icon, if any
-  int th = item_height(bl);			// height of text only
-  int new_h = icon ? icon->h()+2 : 0;		// init with *new* icon height
-  if (th > old_h) old_h = th;
-  if (th > new_h) new_h = th;
+  int old_h = bl->height;			// height with *old* icon
+  bl->icon = icon;				// set new icon
+  int new_h = item_height(bl);			// height with *new* icon
   int dh = new_h - old_h;
-  full_height_ += dh;				// do this *always*
+  line_height(bl, new_h);			// do this *always*
 
-  bl->icon = icon;				// set new icon
   if (dh>0) {
     redraw();					// icon larger than item? must redraw widget
   } else {
@@ -923,6 +1464,11 @@ void Fl_Browser::icon(int line, Fl_Image* icon) {
 */
 Fl_Image* Fl_Browser::icon(int line) const {
   FL_BLINE* l = find_line(line);
+  if (l && line_cb_) {
+    Fl_Browser_Line info;
+    virtual_line(line, &info);
+    return info.icon;
+  }
   return(l ? l->icon : NULL);
 }
 
@@ -19,6 +19,8 @@
 #define DISPLAY_SEARCH_BOTH_WAYS_AT_ONCE
 
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <FL/Fl.H>
 #include <FL/Fl_Widget.H>
 #include <FL/Fl_Browser_.H>
@@ -136,13 +138,16 @@ void Fl_Browser_::update_top() {
     void* l;
     int ly;
     int yy = position_;
-    // start from either head or current position, whichever is closer:
-    if (!top_ || yy <= (real_position_/2)) {
-      l = item_first();
-      ly = 0;
-    } else {
-      l = top_;
-      ly = real_position_-offset_;
+    // ask the subclass where it is, else start from either head or
+    // current position, whichever is closer:
+    if (!(l = item_at_position(yy, &ly))) {
+      if (!top_ || yy <= (real_position_/2)) {
+	l = item_first();
+	ly = 0;
+      } else {
+	l = top_;
+	ly = real_position_-offset_;
+      }
     }
     if (!l) {
       top_ = 0;
@@ -260,6 +265,25 @@ void Fl_Browser_::display(void* item) {
   void* lp = item_prev(l);
   if (lp == item) {position(real_position_+Y-item_quick_height(lp)); return;}
 
+  // if the subclass knows where the item is, don't search for it:
+  int ip = item_position(item);
+  if (ip >= 0) {
+    h1 = item_quick_height(item);
+    Y = ip-real_position_;
+    if (Y >= 0) {
+      if (Y <= H) { // it is visible or right at bottom
+	Y = Y+h1-H; // find where bottom edge is
+	if (Y > 0) position(real_position_+Y); // scroll down a bit
+      } else {
+	position(real_position_+Y-(H-h1)/2); // center it
+      }
+    } else {
+      if ((Y + h1) >= 0) position(real_position_+Y);
+      else position(real_position_+Y-(H-h1)/2);
+    }
+    return;
+  }
+
 #ifdef DISPLAY_SEARCH_BOTH_WAYS_AT_ONCE
   // search for item.  We search both up and down the list at the same time,
   // this evens up the execution time for the two cases - the old way was
@@ -583,6 +607,13 @@ void Fl_Browser_::inserting(void* a, void* b) {
 void* Fl_Browser_::find_item(int ypos) {
   update_top();
   int X, Y, W, H; bbox(X, Y, W, H);
+  if (top_ && ypos > Y-offset_) {
+    // ask the subclass for the item at the list position of ypos, this
+    // does not step over hidden items:
+    int p = real_position_ + (ypos < Y+H ? ypos : Y+H) - Y - 1, ip;
+    void* l = item_at_position(p, &ip);
+    if (l) return (p < ip+item_height(l)) ? l : 0;
+  }
   int yy = Y-offset_;
   for (void *l = top_; l; l = item_next(l)) {
     int hh = item_height(l); if (hh <= 0) continue;
@@ -981,50 +1012,165 @@ Fl_Browser_::Fl_Browser_(int X, int Y, int W, int H, const char* L)
   end();
 }
 
+/**
+  Compares the item texts \p a and \p b the way sort(int) does.
+  This can be used to build a comparison function for
+  sort(Fl_Browser_Sort_F*, void*, int), e.g. one that compares
+  a part of each text.
+  \param[in] a,b The texts to compare. NULL is the same as "".
+  \param[in] flags FL_SORT_CASEINSENSITIVE -- ignore the case of ASCII letters\n
+                   FL_SORT_NUMERIC -- compare runs of digits by their value,
+                   so that "file9" sorts before "file10"\n
+                   FL_SORT_DESCENDING is ignored.
+  \param[in] end The comparison also stops at this character, for
+                 instance a column separator.
+  \returns A negative value, 0, or a positive value, like strcmp().
+  \note Characters beyond ASCII are compared by their UTF-8 bytes.
+  \since FLTK 1.4.0
+*/
+int Fl_Browser_::compare(const char *a, const char *b, int flags, char end) {
+  if (!a) a = "";
+  if (!b) b = "";
+  for (;;) {
+    int ca = (*a == end) ? 0 : (*a & 255);
+    int cb = (*b == end) ? 0 : (*b & 255);
+    if ((flags & FL_SORT_NUMERIC) && isdigit(ca) && isdigit(cb)) {
+      // compare the numbers: skip leading zeros, then more digits is
+      // larger, else the first differing digit decides:
+      while (*a == '0' && isdigit(a[1] & 255)) a++;
+      while (*b == '0' && isdigit(b[1] & 255)) b++;
+      int na = 0, nb = 0, diff = 0;
+      for (; isdigit(a[na] & 255); na++) {}
+      for (; isdigit(b[nb] & 255); nb++) {}
+      if (na != nb) return na - nb;
+      for (int i = 0; i < na && !diff; i++) diff = a[i] - b[i];
+      if (diff) return diff;
+      a += na; b += nb;
+      continue;
+    }
+    if (flags & FL_SORT_CASEINSENSITIVE) {
+      ca = tolower(ca);
+      cb = tolower(cb);
+    }
+    if (ca != cb) return ca - cb;
+    if (!ca) return 0;
+    a++; b++;
+  }
+}
+
 /**
   Sort the items in the browser based on \p flags.
-  item_swap(void*, void*) and item_text(void*) must be implemented for this call.
+  item_text(void*) must be implemented for this call, as well as
+  item_reorder(void**, int) or item_swap(void*, void*).
+  This is the same as sort(0, 0, flags).
   \param[in] flags FL_SORT_ASCENDING -- sort in ascending order\n
                    FL_SORT_DESCENDING -- sort in descending order\n
+                   FL_SORT_CASEINSENSITIVE -- ignore the case of ASCII letters\n
+                   FL_SORT_NUMERIC -- sort runs of digits by their value\n
 		   Values other than the above will cause undefined behavior\n
 		   Other flags may appear in the future.
-  \todo Add a flag to ignore case
+  \see compare()
 */
 void Fl_Browser_::sort(int flags) {
-  //
-  // Simple bubble sort - pure lazyness on my side.
-  //
-  int i, j, n = -1, desc = ((flags&FL_SORT_DESCENDING)==FL_SORT_DESCENDING);
-  void *a =item_first(), *b, *c;
-  if (!a) return;
-  while (a) {
-    a = item_next(a);
-    n++;
+  sort(0, 0, flags);
+}
+
+struct Fl_Browser_Sort_Item {
+  void *item;
+  const char *text;
+};
+
+/**
+  Sort the items in the browser with the comparison function \p compare.
+
+  The sort is a stable merge sort, items that compare equal keep their
+  order. It calls item_text() once per item and item_reorder() once,
+  and redraws the browser once at the end.
+
+  \param[in] compare The function that compares the texts of two items,
+             or NULL to compare them with compare(a, b, flags).
+  \param[in] data User data passed to \p compare.
+  \param[in] flags FL_SORT_DESCENDING -- sort in descending order\n
+                   the other flags of sort(int) when \p compare is NULL.
+  \since FLTK 1.4.0
+*/
+void Fl_Browser_::sort(Fl_Browser_Sort_F *compare, void *data, int flags) {
+  int n = 0, desc = ((flags&FL_SORT_DESCENDING)==FL_SORT_DESCENDING);
+  void *p;
+  for (p = item_first(); p; p = item_next(p)) n++;
+  if (n < 2) return;
+
+  Fl_Browser_Sort_Item *a = new Fl_Browser_Sort_Item[n];
+  Fl_Browser_Sort_Item *b = new Fl_Browser_Sort_Item[n];
+  int i = 0;
+  for (p = item_first(); p; p = item_next(p), i++) {
+    a[i].item = p;
+    a[i].text = item_text(p);
+    if (!a[i].text) a[i].text = "";
   }
-  for (i=n; i>0; i--) {
-    char swapped = 0;
-    a = item_first();
-    b = item_next(a);
-    for (j=0; j<i; j++) {
-      const char *ta = item_text(a);
-      const char *tb = item_text(b);
-      c = item_next(b);
-      if (desc) {
-        if (strcmp(ta, tb)<0) {
-          item_swap(a, b);
-          swapped = 1;
-        }
-      } else {
-        if (strcmp(ta, tb)>0) {
-          item_swap(a, b);
-          swapped = 1;
-        }
+
+#define SORT_CMP(x, y) (compare ? compare((x).text, (y).text, data) \
+                                : Fl_Browser_::compare((x).text, (y).text, flags))
+#define SORT_AFTER(x, y) (desc ? SORT_CMP(x, y) < 0 : SORT_CMP(x, y) > 0)
+
+  // insertion sort short runs, then merge them bottom-up, swapping
+  // the source and destination arrays on each pass:
+  const int RUN = 16;
+  for (int lo = 0; lo < n; lo += RUN) {
+    int hi = lo+RUN < n ? lo+RUN : n;
+    for (int j = lo+1; j < hi; j++) {
+      Fl_Browser_Sort_Item t = a[j];
+      int k = j;
+      for (; k > lo && SORT_AFTER(a[k-1], t); k--) a[k] = a[k-1];
+      a[k] = t;
+    }
+  }
+  for (int width = RUN; width < n; width *= 2) {
+    for (int lo = 0; lo < n; lo += 2*width) {
+      int mid = lo+width < n ? lo+width : n;
+      int hi = lo+2*width < n ? lo+2*width : n;
+      int l = lo, r = mid, k = lo;
+      if (mid < hi && !SORT_AFTER(a[mid-1], a[mid])) {
+        // already in order:
+        for (; k < hi; k++) b[k] = a[k];
+        continue;
       }
-      if (!c) break;
-      b = c; a = item_prev(b);
+      while (l < mid && r < hi) b[k++] = SORT_AFTER(a[l], a[r]) ? a[r++] : a[l++];
+      while (l < mid) b[k++] = a[l++];
+      while (r < hi) b[k++] = a[r++];
     }
-    if (!swapped)
-      break;
+    Fl_Browser_Sort_Item *t = a; a = b; b = t;
+  }
+#undef SORT_AFTER
+#undef SORT_CMP
+
+  delete[] b;
+  void **items = new void*[n];
+  for (i = 0; i < n; i++) items[i] = a[i].item;
+  delete[] a;
+  item_reorder(items, n);
+  delete[] items;
+
+  // the items have moved, find the top item again at the same position:
+  top_ = item_first();
+  real_position_ = offset_ = 0;
+  redraw_lines();
+}
+
+/**
+  This optional method may be provided by the subclass to put all \p n items
+  of the list in the order of the array \p items, for instance by relinking
+  them, which is used by sort().
+  The default implementation moves the items with item_swap().
+  \param[in] items The items in their new order.
+  \param[in] n The number of items.
+  \since FLTK 1.4.0
+*/
+void Fl_Browser_::item_reorder(void **items, int n) {
+  void *p = item_first();
+  for (int i = 0; i < n && p; i++) {
+    if (p != items[i]) item_swap(p, items[i]);
+    p = item_next(items[i]);
   }
 }
 
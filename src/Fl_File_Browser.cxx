@@ -59,6 +59,8 @@ struct FL_BLINE			// data is in a linked list of these
   FL_BLINE	*next;		// Next item in list
   void		*data;		// Pointer to data (function)
   Fl_Image      *icon;		// Pointer to optional icon
+  struct FL_BCHUNK *chunk;	// Index chunk holding this line
+  int		height;		// Height of this line in the index
   short		length;		// sizeof(txt)-1, may be longer than string
   char		flags;		// selected, displayed
   char		txt[1];		// start of allocated array
@@ -41,7 +41,7 @@
 #include "flstring.h"
 
 // Read a .gif file and convert it to a "xpm" format (actually my
-// modified one with compressed colormaps).
+// modified one with compressed colormaps), or to RGB(A) data.
 
 // Extensively modified from original code for gif2ras by
 // Patrick J. Naughton of Sun Microsystems.  The original
@@ -80,166 +80,36 @@ typedef unsigned char uchar;
 #define NEXTBYTE (uchar)getc(GifFile)
 #define GETSHORT(var) var = NEXTBYTE; var += NEXTBYTE << 8
 
-/**
- The constructor loads the named GIF image.
-
- The destructor frees all memory and server resources that are used by
- the image.
-
- Use Fl_Image::fail() to check if Fl_GIF_Image failed to load. fail() returns
- ERR_FILE_ACCESS if the file could not be opened or read, ERR_FORMAT if the
- GIF format could not be decoded, and ERR_NO_IMAGE if the image could not
- be loaded for another reason.
- */
-Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
-  FILE *GifFile;	// File to read
-  char **new_data;	// Data array
-
-  if ((GifFile = fl_fopen(infname, "rb")) == NULL) {
-    Fl::error("Fl_GIF_Image: Unable to open %s!", infname);
-    ld(ERR_FILE_ACCESS);
-    return;
-  }
-
-  {char b[6];
-  if (fread(b,1,6,GifFile)<6) {
-    fclose(GifFile);
-    ld(ERR_FILE_ACCESS);
-    return; /* quit on eof */
-  }
-  if (b[0]!='G' || b[1]!='I' || b[2] != 'F') {
-    fclose(GifFile);
-    Fl::error("Fl_GIF_Image: %s is not a GIF file.\n", infname);
-    ld(ERR_FORMAT);
-    return;
-  }
-  if (b[3]!='8' || b[4]>'9' || b[5]!= 'a')
-    Fl::warning("%s is version %c%c%c.",infname,b[3],b[4],b[5]);
-  }
-
-  int Width; GETSHORT(Width);
-  int Height; GETSHORT(Height);
-
-  uchar ch = NEXTBYTE;
-  char HasColormap = ((ch & 0x80) != 0);
-  int BitsPerPixel = (ch & 7) + 1;
-  int ColorMapSize;
-  if (HasColormap) {
-    ColorMapSize = 2 << (ch & 7);
-  } else {
-    ColorMapSize = 0;
-  }
-  // int OriginalResolution = ((ch>>4)&7)+1;
-  // int SortedTable = (ch&8)!=0;
-  ch = NEXTBYTE; // Background Color index
-  ch = NEXTBYTE; // Aspect ratio is N/64
-
-  // Read in global colormap:
-  uchar transparent_pixel = 0;
-  char has_transparent = 0;
-  uchar Red[256], Green[256], Blue[256]; /* color map */
-  if (HasColormap) {
-    for (int i=0; i < ColorMapSize; i++) {	
-      Red[i] = NEXTBYTE;
-      Green[i] = NEXTBYTE;
-      Blue[i] = NEXTBYTE;
-    }
-  }
-
-  int CodeSize;		/* Code size, init from GIF header, increases... */
-  char Interlace;
-
-  for (;;) {
-
-    int i = NEXTBYTE;
-    if (i<0) {
-      fclose(GifFile);
-      Fl::error("Fl_GIF_Image: %s - unexpected EOF",infname); 
-      w(0); h(0); d(0); ld(ERR_FORMAT);
-      return;
-    }
-    int blocklen;
-
-    //  if (i == 0x3B) return 0;  eof code
-
-    if (i == 0x21) {		// a "gif extension"
-
-      ch = NEXTBYTE;
-      blocklen = NEXTBYTE;
-
-      if (ch==0xF9 && blocklen==4) { // Netscape animation extension
-
-	char bits;
-	bits = NEXTBYTE;
-	getc(GifFile); getc(GifFile); // GETSHORT(delay);
-	transparent_pixel = NEXTBYTE;
-	if (bits & 1) has_transparent = 1;
-	blocklen = NEXTBYTE;
-
-      } else if (ch == 0xFF) { // Netscape repeat count
-	;
-
-      } else if (ch != 0xFE) { //Gif Comment
-	Fl::warning("%s: unknown gif extension 0x%02x.", infname, ch);
-      }
-    } else if (i == 0x2c) {	// an image
-
-      ch = NEXTBYTE; ch = NEXTBYTE; // GETSHORT(x_position);
-      ch = NEXTBYTE; ch = NEXTBYTE; // GETSHORT(y_position);
-      GETSHORT(Width);
-      GETSHORT(Height);
-      ch = NEXTBYTE;
-      Interlace = ((ch & 0x40) != 0);
-      if (ch & 0x80) { // image has local color table
-	BitsPerPixel = (ch & 7) + 1;
-	ColorMapSize = 2 << (ch & 7);
-	for (i=0; i < ColorMapSize; i++) {
-	  Red[i] = NEXTBYTE;
-	  Green[i] = NEXTBYTE;
-	  Blue[i] = NEXTBYTE;
-	}
-      }
-      CodeSize = NEXTBYTE+1;
-      break; // okay, this is the image we want
-    } else {
-      Fl::warning("%s: unknown gif code 0x%02x", infname, i);
-      blocklen = 0;
-    }
-
-    // skip the data:
-    while (blocklen>0) {while (blocklen--) {ch = NEXTBYTE;} blocklen=NEXTBYTE;}
-  }
-
-  if (BitsPerPixel >= CodeSize)
-  {
-    // Workaround for broken GIF files...
-    BitsPerPixel = CodeSize - 1;
-    ColorMapSize = 1 << BitsPerPixel;
-  }
-
-  // Fix images w/o color table. The standard allows this and lets the
-  // decoder choose a default color table. The standard recommends the
-  // first two color table entries should be black and white.
-
-  if (ColorMapSize == 0) { // no global and no local color table
-    Fl::warning("%s does not have a color table, using default.\n", infname);
-    BitsPerPixel = CodeSize - 1;
-    ColorMapSize = 1 << BitsPerPixel;
-    Red[0] = Green[0] = Blue[0] = 0;	// black
-    Red[1] = Green[1] = Blue[1] = 255;	// white
-    for (int i = 2; i < ColorMapSize; i++) {
-      Red[i] = Green[i] = Blue[i] = (uchar)(255 * i / (ColorMapSize - 1));
-    }
-#if (0)
-    // fill color table to maximum size
-    for (int i = ColorMapSize; i < 256; i++) {
-      Red[i] = Green[i] = Blue[i] = 0; // black
-    }
-#endif
-  }
-
-  uchar *Image = new uchar[Width*Height];
-
+// One image of a GIF file, with the color table and the graphic
+// control extension that apply to it
+class Fl_GIF_Frame {
+public:
+  int x, y, w, h;               // position and size on the logical screen
+  int delay;                    // in 1/100 seconds
+  int dispose;                  // disposal method (0-3)
+  int transparent;              // transparent color index, or -1
+  int ncolors;                  // used size of the color table
+  uchar colors[256][3];         // color table
+  uchar *pixels;                // w*h color indices
+
+  Fl_GIF_Frame() : pixels(0) { }
+  ~Fl_GIF_Frame() { delete[] pixels; }
+};
+
+// The contents of a GIF file
+struct Fl_GIF_Data {
+  int w, h;                     // size of the logical screen
+  int loop_count;               // NETSCAPE2.0 loop count, -1 if none
+  int nframes;
+  Fl_GIF_Frame *frames;
+};
+
+
+// Decodes the LZW compressed data of one image into Image, which must hold
+// Width*Height bytes, and skips the rest of the data sub-blocks.
+static void decode_lzw(FILE *GifFile, const char *infname,
+                       int CodeSize, int ColorMapSize, char Interlace,
+                       int Width, int Height, uchar *Image) {
   int YC = 0, Pass = 0; /* Used to de-interlace the picture */
   uchar *p = Image;
   uchar *eol = p+Width;
@@ -272,7 +142,7 @@ Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
     if (frombit+CodeSize > 7) {
       if (blocklen <= 0) {
 	blocklen = NEXTBYTE;
-	if (blocklen <= 0) break;
+	if (blocklen <= 0 || feof(GifFile)) return;
       }
       thisbyte = NEXTBYTE; blocklen--;
       CurCode |= thisbyte<<8;
@@ -280,7 +150,7 @@ Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
     if (frombit+CodeSize > 15) {
       if (blocklen <= 0) {
 	blocklen = NEXTBYTE;
-	if (blocklen <= 0) break;
+	if (blocklen <= 0 || feof(GifFile)) return;
       }
       thisbyte = NEXTBYTE; blocklen--;
       CurCode |= thisbyte<<16;
@@ -298,7 +168,7 @@ Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
 
     if (CurCode == EOFCode) break;
 
-    uchar OutCode[1025]; // temporary array for reversing codes
+    uchar OutCode[4097]; // temporary array for reversing codes
     uchar *tp = OutCode;
     int i;
     if (CurCode < FreeCode) i = CurCode;
@@ -338,6 +208,264 @@ Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
     OldCode = CurCode;
   }
 
+  // skip the rest of the data, up to the block terminator:
+  for (;;) {
+    while (blocklen-- > 0) getc(GifFile);
+    blocklen = getc(GifFile);
+    if (blocklen <= 0) break; // terminator or EOF
+  }
+}
+
+
+// Reads the images of a GIF file, or only the first one if all is 0.
+// Returns 0 or one of the Fl_Image::ERR_* codes.
+static int read_gif(const char *infname, int all, Fl_GIF_Data &gif) {
+  FILE *GifFile;	// File to read
+
+  gif.w = gif.h = 0;
+  gif.loop_count = -1;
+  gif.nframes = 0;
+  gif.frames = 0;
+
+  if ((GifFile = fl_fopen(infname, "rb")) == NULL) {
+    Fl::error("Fl_GIF_Image: Unable to open %s!", infname);
+    return Fl_Image::ERR_FILE_ACCESS;
+  }
+
+  {char b[6];
+  if (fread(b,1,6,GifFile)<6) {
+    fclose(GifFile);
+    return Fl_Image::ERR_FILE_ACCESS; /* quit on eof */
+  }
+  if (b[0]!='G' || b[1]!='I' || b[2] != 'F') {
+    fclose(GifFile);
+    Fl::error("Fl_GIF_Image: %s is not a GIF file.\n", infname);
+    return Fl_Image::ERR_FORMAT;
+  }
+  if (b[3]!='8' || b[4]>'9' || b[5]!= 'a')
+    Fl::warning("%s is version %c%c%c.",infname,b[3],b[4],b[5]);
+  }
+
+  int Width; GETSHORT(Width);
+  int Height; GETSHORT(Height);
+  gif.w = Width;
+  gif.h = Height;
+
+  uchar ch = NEXTBYTE;
+  char HasColormap = ((ch & 0x80) != 0);
+  int GlobalBitsPerPixel = (ch & 7) + 1;
+  int GlobalColorMapSize;
+  if (HasColormap) {
+    GlobalColorMapSize = 2 << (ch & 7);
+  } else {
+    GlobalColorMapSize = 0;
+  }
+  // int OriginalResolution = ((ch>>4)&7)+1;
+  // int SortedTable = (ch&8)!=0;
+  ch = NEXTBYTE; // Background Color index
+  ch = NEXTBYTE; // Aspect ratio is N/64
+
+  // Read in global colormap:
+  uchar GlobalColors[256][3];
+  if (HasColormap) {
+    if (fread(GlobalColors, 3, GlobalColorMapSize, GifFile) < (size_t)GlobalColorMapSize) {
+      fclose(GifFile);
+      Fl::error("Fl_GIF_Image: %s - unexpected EOF",infname);
+      return Fl_Image::ERR_FORMAT;
+    }
+  }
+
+  // graphic control extension for the next image:
+  int delay = 0, dispose = 0, transparent = -1;
+  int alloc_frames = 0;
+
+  for (;;) {
+
+    int i = getc(GifFile);
+    if (i == EOF) {
+      if (gif.nframes) break; // be tolerant with animations
+      fclose(GifFile);
+      Fl::error("Fl_GIF_Image: %s - unexpected EOF",infname);
+      return Fl_Image::ERR_FORMAT;
+    }
+    int blocklen;
+
+    if (i == 0x3B) break; // trailer
+
+    if (i == 0x21) {		// a "gif extension"
+
+      ch = NEXTBYTE;
+      blocklen = NEXTBYTE;
+
+      if (ch==0xF9 && blocklen==4) { // graphic control extension
+
+	char bits;
+	bits = NEXTBYTE;
+	GETSHORT(delay);
+	int t = NEXTBYTE;
+	transparent = (bits & 1) ? t : -1;
+	dispose = (bits >> 2) & 7;
+	if (dispose > 3) dispose = 0;
+	blocklen = NEXTBYTE;
+
+      } else if (ch == 0xFF) { // Netscape repeat count
+	char app[11];
+	if (blocklen == 11 && fread(app, 1, 11, GifFile) == 11) {
+	  blocklen = NEXTBYTE;
+	  if (blocklen == 3 && !memcmp(app, "NETSCAPE2.0", 11)) {
+	    ch = NEXTBYTE; // sub-block id 1
+	    int loops; GETSHORT(loops);
+	    gif.loop_count = loops;
+	    blocklen = NEXTBYTE;
+	  }
+	}
+
+      } else if (ch != 0xFE) { //Gif Comment
+	Fl::warning("%s: unknown gif extension 0x%02x.", infname, ch);
+      }
+    } else if (i == 0x2c) {	// an image
+
+      if (gif.nframes == alloc_frames) {
+	alloc_frames = alloc_frames ? 2 * alloc_frames : 4;
+	Fl_GIF_Frame *f = new Fl_GIF_Frame[alloc_frames];
+	for (int k = 0; k < gif.nframes; k++) {
+	  f[k] = gif.frames[k];
+	  gif.frames[k].pixels = 0;
+	}
+	delete[] gif.frames;
+	gif.frames = f;
+      }
+      Fl_GIF_Frame &frame = gif.frames[gif.nframes];
+
+      GETSHORT(frame.x);
+      GETSHORT(frame.y);
+      GETSHORT(Width);
+      GETSHORT(Height);
+      ch = NEXTBYTE;
+      char Interlace = ((ch & 0x40) != 0);
+      int BitsPerPixel = GlobalBitsPerPixel;
+      int ColorMapSize = GlobalColorMapSize;
+      memcpy(frame.colors, GlobalColors, 3 * ColorMapSize);
+      if (ch & 0x80) { // image has local color table
+	BitsPerPixel = (ch & 7) + 1;
+	ColorMapSize = 2 << (ch & 7);
+	if (fread(frame.colors, 3, ColorMapSize, GifFile)) { /* ignore */ }
+      }
+      int CodeSize = NEXTBYTE+1;
+      if (CodeSize < 2 || CodeSize > 12 || feof(GifFile)) {
+	if (gif.nframes) break;
+	fclose(GifFile);
+	Fl::error("Fl_GIF_Image: %s - unexpected EOF",infname);
+	return Fl_Image::ERR_FORMAT;
+      }
+
+      if (BitsPerPixel >= CodeSize)
+      {
+	// Workaround for broken GIF files...
+	BitsPerPixel = CodeSize - 1;
+	ColorMapSize = 1 << BitsPerPixel;
+      }
+
+      // Fix images w/o color table. The standard allows this and lets the
+      // decoder choose a default color table. The standard recommends the
+      // first two color table entries should be black and white.
+
+      if (ColorMapSize == 0) { // no global and no local color table
+	Fl::warning("%s does not have a color table, using default.\n", infname);
+	BitsPerPixel = CodeSize - 1;
+	ColorMapSize = 1 << BitsPerPixel;
+	frame.colors[0][0] = frame.colors[0][1] = frame.colors[0][2] = 0;	// black
+	frame.colors[1][0] = frame.colors[1][1] = frame.colors[1][2] = 255;	// white
+	for (int c = 2; c < ColorMapSize; c++) {
+	  frame.colors[c][0] = frame.colors[c][1] = frame.colors[c][2] =
+	    (uchar)(255 * c / (ColorMapSize - 1));
+	}
+      }
+
+      frame.w = Width;
+      frame.h = Height;
+      frame.delay = delay;
+      frame.dispose = dispose;
+      frame.transparent = transparent < ColorMapSize ? transparent : -1;
+      frame.ncolors = ColorMapSize;
+      size_t n = (size_t)Width * Height;
+      if (n > Fl_RGB_Image::max_size()) {
+	if (gif.nframes) break;
+	fclose(GifFile);
+	Fl::error("Fl_GIF_Image: %s is too large", infname);
+	return Fl_Image::ERR_FORMAT;
+      }
+      frame.pixels = new uchar[n ? n : 1];
+      memset(frame.pixels, 0, n ? n : 1);
+      decode_lzw(GifFile, infname, CodeSize, ColorMapSize, Interlace,
+                 Width, Height, frame.pixels);
+      gif.nframes++;
+
+      if (!all) break; // okay, this is the image we want
+
+      delay = dispose = 0;
+      transparent = -1;
+      continue;
+    } else {
+      Fl::warning("%s: unknown gif code 0x%02x", infname, i);
+      blocklen = 0;
+    }
+
+    // skip the data:
+    while (blocklen>0 && !feof(GifFile)) {
+      while (blocklen--) {ch = NEXTBYTE;}
+      blocklen=NEXTBYTE;
+    }
+  }
+
+  fclose(GifFile);
+
+  if (!gif.nframes) {
+    Fl::error("Fl_GIF_Image: %s has no image", infname);
+    return Fl_Image::ERR_FORMAT;
+  }
+  return 0;
+}
+
+
+/**
+ The constructor loads the named GIF image.
+
+ The destructor frees all memory and server resources that are used by
+ the image.
+
+ Use Fl_Image::fail() to check if Fl_GIF_Image failed to load. fail() returns
+ ERR_FILE_ACCESS if the file could not be opened or read, ERR_FORMAT if the
+ GIF format could not be decoded, and ERR_NO_IMAGE if the image could not
+ be loaded for another reason.
+ */
+Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
+  char **new_data;	// Data array
+  Fl_GIF_Data gif;
+
+  int err = read_gif(infname, 0, gif);
+  if (err) {
+    w(0); h(0); d(0); ld(err);
+    delete[] gif.frames;
+    return;
+  }
+
+  Fl_GIF_Frame &frame = gif.frames[0];
+  int Width = frame.w;
+  int Height = frame.h;
+  int ColorMapSize = frame.ncolors;
+  uchar *Image = frame.pixels;
+  uchar *p;
+  char has_transparent = frame.transparent >= 0;
+  uchar transparent_pixel = has_transparent ? (uchar)frame.transparent : 0;
+  uchar Red[256], Green[256], Blue[256]; /* color map */
+  int i;
+  for (i = 0; i < ColorMapSize; i++) {
+    Red[i] = frame.colors[i][0];
+    Green[i] = frame.colors[i][1];
+    Blue[i] = frame.colors[i][2];
+  }
+
   // We are done reading the file, now convert to xpm:
 
   // allocate line pointer arrays:
@@ -370,8 +498,7 @@ Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
 
   // find out what colors are actually used:
   uchar used[256]; uchar remap[256];
-  int i;
-  for (i = 0; i < ColorMapSize; i++) used[i] = 0;
+  for (i = 0; i < 256; i++) used[i] = 0;
   p = Image+Width*Height;
   while (p-- > Image) used[*p] = 1;
 
@@ -383,11 +510,11 @@ Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
     numcolors++;
   }
 
-  // write the first line of xpm data (use suffix as temp array):
-  int length = sprintf((char*)(Suffix),
-		       "%d %d %d %d",Width,Height,-numcolors,1);
+  // write the first line of xpm data:
+  char line[64];
+  int length = sprintf(line, "%d %d %d %d",Width,Height,-numcolors,1);
   new_data[0] = new char[length+1];
-  strcpy(new_data[0], (char*)Suffix);
+  strcpy(new_data[0], line);
 
   // write the colormap
   new_data[1] = (char*)(p = new uchar[4*numcolors]);
@@ -412,9 +539,157 @@ Fl_GIF_Image::Fl_GIF_Image(const char *infname) : Fl_Pixmap((char *const*)0) {
   data((const char **)new_data, Height + 2);
   alloc_data = 1;
 
-  delete[] Image;
+  delete[] gif.frames;
+}
 
-  fclose(GifFile);
+
+// Copies the pixels of a frame that are not transparent into the RGB data
+static void draw_frame(uchar *rgb, int W, int H, int D, const Fl_GIF_Frame &f) {
+  int X0 = f.x < 0 ? 0 : f.x, X1 = f.x + f.w > W ? W : f.x + f.w;
+  int Y0 = f.y < 0 ? 0 : f.y, Y1 = f.y + f.h > H ? H : f.y + f.h;
+  if (X0 >= X1) return;
+  int t = f.transparent;
+  for (int y = Y0; y < Y1; y++) {
+    const uchar *s = f.pixels + (size_t)(y - f.y) * f.w + (X0 - f.x);
+    uchar *p = rgb + ((size_t)y * W + X0) * D;
+    for (int x = X0; x < X1; x++, s++, p += D) {
+      if (*s == t) continue;
+      const uchar *c = f.colors[*s];
+      p[0] = c[0]; p[1] = c[1]; p[2] = c[2];
+      if (D == 4) p[3] = 255;
+    }
+  }
+}
+
+
+// Clears the area of a frame to transparent (disposal method 2)
+static void clear_frame(uchar *rgb, int W, int H, int D, const Fl_GIF_Frame &f) {
+  int X0 = f.x < 0 ? 0 : f.x, X1 = f.x + f.w > W ? W : f.x + f.w;
+  int Y0 = f.y < 0 ? 0 : f.y, Y1 = f.y + f.h > H ? H : f.y + f.h;
+  if (X0 >= X1) return;
+  for (int y = Y0; y < Y1; y++)
+    memset(rgb + ((size_t)y * W + X0) * D, 0, (X1 - X0) * D);
+}
+
+
+/**
+ The constructor loads all frames of the named GIF image and shows the
+ first one.
+
+ Use Fl_Image::fail() to check if Fl_GIF_RGB_Image failed to load. fail()
+ returns ERR_FILE_ACCESS if the file could not be opened or read, ERR_FORMAT
+ if the GIF format could not be decoded, and ERR_NO_IMAGE if the image
+ could not be loaded for another reason.
+ */
+Fl_GIF_RGB_Image::Fl_GIF_RGB_Image(const char *infname) : Fl_RGB_Image(0,0,0) {
+  Fl_GIF_Data gif;
+
+  frames_ = 0;
+  nframes_ = 0;
+  frame_ = -1;
+  loop_count_ = -1;
+  prev_ = 0;
+
+  int err = read_gif(infname, 1, gif);
+  if (err) {
+    w(0); h(0); d(0); ld(err);
+    delete[] gif.frames;
+    return;
+  }
+
+  // the logical screen must hold the frames, and needs an alpha
+  // channel if any pixel can be transparent
+  int W = gif.w, H = gif.h, D = 3, i;
+  for (i = 0; i < gif.nframes; i++) {
+    Fl_GIF_Frame &f = gif.frames[i];
+    if (f.x + f.w > W) W = f.x + f.w;
+    if (f.y + f.h > H) H = f.y + f.h;
+  }
+  for (i = 0; i < gif.nframes; i++) {
+    Fl_GIF_Frame &f = gif.frames[i];
+    if (f.transparent >= 0 || f.x > 0 || f.y > 0 || f.w < W || f.h < H ||
+        (f.dispose == 2 && i < gif.nframes - 1))
+      D = 4;
+  }
+
+  if (((size_t)W) * H * D > max_size()) {
+    Fl::warning("Fl_GIF_RGB_Image: %s is too large", infname);
+    w(0); h(0); d(0); ld(ERR_FORMAT);
+    delete[] gif.frames;
+    return;
+  }
+
+  w(W);
+  h(H);
+  d(D);
+  array = new uchar[(size_t)W * H * D];
+  alloc_array = 1;
+  memset((uchar *)array, 0, (size_t)W * H * D);
+
+  frames_ = gif.frames;
+  nframes_ = gif.nframes;
+  loop_count_ = gif.loop_count;
+  frame(0);
+
+  if (nframes_ == 1) {
+    // no other frame will ever be drawn
+    delete[] frames_[0].pixels;
+    frames_[0].pixels = 0;
+  }
+}
+
+
+/**
+ The destructor frees all memory and server resources that are used by
+ the image.
+ */
+Fl_GIF_RGB_Image::~Fl_GIF_RGB_Image() {
+  delete[] frames_;
+  delete[] prev_;
+}
+
+
+/**
+ Changes the image data to show frame \p n.
+
+ Frames are drawn over each other as the GIF format requires, so showing
+ the frames in order is fastest. Changes made to the image data, for
+ instance with color_average(), are lost.
+ */
+void Fl_GIF_RGB_Image::frame(int n) {
+  if (n < 0 || n >= nframes_ || n == frame_) return;
+  uchar *rgb = (uchar *)array;
+  int W = w(), H = h(), D = d();
+  size_t size = (size_t)W * H * D;
+  if (n < frame_) {
+    memset(rgb, 0, size);
+    frame_ = -1;
+  }
+  while (frame_ < n) {
+    if (frame_ >= 0) {
+      // dispose of the previous frame
+      Fl_GIF_Frame &f = frames_[frame_];
+      if (f.dispose == 2) clear_frame(rgb, W, H, D, f);
+      else if (f.dispose == 3 && prev_) memcpy(rgb, prev_, size);
+    }
+    frame_++;
+    Fl_GIF_Frame &f = frames_[frame_];
+    if (f.dispose == 3) {
+      if (!prev_) prev_ = new uchar[size];
+      memcpy(prev_, rgb, size);
+    }
+    draw_frame(rgb, W, H, D, f);
+  }
+  uncache();
+}
+
+
+/**
+ Returns how long frame \p n should be shown in 1/100 seconds.
+ */
+int Fl_GIF_RGB_Image::delay(int n) const {
+  if (n < 0 || n >= nframes_) return 0;
+  return frames_[n].delay;
 }
 
 
@@ -221,6 +221,8 @@ Fl_Image::measure(const Fl_Label *lo,		// I - Label
 
 /** Sets the RGB image scaling method used for copy(int, int).
     Applies to all RGB images, defaults to FL_RGB_SCALING_NEAREST.
+    FL_RGB_SCALING_AREA gives the best results when an image is made
+    much smaller, for instance for thumbnails.
 */
 void Fl_Image::RGB_scaling(Fl_RGB_Scaling method) {
   RGB_scaling_ = method;
@@ -302,6 +304,7 @@ int Fl_Image::draw_scaled(int X, int Y, int W, int H) {
 // RGB image class...
 //
 size_t Fl_RGB_Image::max_size_ = ~((size_t)0);
+size_t Fl_RGB_Image::scaled_cache_size_ = 32 * 1024 * 1024;
 
 int fl_convert_pixmap(const char*const* cdata, uchar* out, Fl_Color bg);
 
@@ -393,6 +396,148 @@ void Fl_RGB_Image::uncache() {
   Fl_Graphics_Driver::default_driver().uncache(this, id_, mask_);
 }
 
+// Resampling helpers for Fl_RGB_Image::copy().
+//
+// Both smooth scaling methods work a destination row at a time: a vertical
+// pass combines whole source rows into a row of fixed point values, which
+// is where SSE2 or NEON help, and a horizontal pass combines the values
+// of each destination pixel. Images with alpha are scaled with
+// premultiplied colors.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define FL_RGB_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define FL_RGB_NEON 1
+#endif
+
+// out[i] = a[i] * (256 - f) + b[i] * f, with 0 <= f <= 256
+static void blend_rows(const uchar *a, const uchar *b, int f,
+                       unsigned short *out, int n) {
+  int i = 0;
+#if defined(FL_RGB_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i fa = _mm_set1_epi16((short)(256 - f));
+  const __m128i fb = _mm_set1_epi16((short)f);
+  for (; i + 16 <= n; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), fa),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), fb));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), fa),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), fb));
+    _mm_storeu_si128((__m128i *)(out + i), lo);
+    _mm_storeu_si128((__m128i *)(out + i + 8), hi);
+  }
+#elif defined(FL_RGB_NEON)
+  const uint16x8_t fa = vdupq_n_u16((unsigned short)(256 - f));
+  const uint16x8_t fb = vdupq_n_u16((unsigned short)f);
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t va = vld1q_u8(a + i);
+    uint8x16_t vb = vld1q_u8(b + i);
+    uint16x8_t lo = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(va)), fa),
+                              vmovl_u8(vget_low_u8(vb)), fb);
+    uint16x8_t hi = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(va)), fa),
+                              vmovl_u8(vget_high_u8(vb)), fb);
+    vst1q_u16(out + i, lo);
+    vst1q_u16(out + i + 8, hi);
+  }
+#endif
+  for (; i < n; i++)
+    out[i] = (unsigned short)(a[i] * (256 - f) + b[i] * f);
+}
+
+// acc[i] += src[i] * f, with 0 <= f <= 4096
+static void accumulate_row(const uchar *src, int f, unsigned *acc, int n) {
+  int i = 0;
+#if defined(FL_RGB_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i vf = _mm_set1_epi16((short)f);
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+    for (int k = 0; k < 2; k++) {
+      __m128i x = k ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+      __m128i lo = _mm_mullo_epi16(x, vf);
+      __m128i hi = _mm_mulhi_epu16(x, vf);
+      __m128i *p = (__m128i *)(acc + i + 8 * k);
+      _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_unpacklo_epi16(lo, hi)));
+      _mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1), _mm_unpackhi_epi16(lo, hi)));
+    }
+  }
+#elif defined(FL_RGB_NEON)
+  const uint16x4_t vf = vdup_n_u16((unsigned short)f);
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t v = vld1q_u8(src + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    vst1q_u32(acc + i,      vmlal_u16(vld1q_u32(acc + i),      vget_low_u16(lo),  vf));
+    vst1q_u32(acc + i + 4,  vmlal_u16(vld1q_u32(acc + i + 4),  vget_high_u16(lo), vf));
+    vst1q_u32(acc + i + 8,  vmlal_u16(vld1q_u32(acc + i + 8),  vget_low_u16(hi),  vf));
+    vst1q_u32(acc + i + 12, vmlal_u16(vld1q_u32(acc + i + 12), vget_high_u16(hi), vf));
+  }
+#endif
+  for (; i < n; i++)
+    acc[i] += src[i] * f;
+}
+
+// Returns src, or a premultiplied copy of it in buf if the pixels have alpha
+static const uchar *premultiply_row(const uchar *src, uchar *buf, int n, int D) {
+  if (D != 2 && D != 4) return src;
+  for (int i = 0; i < n; i += D) {
+    unsigned a = src[i + D - 1];
+    for (int c = 0; c < D - 1; c++) {
+      unsigned t = src[i + c] * a + 128;       // t / 255, rounded
+      buf[i + c] = (uchar)((t + (t >> 8)) >> 8);
+    }
+    buf[i + D - 1] = (uchar)a;
+  }
+  return buf;
+}
+
+// Undoes premultiply_row() on a destination row
+static void unpremultiply_row(uchar *p, int n, int D) {
+  static unsigned inverse[256];         // 255 / a in 16.16 fixed point
+  if (D != 2 && D != 4) return;
+  if (!inverse[1]) {
+    for (int a = 1; a < 256; a++) inverse[a] = (255 * 65536 + a / 2) / a;
+  }
+  for (int i = 0; i < n; i += D) {
+    unsigned a = p[i + D - 1];
+    if (!a || a == 255) continue;
+    for (int c = 0; c < D - 1; c++) {
+      unsigned v = (p[i + c] * inverse[a] + 32768) >> 16;
+      p[i + c] = (uchar)(v > 255 ? 255 : v);
+    }
+  }
+}
+
+// Computes which of the S source pixels cover each of the N destination
+// pixels and by how much. Destination pixel i uses first[i] and the next
+// count[i] - 1 source pixels, weighted by the next count[i] entries of
+// weight, which add up to total. Returns the weight array.
+static int *area_weights(int S, int N, int total, int *first, int *count) {
+  int *weight = new int[S + N];
+  int k = 0;
+  for (int i = 0; i < N; i++) {
+    double lo = (double)i * S, hi = (double)(i + 1) * S; // in units of 1/N
+    int s0 = (int)(lo / N), s1 = (int)((hi - 1) / N);
+    if (s1 >= S) s1 = S - 1;
+    first[i] = s0;
+    count[i] = s1 - s0 + 1;
+    double sum = 0;
+    int done = 0;
+    for (int s = s0; s <= s1; s++) {
+      double a = (double)s * N, b = a + N;
+      sum += (b < hi ? b : hi) - (a > lo ? a : lo);
+      int next = (int)(sum * total / S + 0.5);
+      weight[k++] = next - done;
+      done = next;
+    }
+  }
+  return weight;
+}
+
 Fl_Image *Fl_RGB_Image::copy(int W, int H) {
   Fl_RGB_Image	*new_image;	// New RGB image
   uchar		*new_array;	// New array for image data
@@ -474,68 +619,80 @@ Fl_Image *Fl_RGB_Image::copy(int W, int H) {
         sy ++;
       }
     }
-  } else {
-    // Bilinear scaling (FL_RGB_SCALING_BILINEAR)
-    const float xscale = (data_w() - 1) / (float) W;
-    const float yscale = (data_h() - 1) / (float) H;
-    for (dy = 0; dy < H; dy++) {
-      float oldy = dy * yscale;
-      if (oldy >= data_h())
-        oldy = float(data_h() - 1);
-      const float yfract = oldy - (unsigned) oldy;
-
+  } else if (Fl_Image::RGB_scaling() == FL_RGB_SCALING_AREA) {
+    // Box filter: each destination pixel is the average of the source area
+    // it covers, vertical weights add up to 4096 and horizontal ones to 32768
+    const int D = d(), sw = data_w(), sh = data_h(), n = sw * D;
+    int *xfirst = new int[W], *xcount = new int[W];
+    int *xweight = area_weights(sw, W, 32768, xfirst, xcount);
+    int *yfirst = new int[H], *ycount = new int[H];
+    int *yweight = area_weights(sh, H, 4096, yfirst, ycount);
+    unsigned *acc = new unsigned[n];
+    uchar *tmp = new uchar[n];
+    const int *wy = yweight;
+
+    for (dy = 0, new_ptr = new_array; dy < H; dy++) {
+      memset(acc, 0, n * sizeof(unsigned));
+      for (int k = 0; k < ycount[dy]; k++) {
+        const uchar *row = premultiply_row(array + (yfirst[dy] + k) * line_d, tmp, n, D);
+        accumulate_row(row, *wy++, acc, n);
+      }
+      const int *wx = xweight;
+      uchar *row_ptr = new_ptr;
       for (dx = 0; dx < W; dx++) {
-        new_ptr = new_array + dy * W * d() + dx * d();
-
-        float oldx = dx * xscale;
-        if (oldx >= data_w())
-          oldx = float(data_w() - 1);
-        const float xfract = oldx - (unsigned) oldx;
-
-        const unsigned leftx = (unsigned)oldx;
-        const unsigned lefty = (unsigned)oldy;
-        const unsigned rightx = (unsigned)(oldx + 1 >= data_w() ? oldx : oldx + 1);
-        const unsigned righty = (unsigned)oldy;
-        const unsigned dleftx = (unsigned)oldx;
-        const unsigned dlefty = (unsigned)(oldy + 1 >= data_h() ? oldy : oldy + 1);
-        const unsigned drightx = (unsigned)rightx;
-        const unsigned drighty = (unsigned)dlefty;
-
-        uchar left[4], right[4], downleft[4], downright[4];
-        memcpy(left, array + lefty * line_d + leftx * d(), d());
-        memcpy(right, array + righty * line_d + rightx * d(), d());
-        memcpy(downleft, array + dlefty * line_d + dleftx * d(), d());
-        memcpy(downright, array + drighty * line_d + drightx * d(), d());
-
-        int i;
-        if (d() == 4) {
-          for (i = 0; i < 3; i++) {
-            left[i] = (uchar)(left[i] * left[3] / 255.0f);
-            right[i] = (uchar)(right[i] * right[3] / 255.0f);
-            downleft[i] = (uchar)(downleft[i] * downleft[3] / 255.0f);
-            downright[i] = (uchar)(downright[i] * downright[3] / 255.0f);
-          }
+        const unsigned *src = acc + xfirst[dx] * D;
+        for (int c = 0; c < D; c++) {
+          unsigned sum = 0;
+          for (int k = 0; k < xcount[dx]; k++) sum += (src[k * D + c] >> 4) * wx[k];
+          sum = (sum + (1 << 22)) >> 23;
+          *new_ptr++ = (uchar)(sum > 255 ? 255 : sum);
         }
+        wx += xcount[dx];
+      }
+      unpremultiply_row(row_ptr, W * D, D);
+    }
 
-	const float leftf = 1 - xfract;
-	const float rightf = xfract;
-	const float upf = 1 - yfract;
-	const float downf = yfract;
+    delete[] xfirst; delete[] xcount; delete[] xweight;
+    delete[] yfirst; delete[] ycount; delete[] yweight;
+    delete[] acc;
+    delete[] tmp;
+  } else {
+    // Bilinear scaling (FL_RGB_SCALING_BILINEAR), with 8 bit weights
+    const int D = d(), sw = data_w(), sh = data_h(), n = sw * D;
+    const double xscale = (sw - 1) / (double) W;
+    const double yscale = (sh - 1) / (double) H;
+    int *xleft = new int[W], *xright = new int[W], *xfract = new int[W];
+    unsigned short *row = new unsigned short[n];
+    uchar *tmp0 = new uchar[n], *tmp1 = new uchar[n];
+
+    for (dx = 0; dx < W; dx++) {
+      int pos = (int)(dx * xscale * 256);
+      xleft[dx] = (pos >> 8) * D;
+      xright[dx] = ((pos >> 8) + 1 < sw ? (pos >> 8) + 1 : sw - 1) * D;
+      xfract[dx] = pos & 255;
+    }
 
-        for (i = 0; i < d(); i++) {
-          new_ptr[i] = (uchar)((left[i] * leftf +
-                   right[i] * rightf) * upf +
-                   (downleft[i] * leftf +
-                   downright[i] * rightf) * downf);
-        }
+    for (dy = 0, new_ptr = new_array; dy < H; dy++) {
+      int pos = (int)(dy * yscale * 256);
+      int sy0 = pos >> 8, sy1 = sy0 + 1 < sh ? sy0 + 1 : sh - 1;
+      const uchar *up = premultiply_row(array + sy0 * line_d, tmp0, n, D);
+      const uchar *down = premultiply_row(array + sy1 * line_d, tmp1, n, D);
+      blend_rows(up, down, pos & 255, row, n);
 
-        if (d() == 4 && new_ptr[3]) {
-          for (i = 0; i < 3; i++) {
-            new_ptr[i] = (uchar)(new_ptr[i] / (new_ptr[3] / 255.0f));
-          }
-        }
+      uchar *row_ptr = new_ptr;
+      for (dx = 0; dx < W; dx++) {
+        const unsigned short *left = row + xleft[dx], *right = row + xright[dx];
+        unsigned f = xfract[dx];
+        for (int c = 0; c < D; c++)
+          *new_ptr++ = (uchar)((left[c] * (256 - f) + right[c] * f + 32768) >> 16);
       }
+      unpremultiply_row(row_ptr, W * D, D);
     }
+
+    delete[] xleft; delete[] xright; delete[] xfract;
+    delete[] row;
+    delete[] tmp0;
+    delete[] tmp1;
   }
 
   return new_image;
@@ -19,6 +19,7 @@
 // Contents:
 //
 //   Fl_JPEG_Image::Fl_JPEG_Image() - Load a JPEG image file.
+//   Fl_JPEG_Image::load_jpg_()     - Load a JPEG image from a file or memory.
 //
 
 //
@@ -32,6 +33,7 @@
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 
 
@@ -98,104 +100,39 @@ extern "C" {
  */
 Fl_JPEG_Image::Fl_JPEG_Image(const char *filename)	// I - File to load
 : Fl_RGB_Image(0,0,0) {
-#ifdef HAVE_LIBJPEG
-  FILE				*fp;	// File pointer
-  jpeg_decompress_struct	dinfo;	// Decompressor info
-  fl_jpeg_error_mgr		jerr;	// Error handler info
-  JSAMPROW			row;	// Sample row pointer
-  
-  // the following variables are pointers allocating some private space that
-  // is not reset by 'setjmp()'
-  char* max_finish_decompress_err;      // count errors and give up afer a while
-  char* max_destroy_decompress_err;     // to avoid recusion and deadlock
-  
-  // Clear data...
-  alloc_array = 0;
-  array = (uchar *)0;
-  
-  // Open the image file...
-  if ((fp = fl_fopen(filename, "rb")) == NULL) {
-    ld(ERR_FILE_ACCESS);
-    return;
-  }
-  
-  // Setup the decompressor info and read the header...
-  dinfo.err                = jpeg_std_error((jpeg_error_mgr *)&jerr);
-  jerr.pub_.error_exit     = fl_jpeg_error_handler;
-  jerr.pub_.output_message = fl_jpeg_output_handler;
-  
-  // Setup error loop variables
-  max_finish_decompress_err = (char*)malloc(1);   // allocate space on the frame for error counters
-  max_destroy_decompress_err = (char*)malloc(1);  // otherwise, the variables are reset on the longjmp
-  *max_finish_decompress_err=10;
-  *max_destroy_decompress_err=10;
-  
-  if (setjmp(jerr.errhand_))
-  {
-    // JPEG error handling...
-    Fl::warning("JPEG file \"%s\" is too large or contains errors!\n", filename);
-    // if any of the cleanup routines hits another error, we would end up 
-    // in a loop. So instead, we decrement max_err for some upper cleanup limit.
-    if ( ((*max_finish_decompress_err)-- > 0) && array)
-      jpeg_finish_decompress(&dinfo);
-    if ( (*max_destroy_decompress_err)-- > 0)
-      jpeg_destroy_decompress(&dinfo);
-    
-    fclose(fp);
-    
-    w(0);
-    h(0);
-    d(0);
-    
-    if (array) {
-      delete[] (uchar *)array;
-      array = 0;
-      alloc_array = 0;
-    }
-    
-    free(max_destroy_decompress_err);
-    free(max_finish_decompress_err);
-    
-    ld(ERR_FORMAT);
-    return;
-  }
-  
-  jpeg_create_decompress(&dinfo);
-  jpeg_stdio_src(&dinfo, fp);
-  jpeg_read_header(&dinfo, TRUE);
-  
-  dinfo.quantize_colors      = (boolean)FALSE;
-  dinfo.out_color_space      = JCS_RGB;
-  dinfo.out_color_components = 3;
-  dinfo.output_components    = 3;
-  
-  jpeg_calc_output_dimensions(&dinfo);
-  
-  w(dinfo.output_width); 
-  h(dinfo.output_height);
-  d(dinfo.output_components);
-  
-  if (((size_t)w()) * h() * d() > max_size() ) longjmp(jerr.errhand_, 1);
-  array = new uchar[w() * h() * d()];
-  alloc_array = 1;
-  
-  jpeg_start_decompress(&dinfo);
-  
-  while (dinfo.output_scanline < dinfo.output_height) {
-    row = (JSAMPROW)(array +
-                     dinfo.output_scanline * dinfo.output_width *
-                     dinfo.output_components);
-    jpeg_read_scanlines(&dinfo, &row, (JDIMENSION)1);
-  }
-  
-  jpeg_finish_decompress(&dinfo);
-  jpeg_destroy_decompress(&dinfo);
-  
-  free(max_destroy_decompress_err);
-  free(max_finish_decompress_err);
-  
-  fclose(fp);
-#endif // HAVE_LIBJPEG
+  load_jpg_(filename, 0L, 0L, 0, 0, 0L, 0L);
+}
+
+
+/**
+ \brief The constructor loads the JPEG image from the given jpeg filename,
+ at a reduced size and progressively.
+
+ The JPEG decoder can decode an image at 1/2, 1/4 or 1/8 of its size much
+ faster than at full size, and without the memory for the full size image.
+ The image is decoded at the smallest of these sizes that is at least
+ \p W x \p H, so w() and h() can be larger than \p W and \p H. Use
+ scale() or copy() to get the exact size. A \p W or \p H of 0 decodes the
+ image at full size.
+
+ If \p cb is not NULL, it is called while the image is decoded with the
+ rows that are ready. The image data are cleared first, so the partial
+ image can be drawn at any time, see Fl_Image_Progress_Cb. A baseline
+ JPEG file is decoded from top to bottom, a progressive JPEG file is
+ decoded at increasing quality, and the callback gets all rows after each
+ pass.
+
+ \param[in] filename a full path and name pointing to a valid jpeg file.
+ \param[in] W, H the minimal size of the decoded image, or 0
+ \param[in] cb the function called with the decoded rows, or NULL
+ \param[in] data user data passed to \p cb
+ \see Fl_JPEG_Image(const char *filename)
+ \since FLTK 1.4.0
+ */
+Fl_JPEG_Image::Fl_JPEG_Image(const char *filename, int W, int H,
+                             Fl_Image_Progress_Cb cb, void *data)
+: Fl_RGB_Image(0,0,0) {
+  load_jpg_(filename, 0L, 0L, W, H, cb, data);
 }
 
 
@@ -292,11 +229,24 @@ static void jpeg_mem_src(j_decompress_ptr cinfo, const unsigned char *data)
  */
 Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
 : Fl_RGB_Image(0,0,0) {
+  load_jpg_(0L, name, data, 0, 0, 0L, 0L);
+}
+
+
+/**
+ The protected load_jpg_() method loads the image from a file or from memory
+ for the constructors, at the size and with the callback given.
+ */
+void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const unsigned char *data,
+                              int W, int H, Fl_Image_Progress_Cb cb, void *cb_data)
+{
 #ifdef HAVE_LIBJPEG
   jpeg_decompress_struct	dinfo;	// Decompressor info
   fl_jpeg_error_mgr		jerr;	// Error handler info
   JSAMPROW			row;	// Sample row pointer
   
+  FILE * volatile		fp = 0L;	// File pointer, volatile for setjmp()
+
   // the following variables are pointers allocating some private space that
   // is not reset by 'setjmp()'
   char* max_finish_decompress_err;      // count errors and give up afer a while
@@ -306,6 +256,19 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   alloc_array = 0;
   array = (uchar *)0;
   
+  // Open the image file if we read from the file system
+  if (filename) {
+    if ((fp = fl_fopen(filename, "rb")) == NULL) {
+      ld(ERR_FILE_ACCESS);
+      return;
+    }
+  } else {
+    if (data == 0L) {
+      ld(ERR_FILE_ACCESS);
+      return;
+    }
+  }
+  
   // Setup the decompressor info and read the header...
   dinfo.err                = jpeg_std_error((jpeg_error_mgr *)&jerr);
   jerr.pub_.error_exit     = fl_jpeg_error_handler;
@@ -320,7 +283,10 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   if (setjmp(jerr.errhand_))
   {
     // JPEG error handling...
-    Fl::warning("JPEG data is too large or contains errors!\n");
+    const char *name = "<unnamed>";
+    if (filename) name = filename;
+    else if (sharename) name = sharename;
+    Fl::warning("JPEG file \"%s\" is too large or contains errors!\n", name);
     // if any of the cleanup routines hits another error, we would end up 
     // in a loop. So instead, we decrement max_err for some upper cleanup limit.
     if ( ((*max_finish_decompress_err)-- > 0) && array)
@@ -328,6 +294,9 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
     if ( (*max_destroy_decompress_err)-- > 0)
       jpeg_destroy_decompress(&dinfo);
     
+    if (fp)
+      fclose(fp);
+    
     w(0);
     h(0);
     d(0);
@@ -341,11 +310,16 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
     free(max_destroy_decompress_err);
     free(max_finish_decompress_err);
     
+    ld(ERR_FORMAT);
     return;
   }
   
   jpeg_create_decompress(&dinfo);
-  jpeg_mem_src(&dinfo, data);
+  if (fp) {
+    jpeg_stdio_src(&dinfo, fp);
+  } else {
+    jpeg_mem_src(&dinfo, data);
+  }
   jpeg_read_header(&dinfo, TRUE);
   
   dinfo.quantize_colors      = (boolean)FALSE;
@@ -353,6 +327,16 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   dinfo.out_color_components = 3;
   dinfo.output_components    = 3;
   
+  // Decode at the smallest scale that is still at least W x H
+  if (W > 0 && H > 0) {
+    dinfo.scale_num = 1;
+    dinfo.scale_denom = 1;
+    while (dinfo.scale_denom < 8 &&
+           dinfo.image_width / (dinfo.scale_denom * 2) >= (JDIMENSION)W &&
+           dinfo.image_height / (dinfo.scale_denom * 2) >= (JDIMENSION)H)
+      dinfo.scale_denom *= 2;
+  }
+  
   jpeg_calc_output_dimensions(&dinfo);
   
   w(dinfo.output_width); 
@@ -363,13 +347,45 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   array = new uchar[w() * h() * d()];
   alloc_array = 1;
   
+  if (cb) {
+    // partial images must be drawable
+    memset((uchar *)array, 0, w() * h() * d());
+    if (jpeg_has_multiple_scans(&dinfo))
+      dinfo.buffered_image = TRUE;
+  }
+  
   jpeg_start_decompress(&dinfo);
   
-  while (dinfo.output_scanline < dinfo.output_height) {
-    row = (JSAMPROW)(array +
-                     dinfo.output_scanline * dinfo.output_width *
-                     dinfo.output_components);
-    jpeg_read_scanlines(&dinfo, &row, (JDIMENSION)1);
+  if (dinfo.buffered_image) {
+    // Progressive JPEG: output the image after each scan that was read
+    for (;;) {
+      jpeg_start_output(&dinfo, dinfo.input_scan_number);
+      while (dinfo.output_scanline < dinfo.output_height) {
+        row = (JSAMPROW)(array +
+                         dinfo.output_scanline * dinfo.output_width *
+                         dinfo.output_components);
+        jpeg_read_scanlines(&dinfo, &row, (JDIMENSION)1);
+      }
+      jpeg_finish_output(&dinfo);
+      cb(this, 0, h(), cb_data);
+      if (jpeg_input_complete(&dinfo) &&
+          dinfo.output_scan_number == dinfo.input_scan_number) break;
+    }
+  } else {
+    // report rows in about 16 steps
+    int step = h() / 16, done = 0;
+    if (step < 16) step = 16;
+    while (dinfo.output_scanline < dinfo.output_height) {
+      row = (JSAMPROW)(array +
+                       dinfo.output_scanline * dinfo.output_width *
+                       dinfo.output_components);
+      jpeg_read_scanlines(&dinfo, &row, (JDIMENSION)1);
+      int y = dinfo.output_scanline;
+      if (cb && (y - done >= step || y == h())) {
+        cb(this, done, y - done, cb_data);
+        done = y;
+      }
+    }
   }
   
   jpeg_finish_decompress(&dinfo);
@@ -377,14 +393,18 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   
   free(max_destroy_decompress_err);
   free(max_finish_decompress_err);
-
-  if (w() && h() && name) {
-    Fl_Shared_Image *si = new Fl_Shared_Image(name, this);
+  
+  if (fp)
+    fclose(fp);
+  
+  if (sharename && w() && h()) {
+    Fl_Shared_Image *si = new Fl_Shared_Image(sharename, this);
     si->add();
   }
 #endif // HAVE_LIBJPEG
 }
 
+
 //
 // End of "$Id$".
 //
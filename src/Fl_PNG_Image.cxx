@@ -37,6 +37,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if defined(HAVE_LIBPNG) && defined(HAVE_LIBZ)
 extern "C"
@@ -93,6 +94,28 @@ Fl_PNG_Image::Fl_PNG_Image (const char *filename): Fl_RGB_Image(0,0,0)
 }
 
 
+/**
+ The constructor loads the named PNG image from the given png filename
+ progressively.
+
+ The image data are cleared first, then \p cb is called while the image is
+ decoded with the rows that are ready, so that the partial image can be
+ drawn, see Fl_Image_Progress_Cb. An interlaced PNG file is decoded at
+ increasing resolution, and the callback gets all rows after each of its
+ seven passes.
+
+ \param[in] filename	Name of PNG file to read
+ \param[in] cb	the function called with the decoded rows, or NULL
+ \param[in] data	user data passed to \p cb
+ \see Fl_PNG_Image(const char *filename)
+ \since FLTK 1.4.0
+ */
+Fl_PNG_Image::Fl_PNG_Image (const char *filename, Fl_Image_Progress_Cb cb, void *data): Fl_RGB_Image(0,0,0)
+{
+  load_png_(filename, NULL, 0, cb, data);
+}
+
+
 /**
  \brief Constructor that reads a PNG image from memory.
 
@@ -112,7 +135,8 @@ Fl_PNG_Image::Fl_PNG_Image (
 }
 
 
-void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_png, int maxsize)
+void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_png, int maxsize,
+                             Fl_Image_Progress_Cb cb, void *cb_data)
 {
 #if defined(HAVE_LIBPNG) && defined(HAVE_LIBZ)
   int i;		// Looping var
@@ -123,10 +147,11 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
   fl_png_memory png_mem_data;
   int from_memory = (buffer_png != NULL); // true if reading image from memory
 
-  // Note: The file pointer fp must not be an automatic (stack) variable
-  // to avoid potential clobbering by setjmp/longjmp (gcc: [-Wclobbered]).
-  static FILE *fp;	// intentionally initialized separately below
-  fp = NULL;		// always initialize file pointer
+  // Note: The file pointer fp must be volatile to avoid potential clobbering
+  // by setjmp/longjmp (gcc: [-Wclobbered]). It must not be static either,
+  // because images can be loaded by several threads, see
+  // Fl_Shared_Image::get_async().
+  FILE * volatile fp = NULL;
 
   if (!from_memory) {
     if ((fp = fl_fopen(name_png, "rb")) == NULL) {
@@ -210,10 +235,36 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
     rows[i] = (png_bytep)(array + i * w() * d());
 
   // Read the image, handling interlacing as needed...
-  for (i = png_set_interlace_handling(pp); i > 0; i --)
-    png_read_rows(pp, rows, NULL, h());
-
-  if (channels == 4) Fl::system_driver()->png_extra_rgba_processing((uchar*)array, w(), h());
+  int passes = png_set_interlace_handling(pp);
+  if (!cb) {
+    for (i = passes; i > 0; i --)
+      png_read_rows(pp, rows, NULL, h());
+    if (channels == 4) Fl::system_driver()->png_extra_rgba_processing((uchar*)array, w(), h());
+  } else if (passes > 1) {
+    // partial images must be drawable, later passes fill in more pixels
+    memset((uchar *)array, 0, w() * h() * d());
+    for (i = passes; i > 0; i --) {
+      png_read_rows(pp, rows, NULL, h());
+      // every pass is drawn, so it must be processed like the whole image;
+      // the processing is repeated on the pixels of earlier passes, which
+      // it does not change again
+      if (channels == 4)
+        Fl::system_driver()->png_extra_rgba_processing((uchar*)array, w(), h());
+      cb(this, 0, h(), cb_data);
+    }
+  } else {
+    // report rows in about 16 steps
+    int step = h() / 16;
+    if (step < 16) step = 16;
+    memset((uchar *)array, 0, w() * h() * d());
+    for (i = 0; i < h(); i += step) {
+      int n = h() - i < step ? h() - i : step;
+      png_read_rows(pp, rows + i, NULL, n);
+      if (channels == 4)
+        Fl::system_driver()->png_extra_rgba_processing((uchar*)rows[i], w(), n);
+      cb(this, i, n, cb_data);
+    }
+  }
 
   // Free memory and return...
   delete[] rows;
@@ -3,7 +3,7 @@
 //
 // SVG image code for the Fast Light Tool Kit (FLTK).
 //
-// Copyright 2017 by Bill Spitzak and others.
+// Copyright 2017-2019 by Bill Spitzak and others.
 //
 // This library is free software. Distribution and use rights are outlined in
 // the file "COPYING" which should have been included with this file.  If this
@@ -16,7 +16,7 @@
 //     http://www.fltk.org/str.php
 //
 
-#include <config.h>
+#include "config_lib.h"
 
 #if defined(FLTK_USE_NANOSVG) || defined(FL_DOXYGEN)
 
@@ -26,6 +26,7 @@
 #include "Fl_Screen_Driver.H"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if !defined(HAVE_LONG_LONG)
 static double strtoll(const char *str, char **endptr, int base) {
@@ -44,6 +45,296 @@ static double strtoll(const char *str, char **endptr, int base) {
 #include <zlib.h>
 #endif
 
+#if defined(FL_CFG_SYS_WIN32)
+#  include <windows.h>
+#  define SVG_THREADS 1
+#elif defined(FL_CFG_SYS_POSIX) && defined(HAVE_PTHREAD)
+#  include <pthread.h>
+#  include <unistd.h>
+#  define SVG_THREADS 1
+#else
+#  define SVG_THREADS 0
+#endif
+
+#define SVG_MIN_PARALLEL (256*256)      // smaller images are rasterized by one thread
+#define SVG_MIN_BAND 32                 // minimum number of rows per band
+#define SVG_MAX_THREADS 8               // maximum number of threads, with the caller
+#define SVG_RASTER_SIZES 8              // sizes without pixels remembered per SVG image
+
+/*
+ A size to which the SVG data of an image were rasterized.
+
+ All copies of an Fl_SVG_Image share the parsed SVG data and a list of the
+ sizes they were rasterized to, most recently used first. A size keeps its
+ pixels from the second time it is rasterized on, so that sizes used only
+ once, as while a window is resized, do not fill the cache. The copies of
+ an image that show a kept size use its pixels without copying them, until
+ desaturate() or color_average() give them pixels of their own.
+
+ The pixels of all images share the memory budget set by
+ Fl_SVG_Image::raster_cache_size(), and those of the least recently used
+ sizes that no image shows are freed first. Like the rasterizer, the cache
+ assumes that only one thread uses it at a time.
+ */
+struct Fl_SVG_Raster {
+  int w, h;
+  double fx, fy;
+  uchar *pixels;                // NULL if the pixels are not kept
+  int users;                    // number of images that show the pixels
+  Fl_SVG_Raster *next;          // next size of the same SVG data
+  Fl_SVG_Raster *older, *newer; // LRU list of the sizes with pixels
+};
+
+static Fl_SVG_Raster *raster_oldest, *raster_newest;
+static size_t raster_bytes = 0;
+size_t Fl_SVG_Image::raster_cache_size_ = 32 * 1024 * 1024;
+
+static void raster_unlink_lru(Fl_SVG_Raster *r) {
+  if (r->older) r->older->newer = r->newer;
+  else raster_oldest = r->newer;
+  if (r->newer) r->newer->older = r->older;
+  else raster_newest = r->older;
+}
+
+static void raster_link_lru(Fl_SVG_Raster *r) {
+  r->older = raster_newest;
+  r->newer = NULL;
+  if (raster_newest) raster_newest->newer = r;
+  else raster_oldest = r;
+  raster_newest = r;
+}
+
+// Frees the pixels of a size, which stays in the list of its image
+static void raster_free(Fl_SVG_Raster *r) {
+  raster_unlink_lru(r);
+  raster_bytes -= (size_t)r->w * r->h * 4;
+  delete[] r->pixels;
+  r->pixels = NULL;
+}
+
+// Frees the pixels of the least recently used sizes that no image shows
+// until the cache holds no more than budget bytes
+static void raster_trim(size_t budget) {
+  Fl_SVG_Raster *r = raster_oldest;
+  while (r && raster_bytes > budget) {
+    Fl_SVG_Raster *newer = r->newer;
+    if (!r->users) raster_free(r);
+    r = newer;
+  }
+}
+
+/*
+ Parallel rasterization of large images.
+
+ The image is cut into horizontal bands that worker threads, each with its
+ own NSVGrasterizer, rasterize in parallel with the calling thread. Since
+ nsvgRasterizeXY() shifts the image by -y0 rows to rasterize the band
+ starting at row y0, the bands are identical to the rows of the whole image.
+ Like the single rasterizer used before, the pool assumes that only one
+ thread rasterizes SVG images at a time.
+ */
+struct Fl_SVG_Band_Job {
+  NSVGimage *image;             // the image to rasterize, NULL when idle
+  double fx, fy;
+  uchar *pixels;
+  int w, h;
+  int band_h;                   // number of rows per band
+  int bands;                    // number of bands
+  int next;                     // next band to rasterize
+  int done;                     // number of bands rasterized
+};
+
+static Fl_SVG_Band_Job band_job;
+static int svg_workers = -1;    // number of worker threads, -1 before starting them
+
+static void rasterize_band(NSVGrasterizer *r, Fl_SVG_Band_Job *job, int b) {
+  int y0 = b * job->band_h;
+  int h = job->h - y0;
+  if (h > job->band_h) h = job->band_h;
+  nsvgRasterizeXY(r, job->image, 0, -y0, job->fx, job->fy,
+                  job->pixels + y0 * job->w * 4, job->w, h, job->w * 4);
+}
+
+#if SVG_THREADS
+
+#  if defined(FL_CFG_SYS_WIN32)
+
+static CRITICAL_SECTION pool_cs;
+static HANDLE pool_work;                // semaphore, counts the wake-ups of the workers
+static HANDLE pool_done;                // auto-reset event, set when all bands are done
+
+static void lock_pool() { EnterCriticalSection(&pool_cs); }
+static void unlock_pool() { LeaveCriticalSection(&pool_cs); }
+
+static void init_pool() {
+  InitializeCriticalSection(&pool_cs);
+  pool_work = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+  pool_done = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+static int count_cpus() {
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+}
+
+static void wake_workers(int n) { ReleaseSemaphore(pool_work, n, NULL); }
+static void wait_work() { WaitForSingleObject(pool_work, INFINITE); }
+
+// Call with the pool locked
+static void signal_done() { SetEvent(pool_done); }
+
+static void wait_done() {
+  for (;;) {
+    lock_pool();
+    int pending = band_job.done < band_job.bands;
+    unlock_pool();
+    if (!pending) break;
+    WaitForSingleObject(pool_done, INFINITE);
+  }
+}
+
+static DWORD WINAPI band_worker(LPVOID);
+
+static int start_thread() {
+  HANDLE h = CreateThread(NULL, 0, band_worker, NULL, 0, NULL);
+  if (!h) return 0;
+  CloseHandle(h);
+  return 1;
+}
+
+#  else // pthreads
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static int work_count = 0;              // pending wake-ups of the workers
+
+static void lock_pool() { pthread_mutex_lock(&pool_mutex); }
+static void unlock_pool() { pthread_mutex_unlock(&pool_mutex); }
+static void init_pool() { }
+
+static int count_cpus() {
+#    if defined(_SC_NPROCESSORS_ONLN)
+  return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#    else
+  return 1;
+#    endif
+}
+
+static void wake_workers(int n) {
+  pthread_mutex_lock(&pool_mutex);
+  work_count += n;
+  pthread_cond_broadcast(&work_cond);
+  pthread_mutex_unlock(&pool_mutex);
+}
+
+static void wait_work() {
+  pthread_mutex_lock(&pool_mutex);
+  while (!work_count) pthread_cond_wait(&work_cond, &pool_mutex);
+  work_count--;
+  pthread_mutex_unlock(&pool_mutex);
+}
+
+// Call with the pool locked
+static void signal_done() { pthread_cond_signal(&done_cond); }
+
+static void wait_done() {
+  pthread_mutex_lock(&pool_mutex);
+  while (band_job.done < band_job.bands) pthread_cond_wait(&done_cond, &pool_mutex);
+  pthread_mutex_unlock(&pool_mutex);
+}
+
+static void *band_worker(void *);
+
+static int start_thread() {
+  pthread_t t;
+  if (pthread_create(&t, NULL, band_worker, NULL) != 0) return 0;
+  pthread_detach(t);
+  return 1;
+}
+
+#  endif // FL_CFG_SYS_WIN32
+
+// Rasterizes bands of the current job until none is left
+static void run_bands(NSVGrasterizer *r) {
+  for (;;) {
+    lock_pool();
+    if (!band_job.image || band_job.next >= band_job.bands) {
+      unlock_pool();
+      return;
+    }
+    int b = band_job.next++;
+    unlock_pool();
+    rasterize_band(r, &band_job, b);
+    lock_pool();
+    if (++band_job.done == band_job.bands) signal_done();
+    unlock_pool();
+  }
+}
+
+#  if defined(FL_CFG_SYS_WIN32)
+static DWORD WINAPI band_worker(LPVOID)
+#  else
+static void *band_worker(void *)
+#  endif
+{
+  NSVGrasterizer *r = nsvgCreateRasterizer();
+  for (;;) {
+    wait_work();
+    // a late wake-up finds no band left, or joins the next job
+    run_bands(r);
+  }
+#  if !defined(FL_CFG_SYS_WIN32)
+  return 0;
+#  endif
+}
+
+static void start_workers() {
+  init_pool();
+  int n = count_cpus();
+  if (n > SVG_MAX_THREADS) n = SVG_MAX_THREADS;
+  svg_workers = 0;
+  while (svg_workers < n - 1 && start_thread()) svg_workers++;
+}
+
+#endif // SVG_THREADS
+
+// Rasterizes the SVG data to W*H pixels, in parallel if the image is large
+static void rasterize_svg(NSVGimage *image, double fx, double fy, uchar *pixels, int W, int H) {
+  static NSVGrasterizer *rasterizer = nsvgCreateRasterizer();
+#if SVG_THREADS
+  if (W * H >= SVG_MIN_PARALLEL && H >= 2 * SVG_MIN_BAND) {
+    if (svg_workers < 0) start_workers();
+    if (svg_workers > 0) {
+      // twice as many bands as threads balances bands of unequal complexity
+      int bands = 2 * (svg_workers + 1);
+      if (bands > H / SVG_MIN_BAND) bands = H / SVG_MIN_BAND;
+      lock_pool();
+      band_job.image = image;
+      band_job.fx = fx;
+      band_job.fy = fy;
+      band_job.pixels = pixels;
+      band_job.w = W;
+      band_job.h = H;
+      band_job.band_h = (H + bands - 1) / bands;
+      band_job.bands = (H + band_job.band_h - 1) / band_job.band_h;
+      band_job.next = 0;
+      band_job.done = 0;
+      unlock_pool();
+      wake_workers(band_job.bands - 1 < svg_workers ? band_job.bands - 1 : svg_workers);
+      run_bands(rasterizer);
+      wait_done();
+      lock_pool();
+      band_job.image = NULL;
+      unlock_pool();
+      return;
+    }
+  }
+#endif // SVG_THREADS
+  nsvgRasterizeXY(rasterizer, image, 0, 0, fx, fy, pixels, W, H, W*4);
+}
+
 /** The constructor loads the SVG image from the given .svg/.svgz filename or in-memory data.
  \param filename Name of a .svg or .svgz file, or NULL.
  \param svg_data A pointer to the memory location of the SVG image data.
@@ -63,13 +354,49 @@ Fl_SVG_Image::Fl_SVG_Image(Fl_SVG_Image *source) : Fl_RGB_Image(NULL, 0, 0, 4) {
 
 /** The destructor frees all memory and server resources that are used by the SVG image. */
 Fl_SVG_Image::~Fl_SVG_Image() {
+  if (raster_) {
+    array = NULL;       // not allocated by the image
+    release_raster_();
+  }
   if ( --counted_svg_image_->ref_count <= 0) {
+    Fl_SVG_Raster *r = counted_svg_image_->rasters;
+    while (r) {
+      Fl_SVG_Raster *next = r->next;
+      if (r->pixels) raster_free(r);
+      delete r;
+      r = next;
+    }
     nsvgDelete(counted_svg_image_->svg_image);
     delete counted_svg_image_;
   }
 }
 
 
+/** Sets the memory budget in bytes for the rasterized sizes of all SVG images.
+
+ The pixels of a size to which an SVG image was rasterized more than once are
+ kept, so that copies of that size and switching back to it do not rasterize
+ the SVG data again. The least recently used sizes that no image shows are
+ freed first. The default is 32 MB, 0 keeps no pixels.
+ \since FLTK 1.4.0
+ */
+void Fl_SVG_Image::raster_cache_size(size_t bytes) {
+  raster_cache_size_ = bytes;
+  raster_trim(bytes);
+}
+
+
+// Stops showing the kept pixels of a size, the caller has reset array
+void Fl_SVG_Image::release_raster_() {
+  if (--raster_->users == 0) {
+    raster_unlink_lru(raster_);
+    raster_link_lru(raster_);
+    raster_trim(raster_cache_size_);
+  }
+  raster_ = NULL;
+}
+
+
 float Fl_SVG_Image::svg_scaling_(int W, int H) {
   float f1 = float(W) / int(counted_svg_image_->svg_image->width+0.5);
   float f2 = float(H) / int(counted_svg_image_->svg_image->height+0.5);
@@ -125,6 +452,7 @@ void Fl_SVG_Image::init_(const char *filename, const char *in_filedata, Fl_SVG_I
     counted_svg_image_ = new counted_NSVGimage;
     counted_svg_image_->svg_image = NULL;
     counted_svg_image_->ref_count = 1;
+    counted_svg_image_->rasters = NULL;
   }
   char *filedata = NULL;
   to_desaturate_ = false;
@@ -171,11 +499,11 @@ void Fl_SVG_Image::init_(const char *filename, const char *in_filedata, Fl_SVG_I
     h(copy_source->h());
   }
   rasterized_ = false;
+  raster_ = NULL;
 }
 
 
 void Fl_SVG_Image::rasterize_(int W, int H) {
-  static NSVGrasterizer *rasterizer = nsvgCreateRasterizer();
   double fx, fy;
   if (proportional) {
     fx = svg_scaling_(W, H);
@@ -184,13 +512,60 @@ void Fl_SVG_Image::rasterize_(int W, int H) {
     fx = (double)W / counted_svg_image_->svg_image->width;
     fy = (double)H / counted_svg_image_->svg_image->height;
   }
-  array = new uchar[W*H*4];
-  nsvgRasterizeXY(rasterizer, counted_svg_image_->svg_image, 0, 0, fx, fy, (uchar* )array, W, H, W*4);
-  alloc_array = 1;
+  // look for this size among the sizes the SVG data were rasterized to
+  Fl_SVG_Raster **p = &counted_svg_image_->rasters, *r;
+  while ((r = *p) != NULL &&
+         (r->w != W || r->h != H || r->fx != fx || r->fy != fy)) p = &r->next;
+  int again = (r != NULL);
+  if (r) {
+    *p = r->next;
+  } else {
+    r = new Fl_SVG_Raster;
+    r->w = W; r->h = H;
+    r->fx = fx; r->fy = fy;
+    r->pixels = NULL;
+    r->users = 0;
+  }
+  // put it first, forget the least recently used sizes without pixels
+  r->next = counted_svg_image_->rasters;
+  counted_svg_image_->rasters = r;
+  int n = 0;
+  for (p = &r->next; *p; ) {
+    Fl_SVG_Raster *old = *p;
+    if (old->pixels || ++n <= SVG_RASTER_SIZES) { p = &old->next; continue; }
+    *p = old->next;
+    delete old;
+  }
+  size_t bytes = (size_t)W * H * 4;
+  if (r->pixels) {
+    raster_unlink_lru(r);
+    raster_link_lru(r);
+    array = r->pixels;
+  } else {
+    uchar *pixels = new uchar[bytes];
+    rasterize_svg(counted_svg_image_->svg_image, fx, fy, pixels, W, H);
+    array = pixels;
+    if (again && bytes <= raster_cache_size_) {
+      raster_trim(raster_cache_size_ - bytes);
+      if (raster_bytes + bytes <= raster_cache_size_) { // the cache takes the pixels
+        r->pixels = pixels;
+        raster_link_lru(r);
+        raster_bytes += bytes;
+      }
+    }
+  }
+  if (r->pixels) {
+    r->users++;
+    raster_ = r;
+    alloc_array = 0;
+  } else {
+    alloc_array = 1;
+  }
   data((const char * const *)&array, 1);
   d(4);
   if (to_desaturate_) Fl_RGB_Image::desaturate();
   if (average_weight_ < 1) Fl_RGB_Image::color_average(average_color_, average_weight_);
+  if (raster_ && array != raster_->pixels) release_raster_(); // the image has its own pixels now
   rasterized_ = true;
   raster_w_ = W;
   raster_h_ = H;
@@ -226,9 +601,10 @@ void Fl_SVG_Image::resize(int width, int height) {
   w(w1); h(h1);
   if (rasterized_ && w1 == raster_w_ && h1 == raster_h_) return;
   if (array) {
-    delete[] array;
+    if (alloc_array) delete[] array;
     array = NULL;
   }
+  if (raster_) release_raster_();
   uncache();
   rasterize_(w1, h1);
 }
@@ -255,6 +631,7 @@ void Fl_SVG_Image::draw(int X, int Y, int W, int H, int cx, int cy) {
 void Fl_SVG_Image::desaturate() {
   to_desaturate_ = true;
   Fl_RGB_Image::desaturate();
+  if (raster_ && array != raster_->pixels) release_raster_();
 }
 
 
@@ -262,6 +639,7 @@ void Fl_SVG_Image::color_average(Fl_Color c, float i) {
   average_color_ = c;
   average_weight_ = i;
   Fl_RGB_Image::color_average(c, i);
+  if (raster_ && array != raster_->pixels) release_raster_();
 }
 
 #endif // FLTK_USE_NANOSVG
@@ -40,17 +40,38 @@ Fl_Shared_Handler *Fl_Shared_Image::handlers_ = 0;// Additional format handlers
 int	Fl_Shared_Image::num_handlers_ = 0;	// Number of format handlers
 int	Fl_Shared_Image::alloc_handlers_ = 0;	// Allocated format handlers
 
+Fl_Shared_Image **Fl_Shared_Image::hash_ = 0;	// Hash table on the image names
+int	Fl_Shared_Image::hash_size_ = 0;	// Number of hash buckets
+Fl_Shared_Image *Fl_Shared_Image::lru_first_ = 0; // Least recently released
+Fl_Shared_Image *Fl_Shared_Image::lru_last_ = 0; // Most recently released
+size_t	Fl_Shared_Image::cache_size_ = 0;	// Memory for released images
+size_t	Fl_Shared_Image::cache_bytes_ = 0;	// Memory used by cached images
+unsigned long Fl_Shared_Image::cache_hits_ = 0;
+unsigned long Fl_Shared_Image::cache_misses_ = 0;
+unsigned long Fl_Shared_Image::cache_evictions_ = 0;
+
+
+// Hash value of an image name (FNV-1a)
+static unsigned name_hash(const char *name) {
+  unsigned h = 2166136261U;
+  while (*name) h = (h ^ (uchar)*name++) * 16777619U;
+  return h;
+}
 
-//
-// Typedef the C API sort function type the only way I know how...
-//
 
-extern "C" {
-  typedef int (*compare_func_t)(const void *, const void *);
+// Approximate memory used by the data of an image
+static size_t image_bytes(Fl_Image *img) {
+  if (!img) return 0;
+  size_t pixels = (size_t)img->data_w() * img->data_h();
+  if (img->d() > 0) return pixels * img->d();
+  if (img->d() == 0) return pixels / 8;         // bitmap
+  return pixels * 4;                            // pixmap, drawn as RGBA
 }
 
 
-/** Returns the Fl_Shared_Image* array */
+/** Returns the Fl_Shared_Image* array.
+  The images are not in any particular order.
+*/
 Fl_Shared_Image **Fl_Shared_Image::images() {
   return images_;
 }
@@ -78,9 +99,8 @@ int Fl_Shared_Image::num_images() {
   An image is marked \p original if it was directly loaded from a file or
   from memory as opposed to copied and resized images.
 
-  This comparison is used in Fl_Shared_Image::find() to find an image that
-  matches the requested one or to find the position where a new image
-  should be entered into the sorted list of shared images.
+  This comparison is the rule Fl_Shared_Image::find() uses to find an image
+  that matches the requested one.
 
   It is usually used in two steps:
 
@@ -123,6 +143,11 @@ Fl_Shared_Image::Fl_Shared_Image() : Fl_Image(0,0,0) {
   original_    = 0;
   image_       = 0;
   alloc_image_ = 0;
+  index_       = -1;
+  bytes_       = 0;
+  hash_next_   = 0;
+  lru_prev_    = lru_next_ = 0;
+  job_         = 0;
 }
 
 
@@ -143,6 +168,11 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,		// I - Filename
   image_       = img;
   alloc_image_ = !img;
   original_    = 1;
+  index_       = -1;
+  bytes_       = 0;
+  hash_next_   = 0;
+  lru_prev_    = lru_next_ = 0;
+  job_         = 0;
 
   if (!img) reload();
   else update();
@@ -152,10 +182,10 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,		// I - Filename
 /**
   Adds a shared image to the image cache.
 
-  This \b protected method adds an image to the cache, an ordered list
-  of shared images. The cache is searched for a matching image whenever
-  one is requested, for instance with Fl_Shared_Image::get() or
-  Fl_Shared_Image::find().
+  This \b protected method adds an image to the cache, a hash table of
+  shared images on the image name. The cache is searched for a matching
+  image whenever one is requested, for instance with Fl_Shared_Image::get()
+  or Fl_Shared_Image::find().
 */
 void
 Fl_Shared_Image::add() {
@@ -163,7 +193,8 @@ Fl_Shared_Image::add() {
 
   if (num_images_ >= alloc_images_) {
     // Allocate more memory...
-    temp = new Fl_Shared_Image *[alloc_images_ + 32];
+    int alloc = alloc_images_ ? 2 * alloc_images_ : 32;
+    temp = new Fl_Shared_Image *[alloc];
 
     if (alloc_images_) {
       memcpy(temp, images_, alloc_images_ * sizeof(Fl_Shared_Image *));
@@ -172,16 +203,109 @@ Fl_Shared_Image::add() {
     }
 
     images_       = temp;
-    alloc_images_ += 32;
+    alloc_images_ = alloc;
   }
 
+  index_ = num_images_;
   images_[num_images_] = this;
   num_images_ ++;
 
-  if (num_images_ > 1) {
-    qsort(images_, num_images_, sizeof(Fl_Shared_Image *),
-          (compare_func_t)compare);
+  if (num_images_ > hash_size_) {
+    // Grow the hash table and rehash all images...
+    delete[] hash_;
+    hash_size_ = hash_size_ ? 2 * hash_size_ : 64;
+    hash_ = new Fl_Shared_Image *[hash_size_];
+    memset(hash_, 0, hash_size_ * sizeof(Fl_Shared_Image *));
+    for (int i = 0; i < num_images_; i ++) {
+      Fl_Shared_Image *img = images_[i];
+      Fl_Shared_Image **bucket = hash_ + (name_hash(img->name_) & (hash_size_ - 1));
+      img->hash_next_ = *bucket;
+      *bucket = img;
+    }
+  } else {
+    Fl_Shared_Image **bucket = hash_ + (name_hash(name_) & (hash_size_ - 1));
+    hash_next_ = *bucket;
+    *bucket = this;
   }
+
+  bytes_ = image_bytes(image_);
+  cache_bytes_ += bytes_;
+  trim_cache();
+}
+
+
+/**
+  Removes a shared image from the image cache.
+  This \b protected method undoes add(), the image itself is not deleted.
+*/
+void
+Fl_Shared_Image::remove() {
+  if (index_ < 0) return;
+
+  // Move the last image into the hole...
+  num_images_ --;
+  if (index_ < num_images_) {
+    images_[index_] = images_[num_images_];
+    images_[index_]->index_ = index_;
+  }
+  index_ = -1;
+
+  Fl_Shared_Image **p = hash_ + (name_hash(name_) & (hash_size_ - 1));
+  while (*p != this) p = &((*p)->hash_next_);
+  *p = hash_next_;
+  hash_next_ = 0;
+
+  if (lru_prev_) lru_prev_->lru_next_ = lru_next_;
+  else if (lru_first_ == this) lru_first_ = lru_next_;
+  if (lru_next_) lru_next_->lru_prev_ = lru_prev_;
+  else if (lru_last_ == this) lru_last_ = lru_prev_;
+  lru_prev_ = lru_next_ = 0;
+
+  cache_bytes_ -= bytes_;
+
+  if (num_images_ == 0 && images_) {
+    delete[] images_;
+    delete[] hash_;
+
+    images_       = 0;
+    alloc_images_ = 0;
+    hash_         = 0;
+    hash_size_    = 0;
+  }
+}
+
+
+/**
+  Deletes the least recently released images until the cache uses
+  no more memory than set with cache_size(), or no released images are left.
+*/
+void
+Fl_Shared_Image::trim_cache() {
+  while (lru_first_ && cache_bytes_ > cache_size_) {
+    Fl_Shared_Image *img = lru_first_;
+    img->remove();
+    delete img;
+    cache_evictions_ ++;
+  }
+}
+
+
+/**
+  Sets the memory that released images may use in the cache.
+
+  By default this is 0, and an image is deleted as soon as it is released
+  as often as it was requested. Otherwise released images stay in the cache,
+  so that a later get() or find() can return them without loading them again,
+  until all images in the cache, including the ones in use, take up more than
+  \p bytes. Then the least recently released images are deleted.
+
+  \param[in] bytes  the cache size in bytes, 0 to delete released images at once
+  \see cache_bytes(), cache_hits(), cache_misses(), cache_evictions()
+  \since FLTK 1.4.0
+*/
+void Fl_Shared_Image::cache_size(size_t bytes) {
+  cache_size_ = bytes;
+  trim_cache();
 }
 
 
@@ -197,6 +321,11 @@ Fl_Shared_Image::update() {
     d(image_->d());
     data(image_->data(), image_->count());
   }
+  if (index_ >= 0) {
+    cache_bytes_ -= bytes_;
+    bytes_ = image_bytes(image_);
+    cache_bytes_ += bytes_;
+  }
 }
 
 /**
@@ -207,6 +336,7 @@ Fl_Shared_Image::update() {
   Use the Fl_Shared_Image::release() method instead.
 */
 Fl_Shared_Image::~Fl_Shared_Image() {
+  if (job_) cancel_job_();
   if (name_) delete[] (char *)name_;
   if (alloc_image_) delete image_;
 }
@@ -217,83 +347,99 @@ Fl_Shared_Image::~Fl_Shared_Image() {
 
   In the latter case, it will reorganize the shared image array
   so that no hole will occur.
+
+  If a cache size is set with cache_size(), an image that is no longer
+  used stays in the cache instead and is only destroyed when the cache
+  needs the memory.
 */
 void Fl_Shared_Image::release() {
-  int	i;	// Looping var...
-
   refcount_ --;
   if (refcount_ > 0) return;
 
-  for (i = 0; i < num_images_; i ++)
-    if (images_[i] == this) {
-      num_images_ --;
-
-      if (i < num_images_) {
-        memmove(images_ + i, images_ + i + 1,
-               (num_images_ - i) * sizeof(Fl_Shared_Image *));
-      }
-
-      break;
-    }
+  if (cache_size_ && index_ >= 0 && refcount_ == 0) {
+    // Keep the image as the most recently released one...
+    lru_prev_ = lru_last_;
+    lru_next_ = 0;
+    if (lru_last_) lru_last_->lru_next_ = this;
+    else lru_first_ = this;
+    lru_last_ = this;
+    trim_cache();
+    return;
+  }
 
+  remove();
   delete this;
-
-  if (num_images_ == 0 && images_) {
-    delete[] images_;
-
-    images_       = 0;
-    alloc_images_ = 0;
-  }
 }
 
 
-/** Reloads the shared image from disk. */
-void Fl_Shared_Image::reload() {
-  // Load image from disk...
+/**
+  Loads an image file with the format detected from its first bytes.
+  This \b protected method does not use the cache and may be called from
+  any thread. Returns NULL if the file cannot be read or has no known format.
+*/
+Fl_Image *Fl_Shared_Image::load_image_(const char *name) {
   int		i;		// Looping var
   FILE		*fp;		// File pointer
   uchar		header[64];	// Buffer for auto-detecting files
   Fl_Image	*img;		// New image
 
-  if (!name_) return;
-
-  if ((fp = fl_fopen(name_, "rb")) != NULL) {
+  if ((fp = fl_fopen(name, "rb")) != NULL) {
     if (fread(header, 1, sizeof(header), fp)==0) { /* ignore */ }
     fclose(fp);
   } else {
-    return;
+    return 0;
   }
 
   // Load the image as appropriate...
   if (memcmp(header, "#define", 7) == 0) // XBM file
-    img = new Fl_XBM_Image(name_);
+    img = new Fl_XBM_Image(name);
   else if (memcmp(header, "/* XPM */", 9) == 0) // XPM file
-    img = new Fl_XPM_Image(name_);
+    img = new Fl_XPM_Image(name);
   else {
     // Not a standard format; try an image handler...
     for (i = 0, img = 0; i < num_handlers_; i ++) {
-      img = (handlers_[i])(name_, header, sizeof(header));
+      img = (handlers_[i])(name, header, sizeof(header));
 
       if (img) break;
     }
   }
 
-  if (img) {
-    if (alloc_image_) delete image_;
+  return img;
+}
 
-    alloc_image_ = 1;
 
-    if ((img->w() != w() && w()) || (img->h() != h() && h())) {
-      // Make sure the reloaded image is the same size as the existing one.
-      Fl_Image *temp = img->copy(w(), h());
-      delete img;
-      image_ = temp;
-    } else {
-      image_ = img;
-    }
+/** Reloads the shared image from disk. */
+void Fl_Shared_Image::reload() {
+  // Load image from disk...
+  Fl_Image	*img;		// New image
 
-    update();
+  if (!name_) return;
+
+  img = load_image_(name_);
+
+  if (img) set_image_(img);
+}
+
+
+/**
+  Makes the shared image use \p img, which it will delete.
+  If the shared image has a size, a copy of \p img with that size is used.
+*/
+void Fl_Shared_Image::set_image_(Fl_Image *img) {
+  if (alloc_image_) delete image_;
+
+  alloc_image_ = 1;
+
+  if ((img->w() != w() && w()) || (img->h() != h() && h())) {
+    // Make sure the reloaded image is the same size as the existing one.
+    Fl_Image *temp = img->copy(w(), h());
+    delete img;
+    image_ = temp;
+  } else {
+    image_ = img;
   }
+
+  update();
 }
 
 
@@ -385,7 +531,7 @@ void Fl_Shared_Image::uncache()
 
 /** Finds a shared image from its name and size specifications.
 
-  This uses a binary search in the image cache.
+  This uses a hash table lookup in the image cache.
 
   If the image \p name exists with the exact width \p W and height \p H,
   then it is returned.
@@ -398,29 +544,27 @@ void Fl_Shared_Image::uncache()
   when no longer needed.
 */
 Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
-  Fl_Shared_Image	*key,		// Image key
-			**match;	// Matching image
-
-  if (num_images_) {
-    key = new Fl_Shared_Image();
-    key->name_ = new char[strlen(name) + 1];
-    strcpy((char *)key->name_, name);
-    key->w(W);
-    key->h(H);
-
-    match = (Fl_Shared_Image **)bsearch(&key, images_, num_images_,
-                                        sizeof(Fl_Shared_Image *),
-                                        (compare_func_t)compare);
-
-    delete key;
+  if (!num_images_) return 0;
 
-    if (match) {
-      (*match)->refcount_ ++;
-      return *match;
-    }
+  Fl_Shared_Image *img = hash_[name_hash(name) & (hash_size_ - 1)];
+  for (; img; img = img->hash_next_) {
+    if (strcmp(img->name_, name)) continue;
+    // same rule as compare()
+    if ((W == 0 && img->original_) || (img->w() == W && img->h() == H)) break;
   }
-
-  return 0;
+  if (!img) return 0;
+
+  if (img->refcount_ <= 0) {
+    // Take the image out of the list of released images...
+    if (img->lru_prev_) img->lru_prev_->lru_next_ = img->lru_next_;
+    else lru_first_ = img->lru_next_;
+    if (img->lru_next_) img->lru_next_->lru_prev_ = img->lru_prev_;
+    else lru_last_ = img->lru_prev_;
+    img->lru_prev_ = img->lru_next_ = 0;
+    img->refcount_ = 0;
+  }
+  img->refcount_ ++;
+  return img;
 }
 
 
@@ -462,7 +606,12 @@ Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
 Fl_Shared_Image* Fl_Shared_Image::get(const char *name, int W, int H) {
   Fl_Shared_Image	*temp;		// Image
 
-  if ((temp = find(name, W, H)) != NULL) return temp;
+  if ((temp = find(name, W, H)) != NULL) {
+    cache_hits_ ++;
+    return temp;
+  }
+
+  cache_misses_ ++;
 
   if ((temp = find(name)) == NULL) {
     temp = new Fl_Shared_Image(name);
@@ -0,0 +1,369 @@
+//
+// "$Id$"
+//
+// Asynchronous loading of shared images for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "config_lib.h"
+#include <FL/Fl.H>
+#include <FL/Fl_Shared_Image.H>
+#include <FL/Fl_Widget.H>
+#include "flstring.h"
+#include <stdlib.h>
+
+#if defined(FL_CFG_SYS_WIN32)
+#  include <windows.h>
+#  define ASYNC_THREADS 1
+#elif defined(FL_CFG_SYS_POSIX) && defined(HAVE_PTHREAD)
+#  include <pthread.h>
+#  define ASYNC_THREADS 1
+#else
+#  define ASYNC_THREADS 0
+#endif
+
+/*
+ A request to load an image file in a worker thread.
+
+ Jobs wait in a FIFO queue protected by the queue lock. A worker thread
+ takes the first job, loads the file and hands the job back to the main
+ thread with Fl::awake(), where done() puts the image into the shared image
+ and redraws the widgets that asked for it.
+
+ The main thread cancels a job when the shared image is deleted: a job that
+ is still queued is removed and deleted at once, a job that is being loaded
+ loses its image and done() just deletes the result.
+
+ If Fl::awake() fails, the worker puts the job on a list of finished jobs
+ instead, which the main thread handles with the next job that reaches
+ done(), or the next call of get_async().
+ */
+class Fl_Shared_Image_Job {
+public:
+  Fl_Shared_Image *image;       // the image to load, NULL if cancelled
+  char *name;                   // file name, owned by the job
+  Fl_Image *result;             // the loaded image, set by the worker
+  Fl_Widget_Tracker **owners;   // widgets to redraw
+  int num_owners;
+  int queued;                   // still in the queue?
+  Fl_Shared_Image_Job *next;    // next job in the queue
+
+  Fl_Shared_Image_Job(Fl_Shared_Image *img);
+  ~Fl_Shared_Image_Job();
+  void add_owner(Fl_Widget *w);
+  void load() { result = Fl_Shared_Image::load_image_(name); }
+  static void done(void *job);
+};
+
+static Fl_Shared_Image_Job *queue_first, *queue_last;
+static Fl_Shared_Image_Job *finished;   // jobs Fl::awake() failed for
+static int async_threads_ = 2;          // number of threads to use
+static int running_threads = 0;         // number of threads started
+
+
+Fl_Shared_Image_Job::Fl_Shared_Image_Job(Fl_Shared_Image *img) {
+  image = img;
+  name = strdup(img->name());
+  result = 0;
+  owners = 0;
+  num_owners = 0;
+  queued = 0;
+  next = 0;
+}
+
+
+Fl_Shared_Image_Job::~Fl_Shared_Image_Job() {
+  for (int i = 0; i < num_owners; i++) delete owners[i];
+  free(owners);
+  free(name);
+}
+
+
+void Fl_Shared_Image_Job::add_owner(Fl_Widget *w) {
+  for (int i = 0; i < num_owners; i++)
+    if (owners[i]->widget() == w) return;
+  owners = (Fl_Widget_Tracker **)realloc(owners, (num_owners + 1) * sizeof(Fl_Widget_Tracker *));
+  owners[num_owners++] = new Fl_Widget_Tracker(w);
+}
+
+
+static void done_finished();
+
+
+// Called in the main thread when a worker has loaded the image
+void Fl_Shared_Image_Job::done(void *v) {
+  Fl_Shared_Image_Job *job = (Fl_Shared_Image_Job *)v;
+  Fl_Shared_Image *img = job->image;
+  if (img) {
+    img->job_ = 0;
+    if (job->result) {
+      img->set_image_(job->result);
+      job->result = 0;
+      Fl_Shared_Image::trim_cache();
+    } else {
+      // take the empty placeholder out of the cache, so that get() and
+      // find() do not return it, and delete it if it was released already
+      img->remove();
+      if (img->refcount() <= 0) delete img;
+    }
+    for (int i = 0; i < job->num_owners; i++) {
+      Fl_Widget *w = job->owners[i]->widget();
+      if (w) w->redraw();
+    }
+  }
+  delete job->result;
+  delete job;
+  done_finished();
+}
+
+
+#if ASYNC_THREADS
+
+#  if defined(FL_CFG_SYS_WIN32)
+
+static CRITICAL_SECTION queue_cs;
+static HANDLE queue_sem;                // counts the queued jobs
+
+static void lock_queue() { EnterCriticalSection(&queue_cs); }
+static void unlock_queue() { LeaveCriticalSection(&queue_cs); }
+
+static void init_queue() {
+  InitializeCriticalSection(&queue_cs);
+  queue_sem = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+}
+
+static void signal_queue() { ReleaseSemaphore(queue_sem, 1, NULL); }
+
+// Waits until a job may be queued, call with the queue unlocked
+static void wait_queue() { WaitForSingleObject(queue_sem, INFINITE); }
+
+static DWORD WINAPI worker(LPVOID);
+
+static void start_thread() {
+  HANDLE h = CreateThread(NULL, 0, worker, NULL, 0, NULL);
+  if (h) CloseHandle(h);
+}
+
+#  else // pthreads
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+static void lock_queue() { pthread_mutex_lock(&queue_mutex); }
+static void unlock_queue() { pthread_mutex_unlock(&queue_mutex); }
+static void init_queue() { }
+static void signal_queue() { pthread_cond_signal(&queue_cond); }
+
+static void wait_queue() {
+  pthread_mutex_lock(&queue_mutex);
+  while (!queue_first) pthread_cond_wait(&queue_cond, &queue_mutex);
+  pthread_mutex_unlock(&queue_mutex);
+}
+
+static void *worker(void *);
+
+static void start_thread() {
+  pthread_t t;
+  if (pthread_create(&t, NULL, worker, NULL) == 0) pthread_detach(t);
+}
+
+#  endif // FL_CFG_SYS_WIN32
+
+#  if defined(FL_CFG_SYS_WIN32)
+static DWORD WINAPI worker(LPVOID)
+#  else
+static void *worker(void *)
+#  endif
+{
+  for (;;) {
+    wait_queue();
+    lock_queue();
+    Fl_Shared_Image_Job *job = queue_first;
+    if (job) {
+      queue_first = job->next;
+      if (!queue_first) queue_last = 0;
+      job->queued = 0;
+    }
+    unlock_queue();
+    if (!job) continue; // cancelled in the meantime
+    job->load();
+    if (Fl::awake(Fl_Shared_Image_Job::done, job) < 0) {
+      // leave the job for the main thread to find later
+      lock_queue();
+      job->next = finished;
+      finished = job;
+      unlock_queue();
+    }
+  }
+#  if !defined(FL_CFG_SYS_WIN32)
+  return 0;
+#  endif
+}
+
+static void queue_job(Fl_Shared_Image_Job *job) {
+  if (!running_threads) init_queue();
+  while (running_threads < async_threads_) {
+    start_thread();
+    running_threads++;
+  }
+  lock_queue();
+  job->queued = 1;
+  if (queue_last) queue_last->next = job;
+  else queue_first = job;
+  queue_last = job;
+  unlock_queue();
+  signal_queue();
+}
+
+#endif // ASYNC_THREADS
+
+
+// Handles the jobs that Fl::awake() failed for, in the main thread
+static void done_finished() {
+#if ASYNC_THREADS
+  if (!finished) return;  // racy, but a job found later is not lost
+  lock_queue();
+  Fl_Shared_Image_Job *job = finished;
+  finished = 0;
+  unlock_queue();
+  while (job) {
+    Fl_Shared_Image_Job *next = job->next;
+    Fl_Shared_Image_Job::done(job);
+    job = next;
+  }
+#endif
+}
+
+
+/**
+  Cancels the pending asynchronous load of this image.
+  This \b protected method is called when the image is deleted.
+*/
+void Fl_Shared_Image::cancel_job_() {
+  Fl_Shared_Image_Job *job = job_;
+  job_ = 0;
+  job->image = 0;
+#if ASYNC_THREADS
+  lock_queue();
+  int queued = job->queued;
+  if (queued) {
+    // take the job out of the queue, nobody else refers to it
+    Fl_Shared_Image_Job **p = &queue_first, *prev = 0;
+    while (*p != job) { prev = *p; p = &((*p)->next); }
+    *p = job->next;
+    if (queue_last == job) queue_last = prev;
+    job->queued = 0;
+  }
+  unlock_queue();
+  if (queued) delete job;
+#endif
+}
+
+
+/**
+  Sets the number of threads that get_async() uses to load images.
+  The default is 2. Threads are started when they are first needed and are
+  never stopped, so the number can be increased later, but not decreased.
+  \since FLTK 1.4.0
+*/
+void Fl_Shared_Image::async_threads(int n) {
+  async_threads_ = n < 1 ? 1 : n;
+}
+
+
+/**
+  Returns the number of threads that get_async() uses to load images.
+  \since FLTK 1.4.0
+*/
+int Fl_Shared_Image::async_threads() {
+  return async_threads_;
+}
+
+
+/**
+  Finds or loads an image like get(), but loads image files in the background.
+
+  If the image is in the cache, it is returned as with get(). Otherwise the
+  returned shared image is an empty placeholder, with the size \p W and \p H
+  if given and 0x0 otherwise, and loading() returns true. Worker threads
+  load the file, then the main thread puts the image into the placeholder
+  during Fl::wait() and redraws \p owner. Asking for the same image again
+  before it is loaded returns the same placeholder and adds \p owner to the
+  widgets that are redrawn. If the file cannot be loaded, the placeholder
+  stays empty, loading() returns false, and the placeholder is removed from
+  the cache, so that get() and find() return NULL for it.
+
+  Releasing the image with release() before it is loaded cancels loading
+  it, unless a cache_size() is set and the image stays in the cache. This
+  is useful for images that scroll out of view.
+
+  The image data are handed to the main thread with Fl::awake(), so the
+  program must have called Fl::lock() once in the main thread. On platforms
+  without threads this works like get().
+
+  \param[in] name the image file name
+  \param[in] W, H desired size, or 0 for the size of the image file
+  \param[in] owner a widget to redraw when the image has been loaded, or NULL
+
+  \see loading(), async_threads(int)
+  \since FLTK 1.4.0
+*/
+Fl_Shared_Image *Fl_Shared_Image::get_async(const char *name, int W, int H, Fl_Widget *owner) {
+  Fl_Shared_Image *img;
+
+  done_finished();
+  if ((img = find(name, W, H)) != NULL) {
+    if (img->job_ && owner) img->job_->add_owner(owner);
+    if (!img->job_) cache_hits_ ++;
+    return img;
+  }
+
+#if ASYNC_THREADS
+  cache_misses_ ++;
+
+  // A loaded original only needs to be resized, as in get()...
+  if (W && H && (img = find(name)) != NULL) {
+    if (!img->job_) {
+      img = (Fl_Shared_Image *)img->copy(W, H);
+      img->add();
+      return img;
+    }
+    img->release();
+  }
+
+  img = new Fl_Shared_Image();
+  img->name_ = new char[strlen(name) + 1];
+  strcpy((char *)img->name_, name);
+  img->alloc_image_ = 1;
+  if (W && H) {
+    img->w(W);
+    img->h(H);
+  } else {
+    img->original_ = 1;
+  }
+  img->add();
+
+  img->job_ = new Fl_Shared_Image_Job(img);
+  if (owner) img->job_->add_owner(owner);
+  queue_job(img->job_);
+  return img;
+#else
+  return get(name, W, H);
+#endif
+}
+
+
+//
+// End of "$Id$".
+//
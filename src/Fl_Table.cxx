@@ -48,6 +48,77 @@ void Fl_Table::IntVector::size(unsigned int count) {
   }
 }
 
+// Block sums of an IntVector (private to Fl_Table)
+//
+//    The vector is split in blocks of INDEX_BLOCK values, and a Fenwick
+//    tree holds the sums of the blocks. The sum of the first x values is
+//    a tree descent plus the values before x in its block, and finding
+//    the value at a position descends the tree and searches one block.
+//    Changing the size of the vector makes the tree dirty, it is rebuilt
+//    in O(n) by the next query.
+
+#define INDEX_BLOCK 32
+
+Fl_Table::IntVectorIndex::~IntVectorIndex() { // DTOR
+  if (tree)
+    free(tree);
+  tree = 0;
+}
+
+void Fl_Table::IntVectorIndex::build(IntVector &v) {
+  int n = (int)v.size();
+  nblocks = (n + INDEX_BLOCK - 1) / INDEX_BLOCK;
+  tree = (long*)realloc(tree, (nblocks + 1) * sizeof(long));
+  tree[0] = 0;
+  for ( int b=1; b<=nblocks; b++ ) tree[b] = 0;
+  for ( int t=0; t<n; t++ ) tree[t / INDEX_BLOCK + 1] += v[t];
+  for ( int b=1; b<=nblocks; b++ ) {		// turn the sums into a Fenwick tree
+    int up = b + (b & -b);
+    if ( up <= nblocks ) tree[up] += tree[b];
+  }
+  for ( top=1; top*2 <= nblocks; top *= 2 ) { }
+  if ( !nblocks ) top = 0;
+  dirty = 0;
+}
+
+void Fl_Table::IntVectorIndex::change(int x, int delta) {
+  if ( dirty ) return;				// rebuilt on next use
+  for ( int b = x / INDEX_BLOCK + 1; b <= nblocks; b += (b & -b) ) {
+    tree[b] += delta;
+  }
+}
+
+long Fl_Table::IntVectorIndex::sum(IntVector &v, int x) {
+  if ( dirty ) build(v);
+  if ( x > (int)v.size() ) x = (int)v.size();
+  if ( x <= 0 ) return(0);
+  long s = 0;
+  for ( int b = x / INDEX_BLOCK; b > 0; b -= (b & -b) ) {
+    s += tree[b];
+  }
+  for ( int t = x / INDEX_BLOCK * INDEX_BLOCK; t < x; t++ ) {
+    s += v[t];
+  }
+  return(s);
+}
+
+int Fl_Table::IntVectorIndex::find(IntVector &v, long pos) {
+  if ( dirty ) build(v);
+  int b = 0;
+  for ( int step=top; step; step /= 2 ) {	// skip whole blocks
+    if ( b+step <= nblocks && tree[b+step] <= pos ) {
+      b += step;
+      pos -= tree[b];
+    }
+  }
+  int n = (int)v.size();
+  int t = b * INDEX_BLOCK;
+  for ( ; t < n && pos >= v[t]; t++ ) {		// search in the block
+    pos -= v[t];
+  }
+  return(t);
+}
+
 
 /** Sets the vertical scroll position so 'row' is at the top,
     and causes the screen to redraw.
@@ -63,7 +134,7 @@ void Fl_Table::row_position(int row) {
   }
   vscrollbar->Fl_Slider::value(newtop);
   table_scrolled();
-  redraw();
+  _redraw_scrolled();
   _row_position = row;	// HACK: override what table_scrolled() came up with
 }
 
@@ -82,46 +153,26 @@ void Fl_Table::col_position(int col) {
   }
   hscrollbar->Fl_Slider::value(newleft);
   table_scrolled();
-  redraw();
+  _redraw_scrolled();
   _col_position = col;	// HACK: override what table_scrolled() came up with
 }
 
 /**
   Returns the scroll position (in pixels) of the specified 'row'.
+  This is the sum of the heights of the rows above it, which the
+  table keeps indexed, so this takes O(log n) time.
 */
 long Fl_Table::row_scroll_position(int row) {
-  int startrow = 0;
-  long scroll = 0; 
-  // OPTIMIZATION: 
-  //     Attempt to use precomputed row scroll position
-  //
-  if ( toprow_scrollpos != -1 && row >= toprow ) {
-    scroll = toprow_scrollpos;
-    startrow = toprow;
-  }
-  for ( int t=startrow; t<row; t++ ) {
-    scroll += row_height(t);
-  }
-  return(scroll);
+  return(_rowindex.sum(_rowheights, row));
 }
 
 /**
   Returns the scroll position (in pixels) of the specified column 'col'.
+  This is the sum of the widths of the columns left of it, which the
+  table keeps indexed, so this takes O(log n) time.
 */
 long Fl_Table::col_scroll_position(int col) {
-  int startcol = 0;
-  long scroll = 0;
-  // OPTIMIZATION: 
-  //     Attempt to use precomputed row scroll position
-  //
-  if ( leftcol_scrollpos != -1 && col >= leftcol ) {
-    scroll = leftcol_scrollpos;
-    startcol = leftcol;
-  }
-  for ( int t=startcol; t<col; t++ ) {
-    scroll += col_width(t);
-  }
-  return(scroll);
+  return(_colindex.sum(_colwidths, col));
 }
 
 /**
@@ -166,7 +217,9 @@ Fl_Table::Fl_Table(int X, int Y, int W, int H, const char *l) : Fl_Group(X,Y,W,H
   select_row        = -1;
   select_col        = -1;
   _scrollbar_size   = 0;
-  flags_            = 0;	// TABCELLNAV off
+  flags_            = 0;	// TABCELLNAV, SCROLLCOPY off
+  _drawn_hpos       = 0;
+  _drawn_vpos       = 0;
   box(FL_THIN_DOWN_FRAME);
   
   vscrollbar = new Fl_Scrollbar(x()+w()-Fl::scrollbar_size(), y(),
@@ -216,9 +269,12 @@ void Fl_Table::row_height(int row, int height) {
   // Add row heights, even if none yet
   int now_size = (int)_rowheights.size();
   if ( row >= now_size ) {
-    _rowheights.size(row);
-    while (now_size < row)
+    _rowheights.size(row+1);
+    while (now_size <= row)
       _rowheights[now_size++] = height;
+    _rowindex.invalidate();
+  } else {
+    _rowindex.change(row, height - _rowheights[row]);
   }
   _rowheights[row] = height;
   table_resized();
@@ -246,9 +302,12 @@ void Fl_Table::col_width(int col, int width)
   int now_size = (int)_colwidths.size();
   if ( col >= now_size ) {
     _colwidths.size(col+1);
-    while (now_size < col) {
+    while (now_size <= col) {
       _colwidths[now_size++] = width;
     }
+    _colindex.invalidate();
+  } else {
+    _colindex.change(col, width - _colwidths[col]);
   }
   _colwidths[col] = width;
   table_resized();
@@ -261,6 +320,71 @@ void Fl_Table::col_width(int col, int width)
   }
 }
 
+/**
+  Sets the height of all rows to the same value, in pixels,
+  and the table is redrawn.
+  Unlike row_height(int, int), this takes O(n) time and does not
+  invoke the callback() for each row.
+*/
+void Fl_Table::row_height_all(int height) {
+  for ( int r=0; r<(int)_rowheights.size(); r++ ) {
+    _rowheights[r] = height;
+  }
+  _rowindex.invalidate();
+  table_resized();
+  redraw();
+}
+
+/**
+  Sets the width of all columns to the same value, in pixels,
+  and the table is redrawn.
+  Unlike col_width(int, int), this takes O(n) time and does not
+  invoke the callback() for each column.
+*/
+void Fl_Table::col_width_all(int width) {
+  for ( int c=0; c<(int)_colwidths.size(); c++ ) {
+    _colwidths[c] = width;
+  }
+  _colindex.invalidate();
+  table_resized();
+  redraw();
+}
+
+/**
+  Sets the heights of \p count rows starting at \p row from the array
+  \p heights, in pixels, and the table is redrawn.
+  Rows beyond rows() are ignored. This updates the table once and does
+  not invoke the callback() for each row, which makes it the fastest way
+  to set many rows of different heights.
+  \since FLTK 1.4.0
+*/
+void Fl_Table::row_heights(int row, int count, const int *heights) {
+  if ( row < 0 ) { count += row; heights -= row; row = 0; }
+  if ( count > (int)_rowheights.size() - row ) count = (int)_rowheights.size() - row;
+  if ( count <= 0 ) return;
+  memcpy(&_rowheights[row], heights, count * sizeof(int));
+  _rowindex.invalidate();
+  table_resized();
+  redraw();
+}
+
+/**
+  Sets the widths of \p count columns starting at \p col from the array
+  \p widths, in pixels, and the table is redrawn.
+  Columns beyond cols() are ignored. This updates the table once and does
+  not invoke the callback() for each column.
+  \since FLTK 1.4.0
+*/
+void Fl_Table::col_widths(int col, int count, const int *widths) {
+  if ( col < 0 ) { count += col; widths -= col; col = 0; }
+  if ( count > (int)_colwidths.size() - col ) count = (int)_colwidths.size() - col;
+  if ( count <= 0 ) return;
+  memcpy(&_colwidths[col], widths, count * sizeof(int));
+  _colindex.invalidate();
+  table_resized();
+  redraw();
+}
+
 /**
   Return specified row/col values R and C to within the table's
   current row/col limits.
@@ -325,6 +449,44 @@ void Fl_Table::get_bounds(TableContext context, int &X, int &Y, int &W, int &H)
   //NOTREACHED
 }
 
+// Find the visible row whose cells span the screen position Y.
+//    The row positions are indexed, so the row is looked up directly
+//    and only corrected for rounding of the scroll position.
+//    Returns -1 if no visible row spans Y.
+//
+int Fl_Table::_find_row(int Y) {
+  if ( toprow < 0 || botrow < toprow ) return(-1);
+  int R = _rowindex.find(_rowheights, (long)(Y - tiy + vscrollbar->value()));
+  if ( R < toprow ) R = toprow;
+  if ( R > botrow ) R = botrow;
+  int RY = row_scroll_position(R) - vscrollbar->value() + tiy;
+  while ( Y < RY && R > toprow ) {
+    RY = row_scroll_position(--R) - vscrollbar->value() + tiy;
+  }
+  while ( Y >= RY + row_height(R) && R < botrow ) {
+    RY = row_scroll_position(++R) - vscrollbar->value() + tiy;
+  }
+  return( ( Y >= RY && Y < RY + row_height(R) ) ? R : -1 );
+}
+
+// Find the visible column whose cells span the screen position X.
+//    Returns -1 if no visible column spans X.
+//
+int Fl_Table::_find_col(int X) {
+  if ( leftcol < 0 || rightcol < leftcol ) return(-1);
+  int C = _colindex.find(_colwidths, (long)(X - tix + hscrollbar->value()));
+  if ( C < leftcol ) C = leftcol;
+  if ( C > rightcol ) C = rightcol;
+  int CX = col_scroll_position(C) - hscrollbar->value() + tix;
+  while ( X < CX && C > leftcol ) {
+    CX = col_scroll_position(--C) - hscrollbar->value() + tix;
+  }
+  while ( X >= CX + col_width(C) && C < rightcol ) {
+    CX = col_scroll_position(++C) - hscrollbar->value() + tix;
+  }
+  return( ( X >= CX && X < CX + col_width(C) ) ? C : -1 );
+}
+
 /**
   Find row/col for the recent mouse event.
   Returns the context, and the row/column values in R/C.
@@ -340,22 +502,22 @@ Fl_Table::TableContext Fl_Table::cursor2rowcol(int &R, int &C, ResizeFlag &resiz
     // Inside a row heading?
     get_bounds(CONTEXT_ROW_HEADER, X, Y, W, H);
     if ( Fl::event_inside(X, Y, W, H) ) {
-      // Scan visible rows until found
-      for ( R = toprow; R <= botrow; R++ ) {
+      // Find visible row
+      R = _find_row(Fl::event_y());
+      if ( R >= 0 ) {
         find_cell(CONTEXT_ROW_HEADER, R, 0, X, Y, W, H);
-        if ( Fl::event_y() >= Y && Fl::event_y() < (Y+H) ) {
-          // Found row?
-          //     If cursor over resize boundary, and resize enabled,
-          //     enable the appropriate resize flag.
-          //
-          if ( row_resize() ) {
-            if ( Fl::event_y() <= (Y+3-0) ) { resizeflag = RESIZE_ROW_ABOVE; }
-            if ( Fl::event_y() >= (Y+H-3) ) { resizeflag = RESIZE_ROW_BELOW; }
-          }
-          return(CONTEXT_ROW_HEADER);
+        // Found row?
+        //     If cursor over resize boundary, and resize enabled,
+        //     enable the appropriate resize flag.
+        //
+        if ( row_resize() ) {
+          if ( Fl::event_y() <= (Y+3-0) ) { resizeflag = RESIZE_ROW_ABOVE; }
+          if ( Fl::event_y() >= (Y+H-3) ) { resizeflag = RESIZE_ROW_BELOW; }
         }
+        return(CONTEXT_ROW_HEADER);
       }
       // Must be in row header dead zone
+      R = 0;
       return(CONTEXT_NONE);
     }
   }
@@ -364,39 +526,35 @@ Fl_Table::TableContext Fl_Table::cursor2rowcol(int &R, int &C, ResizeFlag &resiz
     // Inside a column heading?
     get_bounds(CONTEXT_COL_HEADER, X, Y, W, H);
     if ( Fl::event_inside(X, Y, W, H) ) {
-      // Scan visible columns until found
-      for ( C = leftcol; C <= rightcol; C++ ) {
+      // Find visible column
+      C = _find_col(Fl::event_x());
+      if ( C >= 0 ) {
         find_cell(CONTEXT_COL_HEADER, 0, C, X, Y, W, H);
-        if ( Fl::event_x() >= X && Fl::event_x() < (X+W) ) {
-          // Found column?
-          //     If cursor over resize boundary, and resize enabled,
-          //     enable the appropriate resize flag.
-          //
-          if ( col_resize() ) {
-            if ( Fl::event_x() <= (X+3-0) ) { resizeflag = RESIZE_COL_LEFT; }
-            if ( Fl::event_x() >= (X+W-3) ) { resizeflag = RESIZE_COL_RIGHT; }
-          }
-          return(CONTEXT_COL_HEADER);
+        // Found column?
+        //     If cursor over resize boundary, and resize enabled,
+        //     enable the appropriate resize flag.
+        //
+        if ( col_resize() ) {
+          if ( Fl::event_x() <= (X+3-0) ) { resizeflag = RESIZE_COL_LEFT; }
+          if ( Fl::event_x() >= (X+W-3) ) { resizeflag = RESIZE_COL_RIGHT; }
         }
+        return(CONTEXT_COL_HEADER);
       }
       // Must be in column header dead zone
+      C = 0;
       return(CONTEXT_NONE);
     }
   }
   // Mouse somewhere in table?
-  //     Scan visible r/c's until we find it.
+  //     Find the visible r/c under it.
   //
   if ( Fl::event_inside(tox, toy, tow, toh) ) {
-    for ( R = toprow; R <= botrow; R++ ) {
-      find_cell(CONTEXT_CELL, R, C, X, Y, W, H);
-      if ( Fl::event_y() < Y ) break;		// OPT: thanks lars
-      if ( Fl::event_y() >= (Y+H) ) continue;	// OPT: " "
-      for ( C = leftcol; C <= rightcol; C++ ) {
-        find_cell(CONTEXT_CELL, R, C, X, Y, W, H);
-        if ( Fl::event_inside(X, Y, W, H) ) {
-          return(CONTEXT_CELL);			// found it
-        }
-      }
+    R = _find_row(Fl::event_y());
+    C = _find_col(Fl::event_x());
+    if ( R >= 0 && C >= 0 &&
+         find_cell(CONTEXT_CELL, R, C, X, Y, W, H) == 0 &&
+         Fl::event_inside(X, Y, W, H) ) {
+      return(CONTEXT_CELL);			// found it
     }
     // Must be in a dead zone of the table
     R = C = 0;
@@ -563,37 +721,33 @@ void Fl_Table::recalc_dimensions() {
 */
 void Fl_Table::table_scrolled() {
   // Find top row
-  int y, row, voff = vscrollbar->value();
-  for ( row=y=0; row < _rows; row++ ) {
-    y += row_height(row);
-    if ( y > voff ) { y -= row_height(row); break; }
-  }
+  //    First row whose bottom edge is below the scroll position
+  //
+  int voff = vscrollbar->value();
+  int row = _rowindex.find(_rowheights, voff);
+  if ( row > _rows ) row = _rows;
   _row_position = toprow = ( row >= _rows ) ? (row - 1) : row;
-  toprow_scrollpos = y;		// OPTIMIZATION: save for later use 
+  toprow_scrollpos = row_scroll_position(toprow);	// OPTIMIZATION: save for later use 
   // Find bottom row
-  voff = vscrollbar->value() + tih;
-  for ( ; row < _rows; row++ ) {
-    y += row_height(row);
-    if ( y >= voff ) { break; }
+  //    First row from toprow whose bottom edge reaches the window bottom
+  //
+  if ( row < _rows ) {
+    int bot = _rowindex.find(_rowheights, voff + tih - 1L);
+    row = ( bot < row ) ? row : bot;
   }
-  botrow = ( row >= _rows ) ? (row - 1) : row; 
+  botrow = ( row >= _rows ) ? (_rows - 1) : row; 
   // Left column
-  int x, col, hoff = hscrollbar->value();
-  for ( col=x=0; col < _cols; col++ ) {
-    x += col_width(col);
-    if ( x > hoff ) { x -= col_width(col); break; }
-  }
+  int hoff = hscrollbar->value();
+  int col = _colindex.find(_colwidths, hoff);
+  if ( col > _cols ) col = _cols;
   _col_position = leftcol = ( col >= _cols ) ? (col - 1) : col;
-  leftcol_scrollpos = x;	// OPTIMIZATION: save for later use 
+  leftcol_scrollpos = col_scroll_position(leftcol);	// OPTIMIZATION: save for later use 
   // Right column
-  //    Work with data left over from leftcol calculation
-  //
-  hoff = hscrollbar->value() + tiw;
-  for ( ; col < _cols; col++ ) {
-    x += col_width(col);
-    if ( x >= hoff ) { break; }
+  if ( col < _cols ) {
+    int right = _colindex.find(_colwidths, hoff + tiw - 1L);
+    col = ( right < col ) ? col : right;
   }
-  rightcol = ( col >= _cols ) ? (col - 1) : col; 
+  rightcol = ( col >= _cols ) ? (_cols - 1) : col; 
   // First tell children to scroll
   draw_cell(CONTEXT_RC_RESIZE, 0,0,0,0,0,0);
 }
@@ -649,7 +803,22 @@ void Fl_Table::scroll_cb(Fl_Widget*w, void *data) {
   Fl_Table *o = (Fl_Table*)data;
   o->recalc_dimensions();	// recalc tix, tiy, etc.
   o->table_scrolled();
-  o->redraw();
+  o->_redraw_scrolled();
+}
+
+// Schedule the redraw after a scroll.
+//    With scroll_copy() on, and if the table only scrolled in one
+//    direction since it was last drawn, only damage it with
+//    FL_DAMAGE_SCROLL; draw() then moves the pixels of the cells.
+//
+void Fl_Table::_redraw_scrolled() {
+  if ( ( flags_ & SCROLLCOPY ) && ! table->visible() &&
+       ( (int)hscrollbar->value() == _drawn_hpos ||
+         (int)vscrollbar->value() == _drawn_vpos ) ) {
+    damage(FL_DAMAGE_SCROLL);
+  } else {
+    redraw();
+  }
 }
 
 /**
@@ -665,6 +834,7 @@ void Fl_Table::rows(int val) {
     while ( now_size < val ) {
       _rowheights[now_size++] = default_h;	// fill new
     }
+    _rowindex.invalidate();
   }
   table_resized();
   
@@ -688,6 +858,7 @@ void Fl_Table::cols(int val) {
     while ( now_size < val ) {
       _colwidths[now_size++] = default_w;	// fill new
     }
+    _colindex.invalidate();
   }
   table_resized();
   redraw();
@@ -1290,8 +1461,26 @@ void Fl_Table::draw() {
   // Clip all further drawing to the inner widget dimensions
   fl_push_clip(wix, wiy, wiw, wih);
   {
+    int full = damage() & FL_DAMAGE_ALL;
+    // Only scrolled? Move the cells that stay visible, see scroll_copy()
+    if ( ! full && ( damage() & FL_DAMAGE_SCROLL ) ) {
+      int dx = _drawn_hpos - (int)hscrollbar->value();
+      int dy = _drawn_vpos - (int)vscrollbar->value();
+      float scale = Fl_Surface_Device::surface()->driver()->scale();
+      if ( ( dx && dy ) || scale != int(scale) ) {
+        full = 1;				// can't copy, redraw all cells
+      } else if ( dy ) {
+        // Row headers and cells move vertically
+        int X = row_header() ? wix : tix;
+        fl_scroll(X, tiy, tix + tiw - X, tih, 0, dy, _draw_area_cb, this);
+      } else if ( dx ) {
+        // Column headers and cells move horizontally
+        int Y = col_header() ? wiy : tiy;
+        fl_scroll(tix, Y, tiw, tiy + tih - Y, dx, 0, _draw_area_cb, this);
+      }
+    }
     // Only redraw a few cells?
-    if ( ! ( damage() & FL_DAMAGE_ALL ) && _redraw_leftcol != -1 ) {
+    if ( ! full && _redraw_leftcol != -1 ) {
       fl_push_clip(tix, tiy, tiw, tih);
       for ( int c = _redraw_leftcol; c <= _redraw_rightcol; c++ ) {
         for ( int r = _redraw_toprow; r <= _redraw_botrow; r++ ) { 
@@ -1300,84 +1489,8 @@ void Fl_Table::draw() {
       }
       fl_pop_clip();
     }
-    if ( damage() & FL_DAMAGE_ALL ) {
-      int X,Y,W,H;
-      // Draw row headers, if any
-      if ( row_header() ) {
-        get_bounds(CONTEXT_ROW_HEADER, X, Y, W, H);
-        fl_push_clip(X,Y,W,H);
-        for ( int r = toprow; r <= botrow; r++ ) {
-          _redraw_cell(CONTEXT_ROW_HEADER, r, 0);
-        }
-        fl_pop_clip();
-      }
-      // Draw column headers, if any
-      if ( col_header() ) {
-        get_bounds(CONTEXT_COL_HEADER, X, Y, W, H);
-        fl_push_clip(X,Y,W,H);
-        for ( int c = leftcol; c <= rightcol; c++ ) {
-          _redraw_cell(CONTEXT_COL_HEADER, 0, c);
-        }
-        fl_pop_clip();
-      } 
-      // Draw all cells.
-      //    This includes cells partially obscured off edges of table.
-      //    No longer do this last; you might think it would be nice
-      //    to draw over dead zones, but on redraws it flickers. Avoid
-      //    drawing over deadzones; prevent deadzones by sizing columns.
-      //
-      fl_push_clip(tix, tiy, tiw, tih); {
-        for ( int r = toprow; r <= botrow; r++ ) {
-          for ( int c = leftcol; c <= rightcol; c++ ) {
-            _redraw_cell(CONTEXT_CELL, r, c); 
-          }
-        }
-      }
-      fl_pop_clip(); 
-      // Draw little rectangle in corner of headers
-      if ( row_header() && col_header() ) {
-        fl_rectf(wix, wiy, row_header_width(), col_header_height(), color());
-      }
-      
-      // Table has a boxtype? Close those few dead pixels
-      if ( table->box() ) {
-        if ( col_header() ) {
-          fl_rectf(tox, wiy, Fl::box_dx(table->box()), col_header_height(), color());
-        }
-        if ( row_header() ) {
-          fl_rectf(wix, toy, row_header_width(), Fl::box_dx(table->box()), color());
-        }
-      }
-      
-      // Table width smaller than window? Fill remainder with rectangle
-      if ( table_w < tiw ) {
-        fl_rectf(tix + table_w, tiy, tiw - table_w, tih, color()); 
-        // Col header? fill that too
-        if ( col_header() ) {
-          fl_rectf(tix + table_w, 
-                   wiy, 
-                   // get that corner just right..
-                   (tiw - table_w + Fl::box_dw(table->box()) - 
-                    Fl::box_dx(table->box())),
-                   col_header_height(),
-                   color());
-        }
-      } 
-      // Table height smaller than window? Fill remainder with rectangle
-      if ( table_h < tih ) {
-        fl_rectf(tix, tiy + table_h, tiw, tih - table_h, color()); 
-        if ( row_header() ) {
-          // NOTE:
-          //     Careful with that lower corner; don't use tih; when eg.
-          //     table->box(FL_THIN_UP_FRAME) and hscrollbar hidden,
-          //     leaves a row of dead pixels.
-          //
-          fl_rectf(wix, tiy + table_h, row_header_width(), 
-                   (wiy+wih) - (tiy+table_h) - 
-                   ( hscrollbar->visible() ? scrollsize : 0),
-                   color());
-        }
-      }
+    if ( full ) {
+      _draw_cells(toprow, botrow, leftcol, rightcol);
     } 
     // Both scrollbars? Draw little box in lower right
     if ( vscrollbar->visible() && hscrollbar->visible() ) {
@@ -1388,10 +1501,123 @@ void Fl_Table::draw() {
               tix, tiy, tiw, tih);		// routines cleanup
     
     _redraw_leftcol = _redraw_rightcol = _redraw_toprow = _redraw_botrow = -1;
+    _drawn_hpos = (int)hscrollbar->value();
+    _drawn_vpos = (int)vscrollbar->value();
   }
   fl_pop_clip();
 }
 
+/**
+  Draws the row headers of rows R1 to R2, the column headers of columns
+  C1 to C2, the cells where they cross, and the areas around the table,
+  within the current clip region.
+*/
+void Fl_Table::_draw_cells(int R1, int R2, int C1, int C2) {
+  int scrollsize = _scrollbar_size ? _scrollbar_size : Fl::scrollbar_size();
+  int X,Y,W,H;
+  // Draw row headers, if any
+  if ( row_header() ) {
+    get_bounds(CONTEXT_ROW_HEADER, X, Y, W, H);
+    fl_push_clip(X,Y,W,H);
+    for ( int r = R1; r <= R2; r++ ) {
+      _redraw_cell(CONTEXT_ROW_HEADER, r, 0);
+    }
+    fl_pop_clip();
+  }
+  // Draw column headers, if any
+  if ( col_header() ) {
+    get_bounds(CONTEXT_COL_HEADER, X, Y, W, H);
+    fl_push_clip(X,Y,W,H);
+    for ( int c = C1; c <= C2; c++ ) {
+      _redraw_cell(CONTEXT_COL_HEADER, 0, c);
+    }
+    fl_pop_clip();
+  } 
+  // Draw all cells.
+  //    This includes cells partially obscured off edges of table.
+  //    No longer do this last; you might think it would be nice
+  //    to draw over dead zones, but on redraws it flickers. Avoid
+  //    drawing over deadzones; prevent deadzones by sizing columns.
+  //
+  fl_push_clip(tix, tiy, tiw, tih); {
+    for ( int r = R1; r <= R2; r++ ) {
+      for ( int c = C1; c <= C2; c++ ) {
+        _redraw_cell(CONTEXT_CELL, r, c); 
+      }
+    }
+  }
+  fl_pop_clip(); 
+  // Draw little rectangle in corner of headers
+  if ( row_header() && col_header() ) {
+    fl_rectf(wix, wiy, row_header_width(), col_header_height(), color());
+  }
+  
+  // Table has a boxtype? Close those few dead pixels
+  if ( table->box() ) {
+    if ( col_header() ) {
+      fl_rectf(tox, wiy, Fl::box_dx(table->box()), col_header_height(), color());
+    }
+    if ( row_header() ) {
+      fl_rectf(wix, toy, row_header_width(), Fl::box_dx(table->box()), color());
+    }
+  }
+  
+  // Table width smaller than window? Fill remainder with rectangle
+  if ( table_w < tiw ) {
+    fl_rectf(tix + table_w, tiy, tiw - table_w, tih, color()); 
+    // Col header? fill that too
+    if ( col_header() ) {
+      fl_rectf(tix + table_w, 
+               wiy, 
+               // get that corner just right..
+               (tiw - table_w + Fl::box_dw(table->box()) - 
+                Fl::box_dx(table->box())),
+               col_header_height(),
+               color());
+    }
+  } 
+  // Table height smaller than window? Fill remainder with rectangle
+  if ( table_h < tih ) {
+    fl_rectf(tix, tiy + table_h, tiw, tih - table_h, color()); 
+    if ( row_header() ) {
+      // NOTE:
+      //     Careful with that lower corner; don't use tih; when eg.
+      //     table->box(FL_THIN_UP_FRAME) and hscrollbar hidden,
+      //     leaves a row of dead pixels.
+      //
+      fl_rectf(wix, tiy + table_h, row_header_width(), 
+               (wiy+wih) - (tiy+table_h) - 
+               ( hscrollbar->visible() ? scrollsize : 0),
+               color());
+    }
+  }
+}
+
+/**
+  Draws the headers and cells in the area X/Y/W/H, which has just
+  scrolled into view.
+*/
+void Fl_Table::_draw_area(int X, int Y, int W, int H) {
+  long voff = (long)vscrollbar->value() - tiy;
+  long hoff = (long)hscrollbar->value() - tix;
+  // Find the rows and columns in the area, one pixel more for rounding
+  int R1 = _rowindex.find(_rowheights, Y + voff - 1);
+  int R2 = _rowindex.find(_rowheights, Y + H + voff);
+  int C1 = _colindex.find(_colwidths, X + hoff - 1);
+  int C2 = _colindex.find(_colwidths, X + W + hoff);
+  if ( R1 < toprow ) R1 = toprow;
+  if ( R2 > botrow ) R2 = botrow;
+  if ( C1 < leftcol ) C1 = leftcol;
+  if ( C2 > rightcol ) C2 = rightcol;
+  fl_push_clip(X, Y, W, H);
+  _draw_cells(R1, R2, C1, C2);
+  fl_pop_clip();
+}
+
+void Fl_Table::_draw_area_cb(void *d, int X, int Y, int W, int H) {
+  ((Fl_Table*)d)->_draw_area(X, Y, W, H);
+}
+
 //
 // End of "$Id$".
 //
@@ -24,6 +24,10 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Text_Buffer.H>
 #include <FL/fl_ask.H>
+#include "Fl_Text_Piece_Table.H"
+#include "Fl_Text_Undo.H"
+#include "Fl_Text_Line_Index.H"
+#include "Fl_System_Driver.H"
 
 
 /*
@@ -68,32 +72,6 @@ static int min(int i1, int i2)
 #endif
 
 
-static char *undobuffer;
-static int undobufferlength;
-static Fl_Text_Buffer *undowidget;
-static int undoat;		// points after insertion
-static int undocut;		// number of characters deleted there
-static int undoinsert;		// number of characters inserted
-static int undoyankcut;		// length of valid contents of buffer, even if undocut=0
-
-/*
- Resize the undo buffer to match at least the requested size.
- */
-static void undobuffersize(int n)
-{
-  if (n > undobufferlength) {
-    if (undobuffer) {
-      do {
-	undobufferlength *= 2;
-      } while (undobufferlength < n);
-      undobuffer = (char *) realloc(undobuffer, undobufferlength);
-    } else {
-      undobufferlength = n + 9;
-      undobuffer = (char *) malloc(undobufferlength);
-    }
-  }
-}
-
 static void def_transcoding_warning_action(Fl_Text_Buffer *text)
 {
   fl_alert("%s", text->file_encoding_warning_message);
@@ -109,6 +87,10 @@ Fl_Text_Buffer::Fl_Text_Buffer(int requestedSize, int preferredGapSize)
   mBuf = (char *) malloc(requestedSize + mPreferredGapSize);
   mGapStart = 0;
   mGapEnd = requestedSize + mPreferredGapSize;
+  mPieces = NULL;
+  mLineIndex = new Fl_Text_Line_Index();
+  mUndo = new Fl_Text_Undo();
+  mCheckPos = -1;
   mTabDist = 8;
   mPrimary.mSelected = 0;
   mPrimary.mStart = mPrimary.mEnd = 0;
@@ -135,6 +117,11 @@ Fl_Text_Buffer::Fl_Text_Buffer(int requestedSize, int preferredGapSize)
 Fl_Text_Buffer::~Fl_Text_Buffer()
 {
   free(mBuf);
+  delete mPieces;
+  delete mLineIndex;
+  delete mUndo;
+  if (mCheckPos >= 0)
+    Fl::remove_idle(check_utf8_cb_, this);
   if (mNModifyProcs != 0) {
     delete[]mModifyProcs;
     delete[]mCbArgs;
@@ -152,13 +139,38 @@ Fl_Text_Buffer::~Fl_Text_Buffer()
  */
 char *Fl_Text_Buffer::text() const {
   char *t = (char *) malloc(mLength + 1);
-  memcpy(t, mBuf, mGapStart);
-  memcpy(t+mGapStart, mBuf+mGapEnd, mLength - mGapStart);
+  copy_range_(t, 0, mLength);
   t[mLength] = '\0';
   return t;
 } 
 
 
+/*
+ Switch between the gap buffer and the piece table storage.
+ The text is copied once, positions do not change.
+ */
+void Fl_Text_Buffer::storage(int mode)
+{
+  if (mode == storage())
+    return;
+  if (mode == PIECE_TABLE) {
+    mPieces = new Fl_Text_Piece_Table();
+    move_gap(mLength);
+    mPieces->insert(0, mBuf, mLength);
+    free((void *) mBuf);
+    mBuf = NULL;
+    mGapStart = mGapEnd = 0;
+  } else {
+    mBuf = (char *) malloc(mLength + mPreferredGapSize);
+    mPieces->copy_out(mBuf, 0, mLength);
+    mGapStart = mLength;
+    mGapEnd = mLength + mPreferredGapSize;
+    delete mPieces;
+    mPieces = NULL;
+  }
+}
+
+
 /*
  Set the text buffer to a new string.
  */
@@ -175,15 +187,28 @@ void Fl_Text_Buffer::text(const char *t)
   /* Save information for redisplay, and get rid of the old buffer */
   const char *deletedText = text();
   int deletedLength = mLength;
-  free((void *) mBuf);
-  
-  /* Start a new buffer with a gap of mPreferredGapSize at the end */
   int insertedLength = (int) strlen(t);
-  mBuf = (char *) malloc(insertedLength + mPreferredGapSize);
   mLength = insertedLength;
-  mGapStart = insertedLength;
-  mGapEnd = mGapStart + mPreferredGapSize;
-  memcpy(mBuf, t, insertedLength);
+  if (mCheckPos >= 0) {
+    Fl::remove_idle(check_utf8_cb_, this);
+    mCheckPos = -1;
+  }
+  
+  if (mPieces) {
+    /* Start over with all text in a single piece */
+    mPieces->clear();
+    mPieces->insert(0, t, insertedLength);
+  } else {
+    /* Start a new buffer with a gap of mPreferredGapSize at the end */
+    free((void *) mBuf);
+    mBuf = (char *) malloc(insertedLength + mPreferredGapSize);
+    mGapStart = insertedLength;
+    mGapEnd = mGapStart + mPreferredGapSize;
+    memcpy(mBuf, t, insertedLength);
+  }
+  mLineIndex->clear();
+  mLineIndex->insert(0, t, insertedLength);
+  mUndo->clear();
   
   /* Zero all of the existing selections */
   update_selections(0, deletedLength, 0);
@@ -222,17 +247,50 @@ char *Fl_Text_Buffer::text_range(int start, int end) const {
   s = (char *) malloc(copiedLength + 1);
   
   /* Copy the text from the buffer to the returned string */
-  if (end <= mGapStart) {
-    memcpy(s, mBuf + start, copiedLength);
+  copy_range_(s, start, end);
+  s[copiedLength] = '\0';
+  return s;
+}
+
+
+/*
+ Copy a range of text from around the gap or from the pieces.
+ */
+void Fl_Text_Buffer::copy_range_(char *dst, int start, int end) const
+{
+  if (mPieces) {
+    mPieces->copy_out(dst, start, end);
+  } else if (end <= mGapStart) {
+    memcpy(dst, mBuf + start, end - start);
   } else if (start >= mGapStart) {
-    memcpy(s, mBuf + start + (mGapEnd - mGapStart), copiedLength);
+    memcpy(dst, mBuf + start + (mGapEnd - mGapStart), end - start);
   } else {
     int part1Length = mGapStart - start;
-    memcpy(s, mBuf + start, part1Length);
-    memcpy(s + part1Length, mBuf + mGapEnd, copiedLength - part1Length);
+    memcpy(dst, mBuf + start, part1Length);
+    memcpy(dst + part1Length, mBuf + mGapEnd, end - start - part1Length);
   }
-  s[copiedLength] = '\0';
-  return s;
+}
+
+
+/*
+ Return the contiguous run of bytes that starts at pos.
+ */
+int Fl_Text_Buffer::span_(int pos, const char **p) const
+{
+  if (mPieces)
+    return mPieces->span(pos, p);
+  if (pos < mGapStart) {
+    *p = mBuf + pos;
+    return mGapStart - pos;
+  }
+  *p = mBuf + pos + (mGapEnd - mGapStart);
+  return mLength - pos;
+}
+
+
+const char *Fl_Text_Buffer::piece_address_(int pos) const
+{
+  return mPieces->address(pos);
 }
 
 /*
@@ -414,6 +472,22 @@ void Fl_Text_Buffer::copy(Fl_Text_Buffer * fromBuf, int fromStart,
   
   int copiedLength = fromEnd - fromStart;
   
+  if (mPieces) {
+    /* The source may be this very buffer, so take a copy first */
+    char *t = fromBuf->text_range(fromStart, fromEnd);
+    mPieces->insert(toPos, t, copiedLength);
+    if (mCheckPos < 0 || toPos < mCheckPos)
+      mLineIndex->insert(toPos, t, copiedLength);
+    free(t);
+    mLength += copiedLength;
+    if (mCanUndo)
+      mUndo->inserted(toPos, copiedLength);
+    if (toPos < mCheckPos)
+      mCheckPos += copiedLength;
+    update_selections(toPos, 0, copiedLength);
+    return;
+  }
+  
   /* Prepare the buffer to receive the new text.  If the new text fits in
    the current buffer, just move the gap (if necessary) to where
    the text should be inserted.  If the new text is too large, reallocate
@@ -425,20 +499,15 @@ void Fl_Text_Buffer::copy(Fl_Text_Buffer * fromBuf, int fromStart,
     move_gap(toPos);
   
   /* Insert the new text (toPos now corresponds to the start of the gap) */
-  if (fromEnd <= fromBuf->mGapStart) {
-    memcpy(&mBuf[toPos], &fromBuf->mBuf[fromStart], copiedLength);
-  } else if (fromStart >= fromBuf->mGapStart) {
-    memcpy(&mBuf[toPos],
-	   &fromBuf->mBuf[fromStart + (fromBuf->mGapEnd - fromBuf->mGapStart)],
-	   copiedLength);
-  } else {
-    int part1Length = fromBuf->mGapStart - fromStart;
-    memcpy(&mBuf[toPos], &fromBuf->mBuf[fromStart], part1Length);
-    memcpy(&mBuf[toPos + part1Length],
-	   &fromBuf->mBuf[fromBuf->mGapEnd], copiedLength - part1Length);
-  }
+  fromBuf->copy_range_(&mBuf[toPos], fromStart, fromEnd);
+  if (mCheckPos < 0 || toPos < mCheckPos)
+    mLineIndex->insert(toPos, &mBuf[toPos], copiedLength);
   mGapStart += copiedLength;
   mLength += copiedLength;
+  if (mCanUndo)
+    mUndo->inserted(toPos, copiedLength);
+  if (toPos < mCheckPos)
+    mCheckPos += copiedLength;
   update_selections(toPos, 0, copiedLength);
 }
 
@@ -450,38 +519,84 @@ void Fl_Text_Buffer::copy(Fl_Text_Buffer * fromBuf, int fromStart,
  */ 
 int Fl_Text_Buffer::undo(int *cursorPos)
 {
-  if (undowidget != this || (!undocut && !undoinsert && !mCanUndo))
+  return apply_undo_(0, cursorPos);
+}
+
+
+/*
+ Redo the last undone change.
+ */
+int Fl_Text_Buffer::redo(int *cursorPos)
+{
+  return apply_undo_(1, cursorPos);
+}
+
+
+int Fl_Text_Buffer::can_undo() const
+{
+  return mUndo->can_undo();
+}
+
+
+int Fl_Text_Buffer::can_redo() const
+{
+  return mUndo->can_redo();
+}
+
+
+void Fl_Text_Buffer::undo_limit(int bytes)
+{
+  mUndo->limit(bytes);
+}
+
+
+int Fl_Text_Buffer::undo_limit() const
+{
+  return mUndo->limit();
+}
+
+
+void Fl_Text_Buffer::seal_undo()
+{
+  mUndo->seal();
+}
+
+
+/*
+ Revert the most recent action on the undo (or redo) stack and put its
+ inverse on the other stack.
+ */
+int Fl_Text_Buffer::apply_undo_(int redo, int *cursorPos)
+{
+  Fl_Text_Undo::Action *a = redo ? mUndo->pop_redo() : mUndo->pop_undo();
+  if (!a)
     return 0;
   
-  int ilen = undocut;
-  int xlen = undoinsert;
-  int b = undoat - xlen;
-  
-  if (xlen && undoyankcut && !ilen) {
-    ilen = undoyankcut;
-  }
-  
-  if (xlen && ilen) {
-    undobuffersize(ilen + 1);
-    undobuffer[ilen] = 0;
-    char *tmp = strdup(undobuffer);
-    replace(b, undoat, tmp);
-    if (cursorPos)
-      *cursorPos = mCursorPosHint;
-    free(tmp);
-  } else if (xlen) {
-    remove(b, undoat);
-    if (cursorPos)
-      *cursorPos = mCursorPosHint;
-  } else if (ilen) {
-    undobuffersize(ilen + 1);
-    undobuffer[ilen] = 0;
-    insert(undoat, undobuffer);
-    if (cursorPos)
-      *cursorPos = mCursorPosHint;
-    undoyankcut = 0;
-  }
-  
+  /* The text that was inserted becomes the deleted text of the inverse.
+     Both texts are passed with their lengths, as a mapped file may contain
+     nul bytes until check_utf8_() gets to them. */
+  call_predelete_callbacks(a->pos, a->ilen);
+  char *inserted = text_range(a->pos, a->pos + a->ilen);
+  char canUndo = mCanUndo;
+  mCanUndo = 0;
+  remove_(a->pos, a->pos + a->ilen);
+  insert_(a->pos, a->text(), a->dlen);
+  mCanUndo = canUndo;
+  mCursorPosHint = a->pos + a->dlen;
+  call_modify_callbacks(a->pos, a->ilen, a->dlen, 0, inserted);
+  a = mUndo->reserve(a, a->ilen + 1);
+  memcpy(a->text(), inserted, a->ilen);
+  free(inserted);
+  int n = a->ilen;
+  a->ilen = a->dlen;
+  a->dlen = n;
+  
+  if (redo)
+    mUndo->push_undo(a);
+  else
+    mUndo->push_redo(a);
+  if (cursorPos)
+    *cursorPos = mCursorPosHint;
   return 1;
 }
 
@@ -492,9 +607,9 @@ int Fl_Text_Buffer::undo(int *cursorPos)
 void Fl_Text_Buffer::canUndo(char flag)
 {
   mCanUndo = flag;
-  // disabling undo also clears the last undo operation!
-  if (!mCanUndo && undowidget==this) 
-    undowidget = 0;
+  // disabling undo also clears the undo history!
+  if (!mCanUndo)
+    mUndo->clear();
 }
 
 
@@ -952,66 +1067,53 @@ int Fl_Text_Buffer::skip_displayed_characters(int lineStartPos, int nChars)
 /*
  Count the number of newline characters between start and end.
  startPos and endPos must be at a character boundary.
- This function is optimized for speed by not using UTF-8 calls.
+ The line index makes this O(log n), independent of the distance. Text
+ after mapfile() that is not indexed yet is scanned.
  */
 int Fl_Text_Buffer::count_lines(int startPos, int endPos) const {
   IS_UTF8_ALIGNED2(this, (startPos))
   IS_UTF8_ALIGNED2(this, (endPos))
   
-  int gapLen = mGapEnd - mGapStart;
-  int lineCount = 0;
-  
-  int pos = startPos;
-  while (pos < mGapStart)
-  {
-    if (pos == endPos)
-      return lineCount;
-    if (mBuf[pos++] == '\n')
-      lineCount++;
-  } 
-  while (pos < mLength) {
-    if (pos == endPos)
-      return lineCount;
-    if (mBuf[pos++ + gapLen] == '\n')
-      lineCount++;
-  }
-  return lineCount;
+  if (endPos > mLength || endPos < startPos)
+    endPos = mLength;
+  if (startPos >= endPos)
+    return 0;
+  if (mCheckPos < 0 || endPos <= mCheckPos)
+    return mLineIndex->line_of(endPos) - mLineIndex->line_of(startPos);
+  if (startPos >= mCheckPos)
+    return scan_lines_(startPos, endPos, endPos - startPos, NULL);
+  return mLineIndex->line_of(mCheckPos) - mLineIndex->line_of(startPos)
+         + scan_lines_(mCheckPos, endPos, endPos - mCheckPos, NULL);
 }
 
 
 /*
  Skip to the first character, n lines ahead.
  StartPos must be at a character boundary.
- This function is optimized for speed by not using UTF-8 calls.
+ The line index makes this O(log n), independent of the distance. Text
+ after mapfile() that is not indexed yet is scanned.
  */
 int Fl_Text_Buffer::skip_lines(int startPos, int nLines)
 {
   IS_UTF8_ALIGNED2(this, (startPos))
   
-  if (nLines == 0)
+  if (nLines == 0 || startPos >= mLength)
     return startPos;
+  if (nLines < 0)
+    nLines = 1;
   
-  int gapLen = mGapEnd - mGapStart;
-  int pos = startPos;
-  int lineCount = 0;
-  while (pos < mGapStart) {
-    if (mBuf[pos++] == '\n') {
-      lineCount++;
-      if (lineCount == nLines) {
-        IS_UTF8_ALIGNED2(this, (pos))
-	return pos;
-      }
-    }
-  }
-  while (pos < mLength) {
-    if (mBuf[pos++ + gapLen] == '\n') {
-      lineCount++;
-      if (lineCount >= nLines) {
-        IS_UTF8_ALIGNED2(this, (pos))
-	return pos;
-      }
-    }
+  int pos;
+  if (mCheckPos >= 0 && startPos >= mCheckPos) {
+    scan_lines_(startPos, mLength, nLines, &pos);
+    return pos;
   }
+  int line = mLineIndex->line_of(startPos) + nLines;
+  if (line < mLineIndex->lines())
+    pos = mLineIndex->line_start(line);
+  else if (mCheckPos < 0)
+    pos = mLength;
+  else
+    scan_lines_(mCheckPos, mLength, line - mLineIndex->lines() + 1, &pos);
   IS_UTF8_ALIGNED2(this, (pos))
   return pos;
 }
@@ -1020,37 +1122,85 @@ int Fl_Text_Buffer::skip_lines(int startPos, int nLines)
 /*
  Skip to the first character, n lines back.
  StartPos must be at a character boundary.
- This function is optimized for speed by not using UTF-8 calls.
+ The line index makes this O(log n), independent of the distance. Text
+ after mapfile() that is not indexed yet is scanned.
  */
 int Fl_Text_Buffer::rewind_lines(int startPos, int nLines)
 {
   IS_UTF8_ALIGNED2(this, (startPos))
   
-  int pos = startPos - 1;
-  if (pos <= 0)
+  if (startPos - 1 <= 0)
     return 0;
+  if (nLines < 0)
+    nLines = 0;
   
-  int gapLen = mGapEnd - mGapStart;
-  int lineCount = -1;
-  while (pos >= mGapStart) {
-    if (mBuf[pos + gapLen] == '\n') {
-      if (++lineCount >= nLines) {
-        IS_UTF8_ALIGNED2(this, (pos+1))
-	return pos + 1;
-      }
+  int line;
+  if (mCheckPos >= 0 && startPos > mCheckPos) {
+    int pos, found = rscan_lines_(startPos, mCheckPos, nLines + 1, &pos);
+    if (found > nLines)
+      return pos;
+    line = mLineIndex->lines() - 1 + found - nLines;
+  } else {
+    line = mLineIndex->line_of(startPos) - nLines;
+  }
+  if (line <= 0)
+    return 0;
+  int pos = mLineIndex->line_start(line);
+  IS_UTF8_ALIGNED2(this, (pos))
+  return pos;
+}
+
+
+/*
+ Count the newlines from start towards end, up to nLines of them. If pos
+ is not NULL, it is set to the position after the last newline counted,
+ or to end if there are fewer.
+ */
+int Fl_Text_Buffer::scan_lines_(int start, int end, int nLines,
+                                int *pos) const
+{
+  int n = 0;
+  while (start < end && n < nLines) {
+    const char *p;
+    int len = span_(start, &p);
+    if (len > end - start)
+      len = end - start;
+    const char *s = p, *e = p + len, *nl;
+    while (n < nLines && (nl = (const char *) memchr(s, '\n', e - s))) {
+      s = nl + 1;
+      n++;
     }
-    pos--;
+    start += (n < nLines) ? len : (int) (s - p);
   }
-  while (pos >= 0) {
-    if (mBuf[pos] == '\n') {
-      if (++lineCount >= nLines) {
-        IS_UTF8_ALIGNED2(this, (pos+1))
-	return pos + 1;
+  if (pos)
+    *pos = start;
+  return n;
+}
+
+
+/*
+ Count the newlines from start back towards stop, up to nLines of them.
+ Pos is set to the position after the last newline counted, or to stop
+ if there are fewer.
+ */
+int Fl_Text_Buffer::rscan_lines_(int start, int stop, int nLines,
+                                 int *pos) const
+{
+  char buf[4096];
+  int n = 0;
+  while (start > stop) {
+    int len = min(start - stop, (int) sizeof(buf));
+    copy_range_(buf, start - len, start);
+    for (int i = len - 1; i >= 0; i--) {
+      if (buf[i] == '\n' && ++n == nLines) {
+        *pos = start - len + i + 1;
+        return n;
       }
     }
-    pos--;
+    start -= len;
   }
-  return 0;
+  *pos = stop;
+  return n;
 }
 
 
@@ -1167,40 +1317,41 @@ int Fl_Text_Buffer::search_backward(int startPos, const char *searchString,
  Insert a string into the buffer.
  Pos must be at a character boundary. Text must be a correct UTF-8 string.
  */
-int Fl_Text_Buffer::insert_(int pos, const char *text)
+int Fl_Text_Buffer::insert_(int pos, const char *text, int insertedLength)
 {
-  if (!text || !*text)
+  if (!text)
+    return 0;
+  if (insertedLength < 0)
+    insertedLength = (int) strlen(text);
+  if (!insertedLength)
     return 0;
   
-  int insertedLength = (int) strlen(text);
-  
-  /* Prepare the buffer to receive the new text.  If the new text fits in
-   the current buffer, just move the gap (if necessary) to where
-   the text should be inserted.  If the new text is too large, reallocate
-   the buffer with a gap large enough to accomodate the new text and a
-   gap of mPreferredGapSize */
-  if (insertedLength > mGapEnd - mGapStart)
-    reallocate_with_gap(pos, insertedLength + mPreferredGapSize);
-  else if (pos != mGapStart)
-    move_gap(pos);
-  
-  /* Insert the new text (pos now corresponds to the start of the gap) */
-  memcpy(&mBuf[pos], text, insertedLength);
-  mGapStart += insertedLength;
+  if (mPieces) {
+    mPieces->insert(pos, text, insertedLength);
+  } else {
+    /* Prepare the buffer to receive the new text.  If the new text fits in
+     the current buffer, just move the gap (if necessary) to where
+     the text should be inserted.  If the new text is too large, reallocate
+     the buffer with a gap large enough to accomodate the new text and a
+     gap of mPreferredGapSize */
+    if (insertedLength > mGapEnd - mGapStart)
+      reallocate_with_gap(pos, insertedLength + mPreferredGapSize);
+    else if (pos != mGapStart)
+      move_gap(pos);
+    
+    /* Insert the new text (pos now corresponds to the start of the gap) */
+    memcpy(&mBuf[pos], text, insertedLength);
+    mGapStart += insertedLength;
+  }
+  if (mCheckPos < 0 || pos < mCheckPos)
+    mLineIndex->insert(pos, text, insertedLength);
   mLength += insertedLength;
+  if (pos < mCheckPos)
+    mCheckPos += insertedLength;
   update_selections(pos, 0, insertedLength);
   
-  if (mCanUndo) {
-    if (undowidget == this && undoat == pos && undoinsert) {
-      undoinsert += insertedLength;
-    } else {
-      undoinsert = insertedLength;
-      undoyankcut = (undoat == pos) ? undocut : 0;
-    }
-    undoat = pos + insertedLength;
-    undocut = 0;
-    undowidget = this;
-  }
+  if (mCanUndo)
+    mUndo->inserted(pos, insertedLength);
   
   return insertedLength;
 }
@@ -1215,43 +1366,32 @@ void Fl_Text_Buffer::remove_(int start, int end)
   /* if the gap is not contiguous to the area to remove, move it there */
   
   if (mCanUndo) {
-    if (undowidget == this && undoat == end && undocut) {
-      undobuffersize(undocut + end - start + 1);
-      memmove(undobuffer + end - start, undobuffer, undocut);
-      undocut += end - start;
-    } else {
-      undocut = end - start;
-      undobuffersize(undocut);
-    }
-    undoat = start;
-    undoinsert = 0;
-    undoyankcut = 0;
-    undowidget = this;
+    char *deleted = mUndo->deleting(start, end);
+    if (deleted)
+      copy_range_(deleted, start, end);
   }
   
-  if (start > mGapStart) {
-    if (mCanUndo)
-      memcpy(undobuffer, mBuf + (mGapEnd - mGapStart) + start,
-	     end - start);
-    move_gap(start);
-  } else if (end < mGapStart) {
-    if (mCanUndo)
-      memcpy(undobuffer, mBuf + start, end - start);
-    move_gap(end);
+  if (mPieces) {
+    mPieces->remove(start, end);
   } else {
-    int prelen = mGapStart - start;
-    if (mCanUndo) {
-      memcpy(undobuffer, mBuf + start, prelen);
-      memcpy(undobuffer + prelen, mBuf + mGapEnd, end - start - prelen);
-    }
+    if (start > mGapStart)
+      move_gap(start);
+    else if (end < mGapStart)
+      move_gap(end);
+    
+    /* expand the gap to encompass the deleted characters */
+    mGapEnd += end - mGapStart;
+    mGapStart = start;
   }
-  
-  /* expand the gap to encompass the deleted characters */
-  mGapEnd += end - mGapStart;
-  mGapStart = start;
+  if (mCheckPos < 0 || end <= mCheckPos)
+    mLineIndex->remove(start, end);
+  else if (start < mCheckPos)
+    mLineIndex->remove(start, mCheckPos);
   
   /* update the length */
   mLength -= end - start;
+  if (start < mCheckPos)
+    mCheckPos = (end < mCheckPos) ? mCheckPos - (end - start) : start;
   
   /* fix up any selections which might be affected by the change */
   update_selections(start, end - start, 0);
@@ -1354,7 +1494,6 @@ void Fl_Text_Buffer::remove_selection_(Fl_Text_Selection * sel)
   if (!sel->position(&start, &end))
     return;
   remove(start, end);
-  //undoyankcut = undocut;
 }
 
 
@@ -1798,6 +1937,215 @@ const char *Fl_Text_Buffer::file_encoding_warning_message =
 }
 
 
+/*
+ Return the number of leading bytes in p[0..n) that are well-formed UTF-8,
+ using the same rules as utf8_input_filter(), and are not nul bytes.
+ */
+static int utf8_valid_length(const char *p, int n)
+{
+  const char *s = p, *e = p + n;
+  char multibyte[5];
+  while (s < e) {
+    if (!(*s & 0x80)) {
+      if (!*s)
+        break;  // nul bytes are transcoded to spaces
+      s++;
+      continue;
+    }
+    int l = fl_utf8len1(*s), lp;
+    if (s + l > e)
+      break;
+    unsigned u = fl_utf8decode(s, s + l, &lp);
+    if (lp != l || fl_utf8encode(u, multibyte) != l)
+      break;
+    s += l;
+  }
+  return (int) (s - p);
+}
+
+
+/*
+ Transcode n bytes of text to UTF-8 like utf8_input_filter() does.
+ Out must have room for 3*n bytes. Returns the output length, and in
+ changed the number of input bytes up to the last one that was changed.
+ If undo is not NULL, its history is moved over every changed character
+ of the text, which is at pos in the buffer.
+ */
+static int utf8_transcode(const char *p, int n, char *out, int *changed,
+                          Fl_Text_Undo *undo = 0, int pos = 0)
+{
+  const char *s = p, *e = p + n;
+  char *q = out;
+  *changed = 0;
+  while (s < e) {
+    int lp;
+    unsigned u = fl_utf8decode(s, e, &lp);
+    if (!u) u = ' ';  // a nul byte would end the replacement text
+    int l = fl_utf8encode(u, q);
+    if (l != lp || memcmp(q, s, l)) {
+      *changed = (int) (s + lp - p);
+      if (undo)
+        undo->replaced(pos + (int) (q - out), pos + (int) (q - out) + lp, l, 1);
+    }
+    q += l;
+    s += lp;
+  }
+  return (int) (q - out);
+}
+
+
+static void unmap_text(const char *text, int len)
+{
+  Fl::system_driver()->unmap_file((void *) text, (size_t) len);
+}
+
+
+/**
+ Replaces the buffer contents with a file that is mapped into memory.
+
+ Unlike loadfile(), this does not read the file upfront. The file is mapped
+ read-only and copy-on-write where the platform supports it, and the buffer
+ is switched to the PIECE_TABLE storage mode with the mapping as its only
+ piece. Pages are read from disk as the text is accessed, and edits are
+ stored separately, so the file itself is never written to.
+
+ The text is checked for valid UTF-8 and added to the line index
+ incrementally in idle callbacks. Until then, count_lines(), skip_lines()
+ and rewind_lines() scan the part of the text that is not indexed yet.
+ Invalid sequences are transcoded as with loadfile() when they are found,
+ and nul bytes are replaced by spaces. The buffer reports this like any
+ other modification, and transcoding_warning_action is called the first
+ time this happens. The transcoding is not recorded in the undo history,
+ and edits made before it can still be undone.
+
+ If the file can not be mapped, for instance because it is empty or the
+ platform does not support memory mapped files, this falls back to
+ loadfile().
+
+ \note The file must not be truncated or modified by other processes while
+   it is mapped. The mapping is released when the text is replaced by
+   text(), another mapfile(), a storage() change, or when the buffer is
+   deleted.
+
+ \param file UTF-8 encoded file name
+ \return the same as loadfile()
+ \see storage(int), loadfile()
+ \since FLTK 1.4.0
+ */
+int Fl_Text_Buffer::mapfile(const char *file)
+{
+  size_t size = 0;
+  const char *map = (const char *) Fl::system_driver()->map_file(file, &size);
+  if (!map)
+    return loadfile(file);
+  
+  call_predelete_callbacks(0, length());
+  const char *deletedText = text();
+  int deletedLength = mLength;
+  if (mPieces) {
+    mPieces->clear();
+  } else {
+    free((void *) mBuf);
+    mBuf = NULL;
+    mGapStart = mGapEnd = 0;
+    mPieces = new Fl_Text_Piece_Table();
+  }
+  mPieces->insert_external(0, map, (int) size, unmap_text);
+  mLineIndex->clear();   // filled in by check_utf8_()
+  mUndo->clear();
+  mLength = (int) size;
+  update_selections(0, deletedLength, 0);
+  
+  input_file_was_transcoded = 0;
+  if (mCheckPos < 0)
+    Fl::add_idle(check_utf8_cb_, this);
+  mCheckPos = 0;
+  
+  call_modify_callbacks(0, deletedLength, mLength, 0, deletedText);
+  free((void *) deletedText);
+  return 0;
+}
+
+
+void Fl_Text_Buffer::check_utf8_cb_(void *buf)
+{
+  if (!((Fl_Text_Buffer *) buf)->check_utf8_(1024 * 1024))
+    Fl::remove_idle(check_utf8_cb_, buf);
+}
+
+
+/*
+ Check the next chunk of text for valid UTF-8, transcode it if needed,
+ and add it to the line index.
+ */
+int Fl_Text_Buffer::check_utf8_(int nBytes)
+{
+  if (mCheckPos < 0)
+    return 0;
+  int pos = mCheckPos, end = pos + nBytes;
+  if (end >= mLength)
+    end = mLength;
+  else
+    while (end < mLength && (byte_at(end) & 0xc0) == 0x80)
+      end++;
+  
+  int bad = -1;
+  while (pos < end) {
+    const char *p;
+    int n = span_(pos, &p);
+    if (n > end - pos)
+      n = end - pos;
+    int ok = utf8_valid_length(p, n);
+    pos += ok;
+    if (ok < n) {
+      bad = pos;
+      break;
+    }
+  }
+  
+  if (bad >= 0) {
+    char *t = text_range(bad, end);
+    char *utf8 = (char *) malloc(3 * (end - bad) + 1);
+    int changed;
+    int len = utf8_transcode(t, end - bad, utf8, &changed);
+    // only replace the bytes up to the last changed one, so that edits after
+    // them stay in the undo history
+    len -= end - bad - changed;
+    utf8[len] = 0;
+    char canUndo = mCanUndo;
+    mCanUndo = 0;
+    replace(bad, bad + changed, utf8);
+    mCanUndo = canUndo;
+    if (!mUndo->replaced(bad, bad + changed, len, 0)) {
+      // some edits were made between the changed characters
+      utf8_transcode(t, changed, utf8, &changed, mUndo, bad);
+    }
+    free(utf8);
+    free(t);
+    pos = end + len - changed;
+  }
+  
+  // add the checked text to the line index
+  for (int start = mCheckPos; start < pos;) {
+    const char *p;
+    int n = span_(start, &p);
+    if (n > pos - start)
+      n = pos - start;
+    mLineIndex->insert(start, p, n);
+    start += n;
+  }
+  mCheckPos = (pos < mLength) ? pos : -1;
+  int more = (mCheckPos >= 0);
+  
+  if (bad >= 0 && !input_file_was_transcoded) {
+    input_file_was_transcoded = 1;
+    if (transcoding_warning_action)
+      transcoding_warning_action(this);
+  }
+  return more;
+}
+
+
 /*
  Write text to file.
  Unicode safe.
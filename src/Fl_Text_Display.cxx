@@ -32,6 +32,7 @@
 #include <FL/Fl_Text_Display.H>
 #include <FL/Fl_Window.H>
 #include "Fl_Screen_Driver.H"
+#include "Fl_Text_Layout_Cache.H"
 
 #undef min
 #undef max
@@ -73,6 +74,18 @@
  stack in the draw_vline() method for drawing strings */
 #define MAX_DISP_LINE_LEN 1000
 
+/* Incremental highlighting: lines restyled below the visible area, bytes
+ restyled at once, bytes restyled per idle call, and the largest distance
+ between the first stale line and the visible area that is restyled in
+ sequence right away */
+#define STYLE_LOOKAHEAD_LINES 20
+#define STYLE_CHUNK           4096
+#define STYLE_IDLE_BUDGET     65536
+#define STYLE_CATCHUP         65536
+
+/* Longest line for which x offsets of all characters are cached */
+#define LAYOUT_MAX_LINE_LEN 4096
+
 static int max( int i1, int i2 );
 static int min( int i1, int i2 );
 static int countlines( const char *string );
@@ -134,6 +147,12 @@ Fl_Text_Display::Fl_Text_Display(int X, int Y, int W, int H, const char* l)
   mUnfinishedStyle = 0;
   mUnfinishedHighlightCB = 0;
   mHighlightCBArg = 0;
+  mStyleParseCB = 0;
+  mStyleParseArg = 0;
+  mStyleDirtyStart = -1;
+  mStyleDirtyEnd = 0;
+  mStyleProvisional = -1;
+  mLayoutCache = new Fl_Text_Layout_Cache();
   mMaxsize = 0;
   mSuppressResync = 0;
   mNLinesDeleted = 0;
@@ -199,11 +218,13 @@ Fl_Text_Display::~Fl_Text_Display() {
     Fl::remove_timeout(scroll_timer_cb, this);
     scroll_direction = 0;
   }
+  Fl::remove_idle(restyle_idle_cb, this);
   if (mBuffer) {
     mBuffer->remove_modify_callback(buffer_modified_cb, this);
     mBuffer->remove_predelete_callback(buffer_predelete_cb, this);
   }
   if (mLineStarts) delete[] mLineStarts;
+  delete mLayoutCache;
   if (linenumber_format_) {
     free((void*)linenumber_format_);
     linenumber_format_ = 0;
@@ -423,10 +444,53 @@ void Fl_Text_Display::highlight_data(Fl_Text_Buffer *styleBuffer,
   mColumnScale = 0;
 
   mStyleBuffer->canUndo(0);
+  mLayoutCache->clear();
+  if (mStyleParseCB)
+    highlight_parser(mStyleParseCB, mStyleParseArg);
   damage(FL_DAMAGE_EXPOSE);
 }
 
 
+/**
+ \brief Let the text display maintain the style buffer incrementally.
+
+ Instead of updating the style buffer in a modify callback of the text
+ buffer, the application can provide a parser for a range of lines, and
+ the display takes care of the style buffer set by highlight_data():
+ it keeps the style buffer as long as the text, remembers which lines
+ were modified and calls \p parse for them as needed.
+
+ After a modification only the modified lines in the visible area and a few
+ lines below it are parsed right away. The remaining lines are parsed
+ in small steps in idle time (see Fl::add_idle()), until the style of the
+ last newline parsed matches the style it had before, so that typing in a
+ large file costs about the same as in a small one. Only the lines whose
+ styles actually changed are redrawn.
+
+ Styles in lines that have not been parsed yet may be out of date for a
+ short time. A style buffer that is maintained this way must not be
+ modified by the application, nor be shared with other text displays.
+
+ \param parse the parser, or NULL to stop maintaining the style buffer
+ \param cbArg an optional argument for the parser
+
+ \see Style_Parse_Cb, highlight_data()
+ \since FLTK 1.4.0
+ */
+void Fl_Text_Display::highlight_parser(Style_Parse_Cb parse, void *cbArg) {
+  mStyleParseCB = parse;
+  mStyleParseArg = cbArg;
+  mStyleDirtyStart = -1;
+  mStyleProvisional = -1;
+  Fl::remove_idle(restyle_idle_cb, this);
+  if (!mBuffer || !mStyleBuffer)
+    return;
+  // replace all styles, this also marks the whole buffer as stale
+  style_modified(0, mBuffer->length(), mStyleBuffer->length());
+  restyle_visible();
+}
+
+
 
 /**
  \brief Find the longest line of all visible lines.
@@ -1088,7 +1152,12 @@ int Fl_Text_Display::position_to_xy( int pos, int* X, int* Y ) const {
     *X = text_area.x - mHorizOffset;
     return 1;
   }
-  *X = text_area.x + handle_vline(GET_WIDTH, lineStartPos, pos-lineStartPos, 0, 0, 0, 0, 0, 0) - mHorizOffset;
+  int lineLen = vline_length(visLineNum);
+  const float *offsets = (pos-lineStartPos <= lineLen) ? line_offsets(lineStartPos, lineLen) : 0;
+  if (offsets)
+    *X = text_area.x + int(offsets[pos-lineStartPos]) - mHorizOffset;
+  else
+    *X = text_area.x + handle_vline(GET_WIDTH, lineStartPos, pos-lineStartPos, 0, 0, 0, 0, 0, 0) - mHorizOffset;
   return 1;
 }
 
@@ -1327,6 +1396,9 @@ int Fl_Text_Display::move_up() {
   /* Decide what column to move to, if there's a preferred column use that */
   if (mCursorPreferredXPos >= 0)
     xPos = mCursorPreferredXPos;
+  else if (visLineNum != -1 && mCursorPos-lineStartPos <= vline_length(visLineNum)
+           && line_offsets(lineStartPos, vline_length(visLineNum)))
+    xPos = int(line_offsets(lineStartPos, vline_length(visLineNum))[mCursorPos-lineStartPos]);
   else
     xPos = handle_vline(GET_WIDTH, lineStartPos, mCursorPos-lineStartPos,
                         0, 0, 0, 0, 0, INT_MAX);
@@ -1338,8 +1410,7 @@ int Fl_Text_Display::move_up() {
     prevLineStartPos = rewind_lines( lineStartPos, 1 );
 
   int lineEnd = line_end(prevLineStartPos, true);
-  newPos = handle_vline(FIND_INDEX_FROM_ZERO, prevLineStartPos, lineEnd-prevLineStartPos,
-                        0, 0, 0, 0, 0, xPos);
+  newPos = line_index_at_x(prevLineStartPos, lineEnd-prevLineStartPos, xPos, 0);
 
   /* move the cursor */
   insert_position( newPos );
@@ -1369,6 +1440,9 @@ int Fl_Text_Display::move_down() {
   }
   if (mCursorPreferredXPos >= 0) {
     xPos = mCursorPreferredXPos;
+  } else if (visLineNum != -1 && mCursorPos-lineStartPos <= vline_length(visLineNum)
+             && line_offsets(lineStartPos, vline_length(visLineNum))) {
+    xPos = int(line_offsets(lineStartPos, vline_length(visLineNum))[mCursorPos-lineStartPos]);
   } else {
     xPos = handle_vline(GET_WIDTH, lineStartPos, mCursorPos-lineStartPos,
                         0, 0, 0, 0, 0, INT_MAX);
@@ -1376,8 +1450,7 @@ int Fl_Text_Display::move_down() {
 
   int nextLineStartPos = skip_lines( lineStartPos, 1, true );
   int lineEnd = line_end(nextLineStartPos, true);
-  newPos = handle_vline(FIND_INDEX_FROM_ZERO, nextLineStartPos, lineEnd-nextLineStartPos,
-                        0, 0, 0, 0, 0, xPos);
+  newPos = line_index_at_x(nextLineStartPos, lineEnd-nextLineStartPos, xPos, 0);
 
   insert_position( newPos );
   mCursorPreferredXPos = xPos;
@@ -1683,6 +1756,9 @@ void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   IS_UTF8_ALIGNED2(buf, pos)
   IS_UTF8_ALIGNED2(buf, oldFirstChar)
 
+  /* keep a style buffer that we maintain in step with the text */
+  textD->style_modified(pos, nInserted, nDeleted);
+
   /* buffer modification cancels vertical cursor motion column */
   if ( nInserted != 0 || nDeleted != 0 )
     textD->mCursorPreferredXPos = -1;
@@ -1738,6 +1814,10 @@ void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   // refigure scrollbars & stuff
   textD->resize(textD->x(), textD->y(), textD->w(), textD->h());
 
+  // restyle the modified lines that are visible now
+  if ( nInserted != 0 || nDeleted != 0 )
+    textD->restyle_visible();
+
   // don't need to do anything else if not visible?
   if (!textD->visible_r()) return;
 
@@ -2587,11 +2667,8 @@ int Fl_Text_Display::xy_to_position( int X, int Y, int posType ) const {
   /* Get the line text and its length */
   lineLen = vline_length( visLineNum );
 
-  int mode = (posType == CURSOR_POS) ? FIND_CURSOR_INDEX : FIND_INDEX; // STR #2788
-  return handle_vline(mode,
-                      lineStart, lineLen, 0, 0,
-                      0, 0,
-                      text_area.x, X);
+  return line_index_at_x(lineStart, lineLen, X - text_area.x + mHorizOffset,
+                         posType == CURSOR_POS);
 }
 
 
@@ -2716,6 +2793,8 @@ void Fl_Text_Display::update_line_starts(int pos, int charsInserted,
   int charDelta = charsInserted - charsDeleted;
   int lineDelta = linesInserted - linesDeleted;
 
+  mLayoutCache->modified(pos, charsInserted, charsDeleted);
+
   /* If all of the changes were before the displayed text, the display
    doesn't change, just update the top line num and offset the line
    start entries and first and last characters */
@@ -3093,7 +3172,137 @@ int Fl_Text_Display::measure_vline( int visLineNum ) const {
   int lineLen = vline_length( visLineNum );
   int lineStartPos = mLineStarts[ visLineNum ];
   if (lineStartPos < 0 || lineLen == 0) return 0;
-  return handle_vline(GET_WIDTH, lineStartPos, lineLen, 0, 0, 0, 0, 0, 0);
+  return line_width(lineStartPos, lineLen);
+}
+
+
+/*
+ Hash of everything that the layout of a line depends on besides its text:
+ the fonts, the tab distance, the style of every byte, and the font and
+ size of the style table entries used in the line. The entries are hashed
+ by value, because programs change them in place and just call redraw().
+ */
+unsigned Fl_Text_Display::layout_key(int lineStartPos, int lineLen) const {
+  unsigned h = 2166136261U;
+  h = (h ^ (unsigned)textfont_) * 16777619U;
+  h = (h ^ (unsigned)textsize_) * 16777619U;
+  h = (h ^ (unsigned)mBuffer->tab_distance()) * 16777619U;
+  h = (h ^ (unsigned)mNStyles) * 16777619U;
+  if (mStyleBuffer && mNStyles) {
+    int prev = -1;
+    for (int i = 0; i < lineLen; i++) {
+      int style = (unsigned char)mStyleBuffer->byte_at(lineStartPos + i);
+      h = (h ^ (unsigned)style) * 16777619U;
+      if (style == prev || !style)
+        continue;
+      prev = style;
+      // the same entry as string_width() uses
+      int si = style - 'A';
+      if (si < 0) si = 0;
+      else if (si >= mNStyles) si = mNStyles - 1;
+      h = (h ^ (unsigned)mStyleTable[si].font) * 16777619U;
+      h = (h ^ (unsigned)mStyleTable[si].size) * 16777619U;
+    }
+  }
+  return h;
+}
+
+
+/*
+ Width of a line in pixels, measured once and then taken from the cache.
+ */
+int Fl_Text_Display::line_width(int lineStartPos, int lineLen) const {
+  unsigned key = layout_key(lineStartPos, lineLen);
+  Fl_Text_Layout_Cache::Line *l = mLayoutCache->find(lineStartPos, lineLen, key);
+  if (!l)
+    l = mLayoutCache->add(lineStartPos, lineLen, key);
+  if (l->width < 0) {
+    if (l->x)
+      l->width = int(l->x[lineLen]);
+    else
+      l->width = handle_vline(GET_WIDTH, lineStartPos, lineLen, 0, 0, 0, 0, 0, 0);
+  }
+  return l->width;
+}
+
+
+/*
+ X offsets of all bytes of a line relative to the line start, plus the
+ offset of the line end at index lineLen. Bytes inside a UTF-8 sequence
+ get the offset of the character. Text is measured the same way as in
+ handle_vline(): from the start of each style run, and tabs advance to
+ the next tab stop. Returns NULL for very long lines.
+ */
+const float *Fl_Text_Display::line_offsets(int lineStartPos, int lineLen) const {
+  if (lineStartPos < 0 || lineLen > LAYOUT_MAX_LINE_LEN)
+    return 0;
+  unsigned key = layout_key(lineStartPos, lineLen);
+  Fl_Text_Layout_Cache::Line *l = mLayoutCache->find(lineStartPos, lineLen, key);
+  if (!l)
+    l = mLayoutCache->add(lineStartPos, lineLen, key);
+  if (l->x)
+    return l->x;
+
+  float *x = (float *)malloc((lineLen + 1) * sizeof(float));
+  char *lineStr = mBuffer->text_range(lineStartPos, lineStartPos + lineLen);
+  double tab = col_to_x(mBuffer->tab_distance());
+  double runX = 0;
+  int runStart = 0, runStyle = -1;
+  x[0] = 0;
+  for (int i = 0; i < lineLen; ) {
+    int len = fl_utf8len1(lineStr[i]);
+    if (len <= 0) len = 1;
+    if (i + len > lineLen) len = lineLen - i;
+    double endX;
+    if (lineStr[i] == '\t') {
+      endX = (int(x[i]/tab)+1)*tab;
+      runStyle = -1;
+    } else {
+      int style = position_style(lineStartPos, lineLen, i) & STYLE_LOOKUP_MASK;
+      if (style != runStyle) {
+        runStart = i;
+        runX = x[i];
+        runStyle = style;
+      }
+      endX = runX + string_width(lineStr + runStart, i + len - runStart, style);
+    }
+    for (int k = 1; k < len; k++)
+      x[i + k] = x[i];
+    x[i + len] = (float)endX;
+    i += len;
+  }
+  free(lineStr);
+  l->x = x;
+  return x;
+}
+
+
+/*
+ Index into the buffer of the character at x pixels from the start of a
+ line, or of the closest character boundary if cursorPos is set.
+ */
+int Fl_Text_Display::line_index_at_x(int lineStartPos, int lineLen, int x, int cursorPos) const {
+  const float *offsets = line_offsets(lineStartPos, lineLen);
+  if (!offsets)
+    return handle_vline(cursorPos ? FIND_CURSOR_INDEX : FIND_INDEX,
+                        lineStartPos, lineLen, 0, 0, 0, 0,
+                        text_area.x, x + text_area.x - mHorizOffset);
+  if (lineStartPos < 0)
+    return lineStartPos;
+  // find the first byte whose end is right of x
+  int lo = 1, hi = lineLen + 1;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (offsets[mid] > x) hi = mid;
+    else lo = mid + 1;
+  }
+  if (lo > lineLen)
+    return lineStartPos + lineLen;
+  int pos = mBuffer->utf8_align(lineStartPos + lo - 1);
+  int next = lineStartPos + lo;
+  if (cursorPos && offsets[lo] - x < x - offsets[pos - lineStartPos])
+    return next;
+  return pos;
 }
 
 
@@ -3714,6 +3923,149 @@ void Fl_Text_Display::extend_range_for_styles( int *startpos, int *endpos ) {
 }
 
 
+/*
+ Keep the style buffer maintained by highlight_parser() in step with a text
+ modification. Inserted text gets the plain style 'A' for now, and the
+ modified lines are marked for restyling.
+ */
+void Fl_Text_Display::style_modified(int pos, int nInserted, int nDeleted) {
+  if (!mStyleParseCB || !mStyleBuffer || !mBuffer)
+    return;
+  if (nInserted == 0 && nDeleted == 0)
+    return;
+
+  char *style = (char *)malloc(nInserted + 1);
+  memset(style, 'A', nInserted);
+  style[nInserted] = '\0';
+  mStyleBuffer->replace(pos, pos + nDeleted, style);
+  free(style);
+
+  if (mStyleDirtyStart >= 0) {
+    // move the stale range with the text, then add the modified lines
+    if (mStyleDirtyEnd >= pos + nDeleted)
+      mStyleDirtyEnd += nInserted - nDeleted;
+    else if (mStyleDirtyEnd > pos)
+      mStyleDirtyEnd = pos;
+    mStyleDirtyStart = min(mStyleDirtyStart, pos);
+    mStyleDirtyEnd = max(mStyleDirtyEnd, pos + nInserted);
+  } else {
+    mStyleDirtyStart = pos;
+    mStyleDirtyEnd = pos + nInserted;
+  }
+  mStyleDirtyStart = mBuffer->line_start(mStyleDirtyStart);
+  mStyleProvisional = -1;
+  if (!Fl::has_idle(restyle_idle_cb, this))
+    Fl::add_idle(restyle_idle_cb, this);
+}
+
+
+/*
+ Parse the lines from start (which must be a line start) up to and
+ including the line containing end, update the style buffer and redraw
+ what changed. *changed is set if the style of the last byte changed, so
+ that the next line must be parsed as well. Returns the start of the next
+ line.
+ */
+int Fl_Text_Display::restyle_lines(int start, int end, int *changed) {
+  int length = mBuffer->length();
+  int lineEnd = mBuffer->line_end(end);
+  if (lineEnd < length)
+    lineEnd++;
+  *changed = 0;
+  int n = lineEnd - start;
+  if (n <= 0)
+    return lineEnd;
+
+  char *text = mBuffer->text_range(start, lineEnd);
+  char *oldStyle = mStyleBuffer->text_range(start, lineEnd);
+  char *style = (char *)malloc(n + 1);
+  style[0] = start > 0 ? mStyleBuffer->byte_at(start - 1) : 'A';
+  (mStyleParseCB)(text, style, n, mStyleParseArg);
+
+  int first = 0;
+  while (first < n && style[first] == oldStyle[first])
+    first++;
+  if (first < n) {
+    int last = n - 1;
+    while (style[last] == oldStyle[last])
+      last--;
+    *changed = (style[n - 1] != oldStyle[n - 1]);
+    style[last + 1] = '\0';
+    mStyleBuffer->replace(start + first, start + last + 1, style + first);
+    redisplay_range(start + first, start + last + 1);
+  }
+  free(text);
+  free(oldStyle);
+  free(style);
+  return lineEnd;
+}
+
+
+/*
+ Restyle stale lines in sequence until the first stale line is beyond
+ limit. Returns 1 if the whole style buffer is valid.
+ */
+int Fl_Text_Display::restyle(int limit) {
+  while (mStyleDirtyStart >= 0 && mStyleDirtyStart <= limit) {
+    int start = mStyleDirtyStart, changed;
+    int end = min(max(mStyleDirtyEnd, start), start + STYLE_CHUNK);
+    int next = restyle_lines(start, end, &changed);
+    if (next > mStyleDirtyEnd || next >= mBuffer->length()) {
+      // all modified lines are done, continue only if the style carried
+      // over to the next line changed
+      if (!changed || next >= mBuffer->length()) {
+        mStyleDirtyStart = -1;
+        break;
+      }
+      mStyleDirtyEnd = next;
+    }
+    mStyleDirtyStart = next;
+  }
+  return mStyleDirtyStart < 0;
+}
+
+
+/*
+ Restyle the stale lines in the visible area and a few lines below. If
+ stale lines above the visible area are close, restyle in sequence from
+ there, otherwise restyle the visible lines once ahead of time based on
+ the current style of the preceding line, the idle callback catches up.
+ */
+void Fl_Text_Display::restyle_visible() {
+  if (mStyleDirtyStart < 0 || !mBuffer)
+    return;
+  int visStart = mBuffer->line_start(mFirstChar);
+  int visEnd = mBuffer->skip_lines(mLastChar, STYLE_LOOKAHEAD_LINES);
+  if (mStyleDirtyStart > visEnd)
+    return;
+  if (visStart - mStyleDirtyStart <= STYLE_CATCHUP) {
+    if (restyle(visEnd))
+      Fl::remove_idle(restyle_idle_cb, this);
+  } else if (mStyleProvisional != visStart) {
+    int changed;
+    restyle_lines(visStart, visEnd, &changed);
+    mStyleProvisional = visStart;
+  }
+}
+
+
+/*
+ Idle callback that restyles the visible area first, and then a limited
+ number of bytes of the remaining stale lines.
+ */
+void Fl_Text_Display::restyle_idle_cb(void *data) {
+  Fl_Text_Display *textD = (Fl_Text_Display *)data;
+  if (!textD->mStyleParseCB || !textD->mStyleBuffer || !textD->mBuffer) {
+    Fl::remove_idle(restyle_idle_cb, data);
+    return;
+  }
+  textD->restyle_visible();
+  if (textD->mStyleDirtyStart < 0 ||
+      textD->restyle(textD->mStyleDirtyStart + STYLE_IDLE_BUDGET))
+    Fl::remove_idle(restyle_idle_cb, data);
+}
+
+
 /**
  \brief Draw the widget.
 
@@ -135,6 +135,7 @@ static struct {
 //{ FL_Clear,	  0,                        Fl_Text_Editor::delete_to_eol },
   { 'z',          FL_CTRL,                  Fl_Text_Editor::kf_undo	  },
   { '/',          FL_CTRL,                  Fl_Text_Editor::kf_undo	  },
+  { 'z',          FL_CTRL|FL_SHIFT,         Fl_Text_Editor::kf_redo       },
   { 'x',          FL_CTRL,                  Fl_Text_Editor::kf_cut        },
   { FL_Delete,    FL_SHIFT,                 Fl_Text_Editor::kf_cut        },
   { 'c',          FL_CTRL,                  Fl_Text_Editor::kf_copy       },
@@ -600,7 +601,7 @@ int Fl_Text_Editor::kf_select_all(int, Fl_Text_Editor* e) {
 int Fl_Text_Editor::kf_undo(int , Fl_Text_Editor* e) {
   e->buffer()->unselect();
   Fl::copy("", 0, 0);
-  int crsr;
+  int crsr = e->insert_position();
   int ret = e->buffer()->undo(&crsr);
   e->insert_position(crsr);
   e->show_insert_position();
@@ -609,6 +610,22 @@ int Fl_Text_Editor::kf_undo(int , Fl_Text_Editor* e) {
   return ret;
 }
 
+/** Redo the last undone edit in the current buffer of editor \p 'e'.
+    Also deselects previous selection.
+    The key value \p 'c' is currently unused.
+*/
+int Fl_Text_Editor::kf_redo(int , Fl_Text_Editor* e) {
+  e->buffer()->unselect();
+  Fl::copy("", 0, 0);
+  int crsr = e->insert_position();
+  int ret = e->buffer()->redo(&crsr);
+  e->insert_position(crsr);
+  e->show_insert_position();
+  e->set_changed();
+  if (e->when()&FL_WHEN_CHANGED) e->do_callback();
+  return ret;
+}
+
 /** Handles a key press in the editor */
 int Fl_Text_Editor::handle_key() {
   // Call FLTK's rules to try to turn this into a printing character.
@@ -643,6 +660,9 @@ int Fl_Text_Editor::handle_key() {
   Key_Func f;
   f = bound_key_function(key, state, global_key_bindings);
   if (!f) f = bound_key_function(key, state, key_bindings);
+  // only typing and deleting at the same place go into one undo step
+  if (f && f != kf_default && f != kf_backspace && f != kf_delete)
+    buffer()->seal_undo();
   if (f) return f(key, this);
   if (default_key_function_ && !state) return default_key_function_(c, this);
   return 0;
@@ -689,9 +709,11 @@ int Fl_Text_Editor::handle(int event) {
         fl_beep();
 	return 1;
       }
+      buffer()->seal_undo();
       buffer()->remove_selection();
       if (insert_mode()) insert(Fl::event_text());
       else overstrike(Fl::event_text());
+      buffer()->seal_undo();
       show_insert_position();
       set_changed();
       if (when()&FL_WHEN_CHANGED) do_callback();
@@ -704,6 +726,7 @@ int Fl_Text_Editor::handle(int event) {
       return 1;
 
     case FL_PUSH:
+      buffer()->seal_undo();
       if (Fl::event_button() == 2) {
         // don't let the text_display see this event
         if (Fl_Group::handle(event)) return 1;
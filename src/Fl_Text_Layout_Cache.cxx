@@ -0,0 +1,99 @@
+//
+// "$Id$"
+//
+// Line layout cache for the Fl_Text_Display class.
+//
+// Copyright 2001-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Text_Layout_Cache.H"
+#include <stdlib.h>
+
+
+Fl_Text_Layout_Cache::Fl_Text_Layout_Cache()
+{
+  mClock = 0;
+  for (int i = 0; i < SIZE; i++) {
+    mLines[i].start = -1;
+    mLines[i].x = 0;
+  }
+}
+
+
+Fl_Text_Layout_Cache::~Fl_Text_Layout_Cache()
+{
+  clear();
+}
+
+
+void Fl_Text_Layout_Cache::drop(Line &l)
+{
+  l.start = -1;
+  free(l.x);
+  l.x = 0;
+}
+
+
+void Fl_Text_Layout_Cache::clear()
+{
+  for (int i = 0; i < SIZE; i++)
+    drop(mLines[i]);
+}
+
+
+Fl_Text_Layout_Cache::Line *Fl_Text_Layout_Cache::find(int start, int len, unsigned key)
+{
+  for (int i = 0; i < SIZE; i++) {
+    Line &l = mLines[i];
+    if (l.start == start && l.len == len && l.key == key) {
+      l.used = ++mClock;
+      return &l;
+    }
+  }
+  return 0;
+}
+
+
+Fl_Text_Layout_Cache::Line *Fl_Text_Layout_Cache::add(int start, int len, unsigned key)
+{
+  Line *l = mLines;
+  for (int i = 0; i < SIZE && l->start >= 0; i++) {
+    if (mLines[i].start < 0 || mLines[i].used < l->used)
+      l = mLines + i;
+  }
+  drop(*l);
+  l->start = start;
+  l->len = len;
+  l->key = key;
+  l->width = -1;
+  l->used = ++mClock;
+  return l;
+}
+
+
+void Fl_Text_Layout_Cache::modified(int pos, int nInserted, int nDeleted)
+{
+  for (int i = 0; i < SIZE; i++) {
+    Line &l = mLines[i];
+    if (l.start < 0 || l.start + l.len < pos)
+      continue;
+    if (l.start > pos + nDeleted)
+      l.start += nInserted - nDeleted;
+    else
+      drop(l);
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,346 @@
+//
+// "$Id$"
+//
+// Line start index for the Fl_Text_Buffer class.
+//
+// Copyright 2001-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Text_Line_Index.H"
+#include <stdlib.h>
+#include "flstring.h"
+
+// Maximum number of lines in a chunk, and the number of lines per chunk
+// when a full chunk is split.
+#define CHUNK_MAX  512
+#define CHUNK_FILL 256
+
+
+Fl_Text_Line_Index::Fl_Text_Line_Index()
+{
+  mChunks = 0;
+  mNChunks = mAllocChunks = 0;
+  mByteTree = mLineTree = 0;
+  clear();
+}
+
+
+Fl_Text_Line_Index::~Fl_Text_Line_Index()
+{
+  delete_chunks(0, mNChunks);
+  free(mChunks);
+  free(mByteTree);
+  free(mLineTree);
+}
+
+
+void Fl_Text_Line_Index::clear()
+{
+  delete_chunks(0, mNChunks);
+  int empty = 0;
+  mNChunks = 0;
+  replace_chunk(-1, &empty, 1);
+  mLength = 0;
+  mLines = 1;
+}
+
+
+/*
+ Free the line arrays of n chunks starting at c and close the hole.
+ Call rebuild() afterwards.
+ */
+void Fl_Text_Line_Index::delete_chunks(int c, int n)
+{
+  if (n <= 0)
+    return;
+  for (int k = c; k < c + n; k++)
+    free(mChunks[k].len);
+  memmove(mChunks + c, mChunks + c + n, (mNChunks - c - n) * sizeof(Chunk));
+  mNChunks -= n;
+}
+
+
+/*
+ Replace chunk c by as many chunks as needed to hold n line lengths,
+ c == -1 appends new chunks. Rebuilds the trees.
+ */
+void Fl_Text_Line_Index::replace_chunk(int c, const int *len, int n)
+{
+  int m = (n + CHUNK_FILL - 1) / CHUNK_FILL;
+  if (mNChunks + m > mAllocChunks) {
+    mAllocChunks = mNChunks + m + mNChunks / 2;
+    mChunks = (Chunk *) realloc(mChunks, mAllocChunks * sizeof(Chunk));
+  }
+  if (c < 0) {
+    c = mNChunks++;
+    mChunks[c].len = (int *) malloc(CHUNK_MAX * sizeof(int));
+  }
+  memmove(mChunks + c + m, mChunks + c + 1, (mNChunks - c - 1) * sizeof(Chunk));
+  mNChunks += m - 1;
+  for (int k = 0; k < m; k++) {
+    Chunk &ck = mChunks[c + k];
+    if (k)
+      ck.len = (int *) malloc(CHUNK_MAX * sizeof(int));
+    ck.n = (n - k * CHUNK_FILL < CHUNK_FILL) ? n - k * CHUNK_FILL : CHUNK_FILL;
+    memcpy(ck.len, len + k * CHUNK_FILL, ck.n * sizeof(int));
+    ck.bytes = 0;
+    for (int i = 0; i < ck.n; i++)
+      ck.bytes += ck.len[i];
+  }
+  rebuild();
+}
+
+
+/*
+ Build both Fenwick trees from the chunks in O(n).
+ */
+void Fl_Text_Line_Index::rebuild()
+{
+  mByteTree = (int *) realloc(mByteTree, (mNChunks + 1) * sizeof(int));
+  mLineTree = (int *) realloc(mLineTree, (mNChunks + 1) * sizeof(int));
+  int i;
+  for (i = 1; i <= mNChunks; i++) {
+    mByteTree[i] = mChunks[i - 1].bytes;
+    mLineTree[i] = mChunks[i - 1].n;
+  }
+  for (i = 1; i <= mNChunks; i++) {
+    int j = i + (i & -i);
+    if (j <= mNChunks) {
+      mByteTree[j] += mByteTree[i];
+      mLineTree[j] += mLineTree[i];
+    }
+  }
+  for (mTopBit = 1; mTopBit * 2 <= mNChunks; mTopBit *= 2) { }
+}
+
+
+/*
+ Add to the byte and line counts of chunk c.
+ */
+void Fl_Text_Line_Index::add(int c, int dbytes, int dlines)
+{
+  for (int i = c + 1; i <= mNChunks; i += i & -i) {
+    mByteTree[i] += dbytes;
+    mLineTree[i] += dlines;
+  }
+}
+
+
+/*
+ Return the number of lines in all chunks before chunk c.
+ */
+int Fl_Text_Line_Index::prefix_lines(int c) const
+{
+  int sum = 0;
+  for (int i = c; i > 0; i -= i & -i)
+    sum += mLineTree[i];
+  return sum;
+}
+
+
+/*
+ Find the chunk containing the byte offset pos, which must be less than the
+ text length. Returns the chunk index and the byte offset where it starts.
+ */
+int Fl_Text_Line_Index::find_byte(int pos, int *base) const
+{
+  int idx = 0, sum = 0;
+  for (int step = mTopBit; step; step >>= 1) {
+    int j = idx + step;
+    if (j <= mNChunks && sum + mByteTree[j] <= pos) {
+      idx = j;
+      sum += mByteTree[j];
+    }
+  }
+  *base = sum;
+  return idx;
+}
+
+
+/*
+ Find the chunk containing line number line, which must be less than the
+ number of lines. Returns the chunk index, the number of lines before it in
+ lbase and the byte offset where it starts in bbase.
+ */
+int Fl_Text_Line_Index::find_line(int line, int *lbase, int *bbase) const
+{
+  int idx = 0, lsum = 0, bsum = 0;
+  for (int step = mTopBit; step; step >>= 1) {
+    int j = idx + step;
+    if (j <= mNChunks && lsum + mLineTree[j] <= line) {
+      idx = j;
+      lsum += mLineTree[j];
+      bsum += mByteTree[j];
+    }
+  }
+  *lbase = lsum;
+  *bbase = bsum;
+  return idx;
+}
+
+
+/*
+ Find the line containing pos: chunk c, index i in that chunk and the byte
+ offset where the line starts. Positions at or beyond the end of the text
+ are in the last line.
+ */
+void Fl_Text_Line_Index::locate(int pos, int *c, int *i, int *start) const
+{
+  if (pos >= mLength) {
+    *c = mNChunks - 1;
+    *i = mChunks[*c].n - 1;
+    *start = mLength - mChunks[*c].len[*i];
+    return;
+  }
+  if (pos < 0)
+    pos = 0;
+  int base;
+  *c = find_byte(pos, &base);
+  const Chunk &ck = mChunks[*c];
+  int k = 0;
+  while (base + ck.len[k] <= pos)
+    base += ck.len[k++];
+  *i = k;
+  *start = base;
+}
+
+
+int Fl_Text_Line_Index::line_of(int pos) const
+{
+  int c, i, start;
+  locate(pos, &c, &i, &start);
+  return prefix_lines(c) + i;
+}
+
+
+int Fl_Text_Line_Index::line_start(int line) const
+{
+  if (line <= 0)
+    return 0;
+  if (line >= mLines)
+    line = mLines - 1;
+  int lbase, pos;
+  const Chunk &ck = mChunks[find_line(line, &lbase, &pos)];
+  for (int k = 0; k < line - lbase; k++)
+    pos += ck.len[k];
+  return pos;
+}
+
+
+void Fl_Text_Line_Index::insert(int pos, const char *text, int len)
+{
+  if (len <= 0)
+    return;
+  int c, i, start;
+  locate(pos, &c, &i, &start);
+  mLength += len;
+
+  const char *end = text + len;
+  const char *nl = (const char *) memchr(text, '\n', len);
+  if (!nl) {
+    // the common case when typing: the line just gets longer
+    mChunks[c].len[i] += len;
+    mChunks[c].bytes += len;
+    add(c, len, 0);
+    return;
+  }
+
+  // split line i at pos and put the inserted lines in between
+  Chunk &ck = mChunks[c];
+  int before = pos - start, after = ck.len[i] - before;
+  int n = 0, alloc = 16;
+  int *lines = (int *) malloc(alloc * sizeof(int));
+  lines[n++] = before + (int) (nl - text) + 1;
+  for (const char *p = nl + 1; ; p = nl + 1) {
+    if (n + 1 >= alloc) {
+      alloc *= 2;
+      lines = (int *) realloc(lines, alloc * sizeof(int));
+    }
+    nl = (const char *) memchr(p, '\n', end - p);
+    if (!nl) {
+      lines[n++] = (int) (end - p) + after;
+      break;
+    }
+    lines[n++] = (int) (nl - p) + 1;
+  }
+  mLines += n - 1;
+
+  int total = ck.n - 1 + n;
+  if (total <= CHUNK_MAX) {
+    memmove(ck.len + i + n, ck.len + i + 1, (ck.n - i - 1) * sizeof(int));
+    memcpy(ck.len + i, lines, n * sizeof(int));
+    ck.n = total;
+    ck.bytes += len;
+    add(c, len, n - 1);
+  } else {
+    int *all = (int *) malloc(total * sizeof(int));
+    memcpy(all, ck.len, i * sizeof(int));
+    memcpy(all + i, lines, n * sizeof(int));
+    memcpy(all + i + n, ck.len + i + 1, (ck.n - i - 1) * sizeof(int));
+    replace_chunk(c, all, total);
+    free(all);
+  }
+  free(lines);
+}
+
+
+void Fl_Text_Line_Index::remove(int start, int end)
+{
+  if (end > mLength)
+    end = mLength;
+  if (start < 0)
+    start = 0;
+  if (end <= start)
+    return;
+  int c1, i1, s1, c2, i2, s2;
+  locate(start, &c1, &i1, &s1);
+  locate(end, &c2, &i2, &s2);
+  int removed = end - start;
+  // lines i1 to i2 become a single line
+  int merged = (start - s1) + (s2 + mChunks[c2].len[i2] - end);
+  int nlines = (prefix_lines(c2) + i2) - (prefix_lines(c1) + i1);
+  mLength -= removed;
+  mLines -= nlines;
+
+  Chunk &k1 = mChunks[c1];
+  if (c1 == c2) {
+    k1.len[i1] = merged;
+    memmove(k1.len + i1 + 1, k1.len + i2 + 1, (k1.n - i2 - 1) * sizeof(int));
+    k1.n -= nlines;
+    k1.bytes -= removed;
+    add(c1, -removed, -nlines);
+    return;
+  }
+
+  Chunk &k2 = mChunks[c2];
+  k1.len[i1] = merged;
+  k1.n = i1 + 1;
+  memmove(k2.len, k2.len + i2 + 1, (k2.n - i2 - 1) * sizeof(int));
+  k2.n -= i2 + 1;
+  if (k1.n + k2.n <= CHUNK_MAX) {
+    memcpy(k1.len + k1.n, k2.len, k2.n * sizeof(int));
+    k1.n += k2.n;
+    k2.n = 0;
+  }
+  int k;
+  for (k1.bytes = 0, k = 0; k < k1.n; k++)
+    k1.bytes += k1.len[k];
+  for (k2.bytes = 0, k = 0; k < k2.n; k++)
+    k2.bytes += k2.len[k];
+  delete_chunks(c1 + 1, k2.n ? c2 - c1 - 1 : c2 - c1);
+  rebuild();
+}
+
+//
+// End of "$Id$".
+//
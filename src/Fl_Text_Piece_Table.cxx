@@ -0,0 +1,329 @@
+//
+// "$Id$"
+//
+// Piece table storage for the Fl_Text_Buffer class.
+//
+// Copyright 2001-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Text_Piece_Table.H"
+#include <stdlib.h>
+#include "flstring.h"
+
+// Minimum size of a storage block for inserted text. Larger inserts
+// get a block of their own.
+#define PIECE_BLOCK_SIZE 65536
+
+
+Fl_Text_Piece_Table::Fl_Text_Piece_Table()
+{
+  mRoot = 0;
+  mBlocks = 0;
+  mPieces = 0;
+  mSeed = 2463534242U;
+  mCacheNode = 0;
+  mCacheStart = 0;
+}
+
+
+Fl_Text_Piece_Table::~Fl_Text_Piece_Table()
+{
+  clear();
+}
+
+
+/*
+ Remove all pieces and free all storage blocks.
+ */
+void Fl_Text_Piece_Table::clear()
+{
+  free_tree(mRoot);
+  mRoot = 0;
+  mPieces = 0;
+  mCacheNode = 0;
+  while (mBlocks) {
+    Block *next = mBlocks->next;
+    if (mBlocks->release)
+      mBlocks->release(mBlocks->external, mBlocks->size);
+    free(mBlocks);
+    mBlocks = next;
+  }
+}
+
+
+/*
+ Delete a subtree and return the number of deleted pieces.
+ The storage referenced by the pieces is kept.
+ */
+int Fl_Text_Piece_Table::free_tree(Node *n)
+{
+  int count = 0;
+  while (n) {
+    count += free_tree(n->left) + 1;
+    Node *right = n->right;
+    delete n;
+    n = right;
+  }
+  return count;
+}
+
+
+/*
+ Copy text into the most recent storage block, or into a new one if it
+ does not fit. Returns the address of the stored copy.
+ */
+const char *Fl_Text_Piece_Table::store(const char *text, int len)
+{
+  Block *b = mBlocks;
+  if (!b || b->size - b->used < len) {
+    int size = len > PIECE_BLOCK_SIZE ? len : PIECE_BLOCK_SIZE;
+    b = (Block *) malloc(sizeof(Block) + size);
+    b->size = size;
+    b->used = 0;
+    b->external = 0;
+    b->release = 0;
+    b->next = mBlocks;
+    mBlocks = b;
+  }
+  char *dst = (char *) (b + 1) + b->used;
+  memcpy(dst, text, len);
+  b->used += len;
+  return dst;
+}
+
+
+Fl_Text_Piece_Table::Node *Fl_Text_Piece_Table::new_node(const char *text, int len)
+{
+  // xorshift32, good enough to keep the treap balanced
+  mSeed ^= mSeed << 13;
+  mSeed ^= mSeed >> 17;
+  mSeed ^= mSeed << 5;
+  Node *n = new Node;
+  n->left = n->right = 0;
+  n->prio = mSeed;
+  n->text = text;
+  n->len = n->sublen = len;
+  mPieces++;
+  return n;
+}
+
+
+/*
+ Join two treaps. All text in a comes before all text in b.
+ */
+Fl_Text_Piece_Table::Node *Fl_Text_Piece_Table::merge(Node *a, Node *b)
+{
+  if (!a) return b;
+  if (!b) return a;
+  if (a->prio > b->prio) {
+    a->right = merge(a->right, b);
+    update(a);
+    return a;
+  }
+  b->left = merge(a, b->left);
+  update(b);
+  return b;
+}
+
+
+/*
+ Split a treap into the text before pos (l) and the text from pos on (r).
+ A piece that straddles pos is cut in two.
+ */
+void Fl_Text_Piece_Table::split(Node *t, int pos, Node *&l, Node *&r)
+{
+  if (!t) {
+    l = r = 0;
+    return;
+  }
+  int ll = size(t->left);
+  if (pos <= ll) {
+    split(t->left, pos, l, t->left);
+    update(t);
+    r = t;
+  } else if (pos >= ll + t->len) {
+    split(t->right, pos - ll - t->len, t->right, r);
+    update(t);
+    l = t;
+  } else {
+    int off = pos - ll;
+    Node *tail = new_node(t->text + off, t->len - off);
+    t->len = off;
+    r = merge(tail, t->right);
+    t->right = 0;
+    update(t);
+    l = t;
+  }
+}
+
+
+/*
+ Extend the piece ending at pos by len bytes if text directly follows that
+ piece in storage. This keeps typing from creating a piece per keystroke.
+ Returns 1 if the piece was extended.
+ */
+int Fl_Text_Piece_Table::grow(Node *t, int pos, const char *text, int len)
+{
+  if (!t)
+    return 0;
+  int ll = size(t->left), ret;
+  if (pos <= ll) {
+    ret = grow(t->left, pos, text, len);
+  } else if (pos < ll + t->len) {
+    return 0;
+  } else if (pos == ll + t->len) {
+    if (t->text + t->len != text)
+      return 0;
+    t->len += len;
+    ret = 1;
+  } else {
+    ret = grow(t->right, pos - ll - t->len, text, len);
+  }
+  if (ret)
+    t->sublen += len;
+  return ret;
+}
+
+
+/*
+ Insert len bytes at pos. Pos must be in the range 0..length().
+ */
+void Fl_Text_Piece_Table::insert(int pos, const char *text, int len)
+{
+  if (len <= 0)
+    return;
+  mCacheNode = 0;
+  const char *s = store(text, len);
+  if (pos > 0 && grow(mRoot, pos, s, len))
+    return;
+  insert_node(pos, new_node(s, len));
+}
+
+
+/*
+ Insert a piece that refers to memory owned by the caller, for instance a
+ memory mapped file. The block is registered with size == used, so that it
+ is never used to store inserted text.
+ */
+void Fl_Text_Piece_Table::insert_external(int pos, const char *text, int len,
+                                          void (*release)(const char *, int))
+{
+  if (len <= 0)
+    return;
+  mCacheNode = 0;
+  Block *b = (Block *) malloc(sizeof(Block));
+  b->size = b->used = len;
+  b->external = text;
+  b->release = release;
+  b->next = mBlocks;
+  mBlocks = b;
+  insert_node(pos, new_node(text, len));
+}
+
+
+void Fl_Text_Piece_Table::insert_node(int pos, Node *n)
+{
+  Node *l, *r;
+  split(mRoot, pos, l, r);
+  mRoot = merge(merge(l, n), r);
+}
+
+
+/*
+ Remove the text between start and end.
+ */
+void Fl_Text_Piece_Table::remove(int start, int end)
+{
+  if (end <= start)
+    return;
+  mCacheNode = 0;
+  Node *l, *m, *r;
+  split(mRoot, start, l, r);
+  split(r, end - start, m, r);
+  mPieces -= free_tree(m);
+  mRoot = merge(l, r);
+}
+
+
+/*
+ Find the piece containing pos and the text position where it starts.
+ */
+const Fl_Text_Piece_Table::Node *Fl_Text_Piece_Table::find(int pos, int *start) const
+{
+  const Node *n = mCacheNode;
+  if (n && pos >= mCacheStart && pos < mCacheStart + n->len) {
+    *start = mCacheStart;
+    return n;
+  }
+  int base = 0;
+  n = mRoot;
+  while (n) {
+    int ll = size(n->left);
+    if (pos < base + ll) {
+      n = n->left;
+    } else if (pos < base + ll + n->len) {
+      base += ll;
+      mCacheNode = n;
+      mCacheStart = base;
+      *start = base;
+      return n;
+    } else {
+      base += ll + n->len;
+      n = n->right;
+    }
+  }
+  return 0;
+}
+
+
+const char *Fl_Text_Piece_Table::address(int pos) const
+{
+  int start;
+  const Node *n = (pos >= 0) ? find(pos, &start) : 0;
+  if (!n)
+    return "";
+  return n->text + (pos - start);
+}
+
+
+int Fl_Text_Piece_Table::span(int pos, const char **p) const
+{
+  int start;
+  const Node *n = (pos >= 0) ? find(pos, &start) : 0;
+  if (!n) {
+    *p = "";
+    return 0;
+  }
+  *p = n->text + (pos - start);
+  return n->len - (pos - start);
+}
+
+
+void Fl_Text_Piece_Table::copy_out(char *dst, int start, int end) const
+{
+  while (start < end) {
+    const char *p;
+    int n = span(start, &p);
+    if (n <= 0)
+      break;
+    if (n > end - start)
+      n = end - start;
+    memcpy(dst, p, n);
+    dst += n;
+    start += n;
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,298 @@
+//
+// "$Id$"
+//
+// Undo history for the Fl_Text_Buffer class.
+//
+// Copyright 2001-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Text_Undo.H"
+#include <stdlib.h>
+#include "flstring.h"
+
+// Default memory limit of the undo history of one buffer.
+#define UNDO_DEFAULT_LIMIT (16*1024*1024)
+
+
+Fl_Text_Undo::Fl_Text_Undo()
+{
+  mOldest = mNewest = mRedo = 0;
+  mBytes = 0;
+  mLimit = UNDO_DEFAULT_LIMIT;
+  mSealed = 1;
+}
+
+
+Fl_Text_Undo::~Fl_Text_Undo()
+{
+  clear();
+}
+
+
+void Fl_Text_Undo::clear()
+{
+  clear_redo();
+  while (mNewest)
+    free_action(pop_undo());
+  mSealed = 1;
+}
+
+
+void Fl_Text_Undo::clear_redo()
+{
+  while (mRedo)
+    free_action(pop_redo());
+}
+
+
+void Fl_Text_Undo::limit(int bytes)
+{
+  mLimit = bytes;
+  trim();
+}
+
+
+/*
+ Free the oldest actions until the history fits into the memory limit.
+ The most recent action is always kept.
+ */
+void Fl_Text_Undo::trim()
+{
+  while (mBytes > mLimit && mOldest && mOldest != mNewest) {
+    Action *a = mOldest;
+    mOldest = a->newer;
+    mOldest->older = 0;
+    free_action(a);
+  }
+}
+
+
+Fl_Text_Undo::Action *Fl_Text_Undo::new_action(int pos, int ilen, int dlen)
+{
+  int size = dlen + 1;
+  Action *a = (Action *) malloc(sizeof(Action) + size);
+  a->pos = pos;
+  a->ilen = ilen;
+  a->dlen = dlen;
+  a->size = size;
+  mBytes += (int) sizeof(Action) + size;
+  return a;
+}
+
+
+void Fl_Text_Undo::free_action(Action *a)
+{
+  mBytes -= (int) sizeof(Action) + a->size;
+  free(a);
+}
+
+
+Fl_Text_Undo::Action *Fl_Text_Undo::reserve(Action *a, int n)
+{
+  if (a->size >= n)
+    return a;
+  if (n < 2 * a->size)
+    n = 2 * a->size;
+  mBytes += n - a->size;
+  a = (Action *) realloc(a, sizeof(Action) + n);
+  a->size = n;
+  return a;
+}
+
+
+/*
+ Make room in the most recent action and fix up the links to it.
+ */
+Fl_Text_Undo::Action *Fl_Text_Undo::grow_newest(int n)
+{
+  mNewest = reserve(mNewest, n);
+  if (mNewest->older)
+    mNewest->older->newer = mNewest;
+  else
+    mOldest = mNewest;
+  return mNewest;
+}
+
+
+Fl_Text_Undo::Action *Fl_Text_Undo::pop_undo()
+{
+  Action *a = mNewest;
+  if (a) {
+    mNewest = a->older;
+    if (mNewest)
+      mNewest->newer = 0;
+    else
+      mOldest = 0;
+  }
+  return a;
+}
+
+
+Fl_Text_Undo::Action *Fl_Text_Undo::pop_redo()
+{
+  Action *a = mRedo;
+  if (a)
+    mRedo = a->older;
+  return a;
+}
+
+
+void Fl_Text_Undo::push_undo(Action *a)
+{
+  a->older = mNewest;
+  a->newer = 0;
+  if (mNewest)
+    mNewest->newer = a;
+  else
+    mOldest = a;
+  mNewest = a;
+  mSealed = 1;
+  trim();
+}
+
+
+void Fl_Text_Undo::push_redo(Action *a)
+{
+  a->older = mRedo;
+  a->newer = 0;
+  mRedo = a;
+  mSealed = 1;
+}
+
+
+void Fl_Text_Undo::inserted(int pos, int len)
+{
+  if (len <= 0)
+    return;
+  clear_redo();
+  Action *a = mSealed ? 0 : mNewest;
+  if (a && pos == a->pos + a->ilen) {
+    // typing: extend the current run
+    a->ilen += len;
+  } else {
+    push_undo(new_action(pos, len, 0));
+  }
+  mSealed = 0;
+}
+
+
+/*
+ Move the actions of one stack, most recent first, over the replacement of
+ the bytes from start to end by end-start+delta other bytes. An action
+ after the replaced bytes moves by delta, and the replaced bytes move by
+ what an action before them inserted and deleted. Returns the first action
+ that edited some of the replaced bytes, or NULL. Nothing is changed unless
+ apply is set.
+ */
+Fl_Text_Undo::Action *Fl_Text_Undo::shift(Action *a, int start, int end,
+                                          int delta, int apply)
+{
+  for (; a; a = a->older) {
+    if (end <= a->pos) {
+      if (apply)
+        a->pos += delta;
+    } else if (start >= a->pos + a->ilen) {
+      start += a->dlen - a->ilen;
+      end += a->dlen - a->ilen;
+    } else {
+      return a;
+    }
+  }
+  return 0;
+}
+
+
+int Fl_Text_Undo::replaced(int start, int end, int len, int drop)
+{
+  if (!drop && (shift(mNewest, start, end, 0, 0) ||
+                shift(mRedo, start, end, 0, 0)))
+    return 0;
+  int delta = len - (end - start);
+  Action *a = shift(mNewest, start, end, delta, 1);
+  if (a) {
+    // this action edited the replaced bytes, it and all older ones are lost
+    Action *keep = a->newer;
+    while (mOldest != keep) {
+      Action *b = mOldest;
+      mOldest = b->newer;
+      free_action(b);
+    }
+    if (keep)
+      keep->older = 0;
+    else
+      mNewest = 0;
+    mSealed = 1;
+  }
+  a = shift(mRedo, start, end, delta, 1);
+  if (a) {
+    // the same for the redo stack, where older means redone later
+    Action **p = &mRedo;
+    while (*p != a)
+      p = &(*p)->older;
+    *p = 0;
+    while (a) {
+      Action *b = a;
+      a = a->older;
+      free_action(b);
+    }
+  }
+  return 1;
+}
+
+
+char *Fl_Text_Undo::deleting(int start, int end)
+{
+  int len = end - start;
+  if (len <= 0)
+    return 0;
+  clear_redo();
+  if (len > mLimit) {
+    // too large to keep, older actions could not be undone without it
+    clear();
+    return 0;
+  }
+  Action *a = mSealed ? 0 : mNewest;
+  char *dst;
+  if (a && start >= a->pos && end <= a->pos + a->ilen) {
+    // deleting text that was just typed, undo no longer needs to remove it
+    a->ilen -= len;
+    if (!a->ilen && !a->dlen) {
+      free_action(pop_undo());
+      mSealed = 1;
+    }
+    return 0;
+  } else if (a && !a->ilen && end == a->pos) {
+    // BackSpace: prepend
+    a = grow_newest(a->dlen + len + 1);
+    memmove(a->text() + len, a->text(), a->dlen);
+    a->pos = start;
+    a->dlen += len;
+    dst = a->text();
+  } else if (a && !a->ilen && start == a->pos) {
+    // Delete: append
+    a = grow_newest(a->dlen + len + 1);
+    dst = a->text() + a->dlen;
+    a->dlen += len;
+  } else {
+    a = new_action(start, 0, len);
+    push_undo(a);
+    dst = a->text();
+  }
+  mSealed = 0;
+  trim();
+  return dst;
+}
+
+//
+// End of "$Id$".
+//
@@ -261,6 +261,7 @@ static DataReady dataready;
 
 void DataReady::AddFD(int n, int events, void (*cb)(int, void*), void *v)
 {
+  events &= ~FL_EDGE;
   RemoveFD(n, events);
   int i = nfds++;
   if (i >= fd_array_size) 
@@ -67,6 +67,7 @@
 */
 
 #ifndef FL_DOXYGEN
+// The awake ring buffer is no longer used, see Awake_Node below.
 Fl_Awake_Handler *Fl::awake_ring_;
 void **Fl::awake_data_;
 int Fl::awake_ring_size_;
@@ -74,59 +75,149 @@ int Fl::awake_ring_head_;
 int Fl::awake_ring_tail_;
 #endif
 
-static const int AWAKE_RING_SIZE = 1024;
 static void lock_ring();
 static void unlock_ring();
 
-/** Adds an awake handler for use in awake(). */
-int Fl::add_awake_handler_(Fl_Awake_Handler func, void *data)
-{
-  int ret = 0;
-  lock_ring();
-  if (!awake_ring_) {
-    awake_ring_size_ = AWAKE_RING_SIZE;
-    awake_ring_ = (Fl_Awake_Handler*)malloc(awake_ring_size_*sizeof(Fl_Awake_Handler));
-    awake_data_ = (void**)malloc(awake_ring_size_*sizeof(void*));
-    // explicitly initialize the head and tail indices
-    awake_ring_head_= awake_ring_tail_ = 0;
+/*
+ Awake handlers are kept in an unbounded lock-free queue with many
+ producers (the threads calling Fl::awake()) and one consumer (the main
+ thread). Producers append a node with one atomic exchange of the head
+ pointer and never wait for each other or for the main thread. This is the
+ intrusive MPSC queue by Dmitry Vyukov, using a stub node so that the queue
+ is never empty. Popping is serialized by the ring mutex, which producers
+ do not use.
+
+ Producers only write to the wake-up pipe (or post a message) if no wake-up
+ is pending yet, so that one wake-up covers any number of handlers. The
+ main thread clears the pending flag when it finds the queue empty and
+ then looks once more.
+ */
+struct Awake_Node {
+  Awake_Node *next;
+  Fl_Awake_Handler func;
+  void *data;
+};
+
+static Awake_Node awake_stub;
+static Awake_Node *awake_head = &awake_stub;   // last node, producers push here
+static Awake_Node *awake_tail = &awake_stub;   // first node, consumer pops here
+static int awake_wake_pending;
+
+#if defined(__ATOMIC_SEQ_CST)
+
+static inline Awake_Node *awake_xchg(Awake_Node **p, Awake_Node *v) {
+  return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+static inline Awake_Node *awake_load(Awake_Node **p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void awake_store(Awake_Node **p, Awake_Node *v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+static inline int awake_xchg_flag(int v) {
+  return __atomic_exchange_n(&awake_wake_pending, v, __ATOMIC_SEQ_CST);
+}
+
+#elif defined(_MSC_VER)
+
+#  include <windows.h>
+static inline Awake_Node *awake_xchg(Awake_Node **p, Awake_Node *v) {
+  return (Awake_Node *)InterlockedExchangePointer((PVOID volatile *)p, v);
+}
+static inline Awake_Node *awake_load(Awake_Node **p) {
+  Awake_Node *v = *(Awake_Node * volatile *)p;
+  MemoryBarrier();
+  return v;
+}
+static inline void awake_store(Awake_Node **p, Awake_Node *v) {
+  MemoryBarrier();
+  *(Awake_Node * volatile *)p = v;
+}
+static inline int awake_xchg_flag(int v) {
+  return (int)InterlockedExchange((LONG volatile *)&awake_wake_pending, v);
+}
+
+#else // older gcc and compatible compilers
+
+static inline Awake_Node *awake_xchg(Awake_Node **p, Awake_Node *v) {
+  __sync_synchronize();
+  return __sync_lock_test_and_set(p, v);
+}
+static inline Awake_Node *awake_load(Awake_Node **p) {
+  Awake_Node *v = *(Awake_Node * volatile *)p;
+  __sync_synchronize();
+  return v;
+}
+static inline void awake_store(Awake_Node **p, Awake_Node *v) {
+  __sync_synchronize();
+  *(Awake_Node * volatile *)p = v;
+}
+static inline int awake_xchg_flag(int v) {
+  __sync_synchronize();
+  return __sync_lock_test_and_set(&awake_wake_pending, v);
+}
+
+#endif
+
+static void awake_push(Awake_Node *n) {
+  n->next = 0;
+  Awake_Node *prev = awake_xchg(&awake_head, n);
+  awake_store(&prev->next, n);
+}
+
+// Returns the first node, or NULL if the queue is empty or a producer is
+// in the middle of adding the next node. Call with the ring mutex locked.
+static Awake_Node *awake_pop() {
+  Awake_Node *tail = awake_tail;
+  Awake_Node *next = awake_load(&tail->next);
+  if (tail == &awake_stub) {
+    if (!next) return 0;
+    awake_tail = tail = next;
+    next = awake_load(&next->next);
   }
-  // The next head index we will want (not the current index):
-  // We use this to check if the ring-buffer is full or not
-  // (and to update awake_ring_head_ if we do use the current index.)
-  int next_head = awake_ring_head_ + 1;
-  if (next_head >= awake_ring_size_) {
-    next_head = 0;
+  if (next) {
+    awake_tail = next;
+    return tail;
   }
-  // check that the ring buffer is not full, and that it exists
-  if ((!awake_ring_) || (next_head == awake_ring_tail_)) {
-    // ring is non-existent or full. Return -1 as an error indicator.
-    ret = -1;
-  } else {
-    awake_ring_[awake_ring_head_] = func;
-    awake_data_[awake_ring_head_] = data;
-    awake_ring_head_ = next_head;
+  if (tail != awake_load(&awake_head)) return 0;
+  // tail is the only node, put the stub behind it so that it can be removed
+  awake_push(&awake_stub);
+  next = awake_load(&tail->next);
+  if (next) {
+    awake_tail = next;
+    return tail;
   }
-  unlock_ring();
-  return ret;
+  return 0;
+}
+
+/** Adds an awake handler for use in awake(). */
+int Fl::add_awake_handler_(Fl_Awake_Handler func, void *data)
+{
+  Awake_Node *n = (Awake_Node*)malloc(sizeof(Awake_Node));
+  if (!n) return -1;
+  n->func = func;
+  n->data = data;
+  awake_push(n);
+  return 0;
 }
 
 /** Gets the last stored awake handler for use in awake(). */
 int Fl::get_awake_handler_(Fl_Awake_Handler &func, void *&data)
 {
-  int ret = 0;
   lock_ring();
-  if ((!awake_ring_) || (awake_ring_head_ == awake_ring_tail_)) {
-    ret = -1;
-  } else {
-    func = awake_ring_[awake_ring_tail_];
-    data = awake_data_[awake_ring_tail_];
-    ++awake_ring_tail_;
-    if (awake_ring_tail_ >= awake_ring_size_) {
-      awake_ring_tail_ = 0;
-    }
+  Awake_Node *n = awake_pop();
+  if (!n) {
+    // allow the next Fl::awake(cb, data) to wake us up, then make sure
+    // that no handler was added in the meantime
+    awake_xchg_flag(0);
+    n = awake_pop();
   }
   unlock_ring();
-  return ret;
+  if (!n) return -1;
+  func = n->func;
+  data = n->data;
+  free(n);
+  return 0;
 }
 
 /**
@@ -134,17 +225,111 @@ int Fl::get_awake_handler_(Fl_Awake_Handler &func, void *&data)
  Registers a function that will be 
  called by the main thread during the next message handling cycle. 
  Returns 0 if the callback function was registered, 
- and -1 if registration failed. Over a thousand awake callbacks can be
- registered simultaneously.
+ and -1 if registration failed because memory ran out. There is no limit
+ on the number of awake callbacks that can be registered simultaneously.
+
+ Calling this does not block. Many calls in a row wake up the main thread
+ only once, and it then calls all registered functions in order.
  
  \see Fl::awake(void* message=0)
 */
 int Fl::awake(Fl_Awake_Handler func, void *data) {
   int ret = add_awake_handler_(func, data);
-  Fl::awake();
+  if (!awake_xchg_flag(1))
+    Fl::awake();
   return ret;
 }
 
+/*
+ Pending keyed awake handlers, hashed by key. Each one has a single node
+ in the awake queue that calls keyed_awake_cb(), which then calls the
+ handler most recently posted with that key. The table is protected by
+ the ring mutex.
+ */
+struct Keyed_Awake {
+  const void *key;
+  Fl_Awake_Handler func;
+  void *data;
+  Keyed_Awake *next;
+};
+
+#define KEYED_AWAKE_BUCKETS 256
+static Keyed_Awake *keyed_awake[KEYED_AWAKE_BUCKETS];
+
+static unsigned keyed_awake_hash(const void *key) {
+  unsigned long h = (unsigned long)(fl_intptr_t)key;
+  h ^= h >> 16;
+  return (unsigned)(h * 2654435761UL) % KEYED_AWAKE_BUCKETS;
+}
+
+static void keyed_awake_cb(void *v) {
+  Keyed_Awake *k = (Keyed_Awake*)v;
+  lock_ring();
+  Keyed_Awake **p = keyed_awake + keyed_awake_hash(k->key);
+  while (*p != k) p = &((*p)->next);
+  *p = k->next;
+  unlock_ring();
+  Fl_Awake_Handler func = k->func;
+  void *data = k->data;
+  free(k);
+  func(data);
+}
+
+/**
+ Let the main thread call a function, replacing any pending call with the same key.
+ Works like Fl::awake(Fl_Awake_Handler, void*), but if a function registered
+ with the same \p key has not been called yet, it is not called at all:
+ the main thread calls only \p cb with \p message instead, at the position
+ in the queue of the first pending call with that key. This suits progress
+ updates and other state that is stale as soon as a newer one exists,
+ where only the latest state needs to be shown.
+
+ The message of a replaced call is dropped. If it points to allocated
+ memory, the caller must be able to free it otherwise, for instance by
+ reusing one buffer per key.
+
+ Returns 0 if the callback function was registered, and -1 if
+ registration failed because memory ran out.
+
+ \param[in] cb the function to call
+ \param[in] message the argument passed to \p cb
+ \param[in] key identifies calls that replace each other, for instance a widget
+ \see Fl::awake(Fl_Awake_Handler cb, void* message)
+*/
+int Fl::awake(Fl_Awake_Handler cb, void *message, const void *key) {
+  lock_ring();
+  Keyed_Awake **head = keyed_awake + keyed_awake_hash(key);
+  Keyed_Awake *k;
+  for (k = *head; k; k = k->next) {
+    if (k->key == key) {
+      k->func = cb;
+      k->data = message;
+      unlock_ring();
+      return 0;
+    }
+  }
+  k = (Keyed_Awake*)malloc(sizeof(Keyed_Awake));
+  if (!k) {
+    unlock_ring();
+    return -1;
+  }
+  k->key = key;
+  k->func = cb;
+  k->data = message;
+  k->next = *head;
+  *head = k;
+  unlock_ring();
+  if (awake(keyed_awake_cb, k) == 0)
+    return 0;
+  lock_ring();
+  Keyed_Awake **p = head;
+  while (*p != k) p = &((*p)->next);
+  *p = k->next;
+  unlock_ring();
+  free(k);
+  return -1;
+}
+
 /** \fn int Fl::lock()
     The lock() method blocks the current thread until it
     can safely access FLTK widgets and data. Child threads should
@@ -330,9 +515,11 @@ void* Fl_Posix_System_Driver::thread_message() {
 }
 
 static void thread_awake_cb(int fd, void*) {
-  if (read(fd, &thread_message_, sizeof(void*))==0) { 
-    /* This should never happen */
-  }
+  // read a batch of messages and keep the last one
+  void *msg[64];
+  ssize_t n = read(fd, msg, sizeof(msg));
+  if (n >= (ssize_t)sizeof(void*))
+    thread_message_ = msg[n / sizeof(void*) - 1];
   Fl_Awake_Handler func;
   void *data;
   while (Fl::get_awake_handler_(func, data)==0) {
@@ -386,19 +573,16 @@ void Fl_Posix_System_Driver::unlock() {
   fl_unlock_function();
 }
 
-// Mutex code for the awake ring buffer
-static pthread_mutex_t *ring_mutex;
+// Mutex code for the awake ring buffer, statically initialized because
+// the first threads may lock it at the same time
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 void unlock_ring() {
-  pthread_mutex_unlock(ring_mutex);
+  pthread_mutex_unlock(&ring_mutex);
 }
 
 void lock_ring() {
-  if (!ring_mutex) {
-    ring_mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
-    pthread_mutex_init(ring_mutex, NULL);
-  }
-  pthread_mutex_lock(ring_mutex);
+  pthread_mutex_lock(&ring_mutex);
 }
 
 #else // ! HAVE_PTHREAD
@@ -323,6 +323,7 @@ extern unsigned int fl_codepage;
 void fl_set_status(int x, int y, int w, int h) {}
 
 void Fl_WinAPI_System_Driver::add_fd(int n, int events, void (*cb)(FL_SOCKET, void *), void *v) {
+  events &= ~FL_EDGE;
   remove_fd(n, events);
   int i = nfds++;
   if (i >= fd_array_size) {
@@ -488,29 +489,17 @@ double Fl_WinAPI_Screen_Driver::wait(double time_to_wait) {
     DispatchMessageW(&fl_msg);
   }
 
-  // The following conditional test:
-  //    (Fl::awake_ring_head_ != Fl::awake_ring_tail_)
-  // is a workaround / fix for STR #3143. This works, but a better solution
-  // would be to understand why the PostThreadMessage() messages are not
-  // seen by the main window if it is being dragged/ resized at the time.
-  // If a worker thread posts an awake callback to the ring buffer
-  // whilst the main window is unresponsive (if a drag or resize operation
-  // is in progress) we may miss the PostThreadMessage(). So here, we check if
-  // there is anything pending in the awake ring buffer and if so process
-  // it. This is not strictly thread safe (for speed it compares the head
-  // and tail indices without first locking the ring buffer) but is intended
-  // only as a fall-back recovery mechanism if the awake processing stalls.
-  // If the test erroneously returns true (may happen if we test the indices
-  // whilst they are being modified) we will call process_awake_handler_requests()
-  // unnecessarily, but this has no harmful consequences so is safe to do.
-  // Note also that if we miss the PostThreadMessage(), then thread_message_
+  // Process any pending awake callbacks here as well. This is a workaround /
+  // fix for STR #3143: the PostThreadMessage() messages are not seen by the
+  // main window if it is being dragged/ resized at the time, so a worker
+  // thread posting an awake callback whilst the main window is unresponsive
+  // may go unnoticed. Since Fl::awake(cb, data) only posts a message if no
+  // wake-up is pending, a lost message would otherwise stall all later
+  // callbacks. Checking the awake queue costs almost nothing when it is
+  // empty. Note that if we miss the PostThreadMessage(), then thread_message_
   // will not be updated, so this is not a perfect solution, but it does
-  // recover and process any pending awake callbacks.
-  // Normally the ring buffer head and tail indices will match and this
-  // comparison will do nothing. Addresses STR #3143
-  if (Fl::awake_ring_head_ != Fl::awake_ring_tail_) {
-    process_awake_handler_requests();
-  }
+  // recover and process any pending awake callbacks. Addresses STR #3143
+  process_awake_handler_requests();
 
   Fl::flush();
 
@@ -80,6 +80,14 @@ extern Fl_Widget *fl_selection_requestor;
 ////////////////////////////////////////////////////////////////
 // interface to poll/select call:
 
+#  if USE_EPOLL
+// poll() is the fallback if epoll is not available at run time
+#    undef USE_POLL
+#    define USE_POLL 1
+#    include <sys/epoll.h>
+#    include <errno.h>
+#  endif
+
 #  if USE_POLL
 
 #    include <poll.h>
@@ -114,7 +122,151 @@ struct FD {
 
 static FD *fd = 0;
 
+#  if USE_EPOLL
+
+// With epoll the kernel keeps the set of file descriptors and reports only
+// the ready ones, so waiting and dispatching take time proportional to the
+// number of ready fds. The handlers of each fd are found in a table indexed
+// by the fd. If epoll is not available at run time, the poll() code above
+// and below is used instead.
+//
+// epoll refuses regular files, which poll() always reports as ready. Such
+// fds are kept in the table as well and are reported as ready after each
+// epoll_wait(), which then does not block.
+
+struct Epoll_Handler {
+  short events;
+  void (*cb)(int, void*);
+  void* arg;
+  Epoll_Handler* next;
+};
+
+struct Epoll_FD {
+  Epoll_Handler* handlers;
+  char state;                   // 0: unused, 1: in epoll set, 2: regular file
+};
+
+static int epoll_fd = -2;               // -1 if epoll is not available
+static Epoll_FD* epoll_fds = 0;
+static int epoll_fds_size = 0;
+static int epoll_nfds = 0;              // number of fds with handlers
+static int epoll_nfiles = 0;            // number of those with state 2
+#    define EPOLL_MAX_EVENTS 64
+
+static bool use_epoll() {
+  if (epoll_fd == -2) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) epoll_fd = -1;
+  }
+  return epoll_fd >= 0;
+}
+
+// registers the union of the events of all handlers of fd n with epoll
+static void epoll_update(int n) {
+  Epoll_FD& f = epoll_fds[n];
+  int events = 0;
+  for (Epoll_Handler* h = f.handlers; h; h = h->next) events |= h->events;
+  if (!events) {
+    if (f.state == 1) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, n, 0);
+    if (f.state == 2) epoll_nfiles--;
+    if (f.state) epoll_nfds--;
+    f.state = 0;
+    return;
+  }
+  if (f.state == 2) return;
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  if (events & FL_READ) ev.events |= EPOLLIN;
+  if (events & FL_WRITE) ev.events |= EPOLLOUT;
+  if (events & FL_EXCEPT) ev.events |= EPOLLPRI;
+  if (events & FL_EDGE) ev.events |= EPOLLET;
+  ev.data.fd = n;
+  if (f.state == 1 && epoll_ctl(epoll_fd, EPOLL_CTL_MOD, n, &ev) == 0) return;
+  // new fd, or the fd was closed and reopened without calling Fl::remove_fd()
+  if (!f.state) epoll_nfds++;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, n, &ev) == 0) {
+    f.state = 1;
+  } else if (errno == EPERM) {
+    f.state = 2;
+    epoll_nfiles++;
+  } else {
+    f.state = 1;
+  }
+}
+
+static void epoll_remove_fd(int n, int events) {
+  if (n < 0 || n >= epoll_fds_size || !epoll_fds[n].handlers) return;
+  for (Epoll_Handler** p = &epoll_fds[n].handlers; *p;) {
+    Epoll_Handler* h = *p;
+    h->events &= ~events;
+    if (!(h->events & ~FL_EDGE)) { // if no events left, delete this handler
+      *p = h->next;
+      delete h;
+    } else {
+      p = &(h->next);
+    }
+  }
+  epoll_update(n);
+}
+
+static void epoll_add_fd(int n, int events, void (*cb)(int, void*), void *v) {
+  if (n < 0) return;
+  epoll_remove_fd(n, events & ~FL_EDGE);
+  if (n >= epoll_fds_size) {
+    int size = 2 * epoll_fds_size + 16;
+    if (size <= n) size = n + 16;
+    Epoll_FD* temp = (Epoll_FD*)realloc(epoll_fds, size * sizeof(Epoll_FD));
+    if (!temp) return;
+    memset(temp + epoll_fds_size, 0, (size - epoll_fds_size) * sizeof(Epoll_FD));
+    epoll_fds = temp;
+    epoll_fds_size = size;
+  }
+  Epoll_Handler* h = new Epoll_Handler;
+  h->events = events;
+  h->cb = cb;
+  h->arg = v;
+  h->next = epoll_fds[n].handlers;
+  epoll_fds[n].handlers = h;
+  epoll_update(n);
+}
+
+// calls the handlers of fd n that match the events reported by epoll
+static void epoll_dispatch(int n, unsigned revents) {
+  int events = 0;
+  if (revents & (EPOLLIN | EPOLLHUP)) events |= FL_READ;
+  if (revents & EPOLLOUT) events |= FL_WRITE;
+  if (revents & (EPOLLPRI | EPOLLERR)) events |= FL_EXCEPT;
+  // A callback may remove or add handlers, so look up the next one again
+  // after each call. There is at most one handler per event type.
+  struct { void (*cb)(int, void*); void* arg; } called[3];
+  int ncalled = 0;
+  while (ncalled < 3 && n < epoll_fds_size) {
+    Epoll_Handler* h;
+    for (h = epoll_fds[n].handlers; h; h = h->next) {
+      if (!(h->events & events) && !(revents & (EPOLLERR | EPOLLHUP))) continue;
+      int i;
+      for (i = 0; i < ncalled; i++)
+        if (called[i].cb == h->cb && called[i].arg == h->arg) break;
+      if (i == ncalled) break;
+    }
+    if (!h) return;
+    called[ncalled].cb = h->cb;
+    called[ncalled].arg = h->arg;
+    ncalled++;
+    h->cb(n, h->arg);
+  }
+}
+
+#  endif // USE_EPOLL
+
 void Fl_X11_System_Driver::add_fd(int n, int events, void (*cb)(int, void*), void *v) {
+#  if USE_EPOLL
+  if (use_epoll()) {
+    epoll_add_fd(n, events, cb, v);
+    return;
+  }
+#  endif
+  events &= ~FL_EDGE;
   remove_fd(n,events);
   int i = nfds++;
   if (i >= fd_array_size) {
@@ -157,6 +309,12 @@ void Fl_X11_System_Driver::add_fd(int n, void (*cb)(int, void*), void* v) {
 }
 
 void Fl_X11_System_Driver::remove_fd(int n, int events) {
+#  if USE_EPOLL
+  if (epoll_fd >= 0) {
+    epoll_remove_fd(n, events);
+    return;
+  }
+#  endif
   int i,j;
 # if !USE_POLL
   maxfd = -1; // recalculate maxfd on the fly
@@ -228,6 +386,28 @@ static void nothing() {}
 void (*fl_lock_function)() = nothing;
 void (*fl_unlock_function)() = nothing;
 
+#  if USE_EPOLL
+// the epoll version of poll_or_select_with_delay()
+static int epoll_wait_and_dispatch(double time_to_wait) {
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  if (epoll_nfiles) time_to_wait = 0.0;
+  fl_unlock_function();
+  int n = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS,
+                     time_to_wait < 2147483.648 ? int(time_to_wait*1000 + .5) : -1);
+  fl_lock_function();
+  for (int i = 0; i < n; i++)
+    epoll_dispatch(events[i].data.fd, events[i].events);
+  if (epoll_nfiles && n >= 0) {
+    for (int f = 0; f < epoll_fds_size; f++) {
+      if (epoll_fds[f].state != 2) continue;
+      epoll_dispatch(f, EPOLLIN | EPOLLOUT);
+      n++;
+    }
+  }
+  return n;
+}
+#  endif // USE_EPOLL
+
 // This is never called with time_to_wait < 0.0:
 // It should return negative on error, 0 if nothing happens before
 // timeout, and >0 if any callbacks were done.
@@ -246,6 +426,10 @@ int Fl_X11_Screen_Driver::poll_or_select_with_delay(double time_to_wait) {
 #  endif
   int n;
 
+#  if USE_EPOLL
+  if (epoll_fd >= 0) return epoll_wait_and_dispatch(time_to_wait);
+#  endif
+
   fl_unlock_function();
 
   if (time_to_wait < 2147483.648) {
@@ -287,6 +471,18 @@ int Fl_X11_Screen_Driver::poll_or_select_with_delay(double time_to_wait) {
 // just like Fl_X11_Screen_Driver::poll_or_select_with_delay(0.0) except no callbacks are done:
 int Fl_X11_Screen_Driver::poll_or_select() {
   if (XQLength(fl_display)) return 1;
+#  if USE_EPOLL
+  if (epoll_fd >= 0) {
+    if (!epoll_nfds) return 0;
+    if (epoll_nfiles) return 1;
+    // the epoll fd is readable if any events are pending, polling it does
+    // not consume edge-triggered events
+    pollfd p;
+    p.fd = epoll_fd;
+    p.events = POLLIN;
+    return ::poll(&p, 1, 0);
+  }
+#  endif
   if (!nfds) return 0; // nothing to select or poll
 #  if USE_POLL
   return ::poll(pollfds, nfds, 0);
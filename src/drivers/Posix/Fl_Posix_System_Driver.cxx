@@ -31,6 +31,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <pwd.h>
 #include <unistd.h>
 #include <time.h>
@@ -121,6 +122,30 @@ const char *Fl_Posix_System_Driver::getpwnam(const char *login) {
 }
 
 
+/*
+ Map a file read-only and copy-on-write. Pages are read from the file when
+ they are first accessed. Fails for empty files and for files that are too
+ large to be indexed by an int.
+ */
+void *Fl_Posix_System_Driver::map_file(const char *f, size_t *size) {
+  int fd = ::open(f, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  void *addr = NULL;
+  if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size < 0x7fffffff) {
+    addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) addr = NULL;
+    else *size = (size_t)st.st_size;
+  }
+  ::close(fd);
+  return addr;
+}
+
+void Fl_Posix_System_Driver::unmap_file(void *addr, size_t size) {
+  munmap(addr, size);
+}
+
+
 void Fl_Posix_System_Driver::gettime(time_t *sec, int *usec) {
   struct timeval tv;
   gettimeofday(&tv, NULL);
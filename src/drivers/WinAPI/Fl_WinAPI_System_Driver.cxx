@@ -196,10 +196,18 @@ char *Fl_WinAPI_System_Driver::getenv(const char *var) {
   return wchar_to_utf8(ret, buf);
 }
 
+// open(), fopen(), access() and stat() may be called by image loaders in
+// the worker threads of Fl_Shared_Image::get_async(), so they convert the
+// file name into a buffer of their own instead of the shared static ones.
+
 int Fl_WinAPI_System_Driver::open(const char *fnam, int oflags, int pmode) {
-  utf8_to_wchar(fnam, wbuf);
-  if (pmode == -1) return _wopen(wbuf, oflags);
-  else return _wopen(wbuf, oflags, pmode);
+  wchar_t *wname = NULL;
+  utf8_to_wchar(fnam, wname);
+  int fd;
+  if (pmode == -1) fd = _wopen(wname, oflags);
+  else fd = _wopen(wname, oflags, pmode);
+  free(wname);
+  return fd;
 }
 
 int Fl_WinAPI_System_Driver::open_ext(const char *fnam, int binary, int oflags, int pmode) {
@@ -209,9 +217,13 @@ int Fl_WinAPI_System_Driver::open_ext(const char *fnam, int binary, int oflags,
 }
 
 FILE *Fl_WinAPI_System_Driver::fopen(const char *fnam, const char *mode) {
-  utf8_to_wchar(fnam, wbuf);
-  utf8_to_wchar(mode, wbuf1);
-  return _wfopen(wbuf, wbuf1);
+  wchar_t *wname = NULL, *wmode = NULL;
+  utf8_to_wchar(fnam, wname);
+  utf8_to_wchar(mode, wmode);
+  FILE *fp = _wfopen(wname, wmode);
+  free(wname);
+  free(wmode);
+  return fp;
 }
 
 int Fl_WinAPI_System_Driver::system(const char *cmd) {
@@ -259,7 +271,10 @@ int Fl_WinAPI_System_Driver::chmod(const char *fnam, int mode) {
 }
 
 int Fl_WinAPI_System_Driver::access(const char *fnam, int mode) {
-  return _waccess(utf8_to_wchar(fnam, wbuf), mode);
+  wchar_t *wname = NULL;
+  int ret = _waccess(utf8_to_wchar(fnam, wname), mode);
+  free(wname);
+  return ret;
 }
 
 int Fl_WinAPI_System_Driver::stat(const char *fnam, struct stat *b) {
@@ -269,7 +284,10 @@ int Fl_WinAPI_System_Driver::stat(const char *fnam, struct stat *b) {
   if (len > 0 && (fnam[len-1] == '/' || fnam[len-1] == '\\'))
     len--;
   // convert filename and execute _wstat()
-  return _wstat(utf8_to_wchar(fnam, wbuf, len), (struct _stat *)b);
+  wchar_t *wname = NULL;
+  int ret = _wstat(utf8_to_wchar(fnam, wname, len), (struct _stat *)b);
+  free(wname);
+  return ret;
 }
 
 char *Fl_WinAPI_System_Driver::getcwd(char *buf, int len) {
@@ -308,6 +326,29 @@ int Fl_WinAPI_System_Driver::rename(const char *fnam, const char *newnam) {
   return _wrename(wbuf, wbuf1);
 }
 
+void *Fl_WinAPI_System_Driver::map_file(const char *fnam, size_t *size) {
+  HANDLE file = CreateFileW(utf8_to_wchar(fnam, wbuf), GENERIC_READ, FILE_SHARE_READ,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return NULL;
+  void *addr = NULL;
+  LARGE_INTEGER fsize;
+  if (GetFileSizeEx(file, &fsize) && fsize.QuadPart > 0 && fsize.QuadPart < 0x7fffffff) {
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      // the view keeps the mapping alive
+      CloseHandle(mapping);
+      if (addr) *size = (size_t)fsize.QuadPart;
+    }
+  }
+  CloseHandle(file);
+  return addr;
+}
+
+void Fl_WinAPI_System_Driver::unmap_file(void *addr, size_t size) {
+  UnmapViewOfFile(addr);
+}
+
 // Two Windows-specific functions fl_utf8_to_locale() and fl_locale_to_utf8()
 // from file fl_utf8.cxx are put here for API compatibility
 
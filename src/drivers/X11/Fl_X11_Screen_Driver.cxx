@@ -31,6 +31,8 @@
 #include <FL/Fl_Tooltip.H>
 #include <FL/filename.H>
 #include <sys/time.h>
+#include <time.h>
+#include <stdlib.h>
 
 #if HAVE_XINERAMA
 #  include <X11/extensions/Xinerama.h>
@@ -66,38 +68,140 @@ extern const char *fl_bg2;
 
 
 ////////////////////////////////////////////////////////////////////////
-// Timeouts are stored in a sorted list (*first_timeout), so only the
-// first one needs to be checked to see if any should be called.
-// Allocated, but unused (free) Timeout structs are stored in another
-// linked list (*free_timeout).
+// Timeouts are stored with their absolute deadline on the monotonic clock
+// in a binary heap (timeout_heap), so only the first one needs to be checked
+// to see if any should be called, and adding or removing one is O(log n).
+// Timeouts with equal deadlines are called in the order they were added.
+// A hash table on (cb, arg) finds the timeouts for has_timeout() and
+// remove_timeout(). Allocated, but unused (free) Timeout structs are stored
+// in a linked list (*free_timeout).
 
 struct Timeout {
-  double time;
+  double time;                  // deadline, see timeout_clock()
+  unsigned long seq;            // order of addition, for equal deadlines
   void (*cb)(void*);
   void* arg;
-  Timeout* next;
+  int index;                    // position in timeout_heap
+  Timeout* next;                // next in hash bucket or free list
 };
-static Timeout* first_timeout, *free_timeout;
+static Timeout** timeout_heap;
+static int timeout_count, timeout_alloc;
+static Timeout** timeout_hash;
+static unsigned timeout_hash_size;
+static Timeout* free_timeout;
+static unsigned long timeout_seq;
+
+// The time at which timeouts were last checked. Deadlines are compared with
+// this and not with the current time, so a callback that repeats itself is
+// scheduled relative to when it should have been called.
+static double timeout_now;
+
+static double timeout_clock() {
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+#endif
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec/1000000.0;
+}
 
 // I avoid the overhead of getting the current time when we have no
-// timeouts by setting this flag instead of getting the time.
-// In this case calling elapse_timeouts() does nothing, but records
-// the current time, and the next call will actually elapse time.
+// timeouts by setting this flag instead of getting the time. The next
+// timeout added then gets the time first.
 static char reset_clock = 1;
 
 static void elapse_timeouts() {
-  static struct timeval prevclock;
-  struct timeval newclock;
-  gettimeofday(&newclock, NULL);
-  double elapsed = newclock.tv_sec - prevclock.tv_sec +
-    (newclock.tv_usec - prevclock.tv_usec)/1000000.0;
-  prevclock.tv_sec = newclock.tv_sec;
-  prevclock.tv_usec = newclock.tv_usec;
-  if (reset_clock) {
-    reset_clock = 0;
-  } else if (elapsed > 0) {
-    for (Timeout* t = first_timeout; t; t = t->next) t->time -= elapsed;
+  timeout_now = timeout_clock();
+  reset_clock = 0;
+}
+
+// time until the first timeout is due, as of the last elapse_timeouts()
+static double first_timeout_delay() {
+  return timeout_heap[0]->time - timeout_now;
+}
+
+static inline int timeout_before(const Timeout* a, const Timeout* b) {
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void timeout_heap_set(int i, Timeout* t) {
+  timeout_heap[i] = t;
+  t->index = i;
+}
+
+static void timeout_sift_up(int i) {
+  Timeout* t = timeout_heap[i];
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!timeout_before(t, timeout_heap[parent])) break;
+    timeout_heap_set(i, timeout_heap[parent]);
+    i = parent;
+  }
+  timeout_heap_set(i, t);
+}
+
+static void timeout_sift_down(int i) {
+  Timeout* t = timeout_heap[i];
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= timeout_count) break;
+    if (child + 1 < timeout_count && timeout_before(timeout_heap[child + 1], timeout_heap[child]))
+      child++;
+    if (!timeout_before(timeout_heap[child], t)) break;
+    timeout_heap_set(i, timeout_heap[child]);
+    i = child;
   }
+  timeout_heap_set(i, t);
+}
+
+static void timeout_heap_remove(Timeout* t) {
+  int i = t->index;
+  Timeout* last = timeout_heap[--timeout_count];
+  if (last == t) return;
+  timeout_heap_set(i, last);
+  if (i > 0 && timeout_before(last, timeout_heap[(i - 1) / 2]))
+    timeout_sift_up(i);
+  else
+    timeout_sift_down(i);
+}
+
+static inline unsigned timeout_hash_of(void (*cb)(void*), void* arg) {
+  unsigned long h = (unsigned long)(fl_intptr_t)cb * 31 + (unsigned long)(fl_intptr_t)arg;
+  h ^= h >> 16;
+  return (unsigned)(h * 2654435761UL) & (timeout_hash_size - 1);
+}
+
+static void timeout_hash_resize(unsigned size) {
+  Timeout** old = timeout_hash;
+  unsigned old_size = timeout_hash_size;
+  timeout_hash = (Timeout**)calloc(size, sizeof(Timeout*));
+  timeout_hash_size = size;
+  for (unsigned b = 0; b < old_size; b++) {
+    while (old[b]) {
+      Timeout* t = old[b];
+      old[b] = t->next;
+      Timeout** head = timeout_hash + timeout_hash_of(t->cb, t->arg);
+      t->next = *head;
+      *head = t;
+    }
+  }
+  free(old);
+}
+
+static void timeout_unhash(Timeout* t) {
+  Timeout** p = timeout_hash + timeout_hash_of(t->cb, t->arg);
+  while (*p != t) p = &((*p)->next);
+  *p = t->next;
+}
+
+// removes a timeout from the heap and the hash table and frees it
+static void timeout_release(Timeout* t) {
+  timeout_heap_remove(t);
+  timeout_unhash(t);
+  t->next = free_timeout;
+  free_timeout = t;
 }
 
 
@@ -439,19 +543,17 @@ double Fl_X11_Screen_Driver::wait(double time_to_wait)
 {
   static char in_idle;
 
-  if (first_timeout) {
+  if (timeout_count) {
     elapse_timeouts();
-    Timeout *t;
-    while ((t = first_timeout)) {
-      if (t->time > 0) break;
-      // The first timeout in the array has expired.
-      missed_timeout_by = t->time;
-      // We must remove timeout from array before doing the callback:
+    while (timeout_count) {
+      Timeout *t = timeout_heap[0];
+      if (t->time > timeout_now) break;
+      // The first timeout in the heap has expired.
+      missed_timeout_by = t->time - timeout_now;
+      // We must remove timeout from the heap before doing the callback:
       void (*cb)(void*) = t->cb;
       void *argp = t->arg;
-      first_timeout = t->next;
-      t->next = free_timeout;
-      free_timeout = t;
+      timeout_release(t);
       // Now it is safe for the callback to do add_timeout:
       cb(argp);
     }
@@ -468,8 +570,8 @@ double Fl_X11_Screen_Driver::wait(double time_to_wait)
     // the idle function may turn off idle, we can then wait:
     if (Fl::idle) time_to_wait = 0.0;
   }
-  if (first_timeout && first_timeout->time < time_to_wait)
-    time_to_wait = first_timeout->time;
+  if (timeout_count && first_timeout_delay() < time_to_wait)
+    time_to_wait = first_timeout_delay();
   if (time_to_wait <= 0.0) {
     // do flush second so that the results of events are visible:
     int ret = this->poll_or_select_with_delay(0.0);
@@ -480,9 +582,9 @@ double Fl_X11_Screen_Driver::wait(double time_to_wait)
     Fl::flush();
     if (Fl::idle && !in_idle) // 'idle' may have been set within flush()
       time_to_wait = 0.0;
-    else if (first_timeout && first_timeout->time < time_to_wait) {
+    else if (timeout_count && first_timeout_delay() < time_to_wait) {
       // another timeout may have been queued within flush(), see STR #3188
-      time_to_wait = first_timeout->time >= 0.0 ? first_timeout->time : 0.0;
+      time_to_wait = first_timeout_delay() >= 0.0 ? first_timeout_delay() : 0.0;
     }
     return this->poll_or_select_with_delay(time_to_wait);
   }
@@ -491,9 +593,9 @@ double Fl_X11_Screen_Driver::wait(double time_to_wait)
 
 int Fl_X11_Screen_Driver::ready()
 {
-  if (first_timeout) {
+  if (timeout_count) {
     elapse_timeouts();
-    if (first_timeout->time <= 0) return 1;
+    if (first_timeout_delay() <= 0) return 1;
   } else {
     reset_clock = 1;
   }
@@ -641,27 +743,36 @@ void Fl_X11_Screen_Driver::add_timeout(double time, Fl_Timeout_Handler cb, void
 
 void Fl_X11_Screen_Driver::repeat_timeout(double time, Fl_Timeout_Handler cb, void *argp) {
   time += missed_timeout_by; if (time < -.05) time = 0;
+  if (reset_clock) elapse_timeouts();
   Timeout* t = free_timeout;
   if (t) {
       free_timeout = t->next;
   } else {
       t = new Timeout;
   }
-  t->time = time;
+  t->time = timeout_now + time;
+  t->seq = timeout_seq++;
   t->cb = cb;
   t->arg = argp;
-  // insert-sort the new timeout:
-  Timeout** p = &first_timeout;
-  while (*p && (*p)->time <= time) p = &((*p)->next);
-  t->next = *p;
-  *p = t;
+  if (timeout_count >= timeout_alloc) {
+    timeout_alloc = timeout_alloc ? 2 * timeout_alloc : 64;
+    timeout_heap = (Timeout**)realloc(timeout_heap, timeout_alloc * sizeof(Timeout*));
+  }
+  timeout_heap_set(timeout_count++, t);
+  timeout_sift_up(t->index);
+  if ((unsigned)timeout_count > timeout_hash_size)
+    timeout_hash_resize(timeout_hash_size ? 2 * timeout_hash_size : 64);
+  Timeout** head = timeout_hash + timeout_hash_of(cb, argp);
+  t->next = *head;
+  *head = t;
 }
 
 /**
   Returns true if the timeout exists and has not been called yet.
 */
 int Fl_X11_Screen_Driver::has_timeout(Fl_Timeout_Handler cb, void *argp) {
-  for (Timeout* t = first_timeout; t; t = t->next)
+  if (!timeout_count) return 0;
+  for (Timeout* t = timeout_hash[timeout_hash_of(cb, argp)]; t; t = t->next)
     if (t->cb == cb && t->arg == argp) return 1;
   return 0;
 }
@@ -674,16 +785,30 @@ int Fl_X11_Screen_Driver::has_timeout(Fl_Timeout_Handler cb, void *argp) {
 	This may change in the future.
 */
 void Fl_X11_Screen_Driver::remove_timeout(Fl_Timeout_Handler cb, void *argp) {
-  for (Timeout** p = &first_timeout; *p;) {
-    Timeout* t = *p;
-    if (t->cb == cb && (t->arg == argp || !argp)) {
-      *p = t->next;
+  if (!timeout_count) return;
+  if (argp) {
+    Timeout* t = timeout_hash[timeout_hash_of(cb, argp)];
+    while (t) {
+      Timeout* next = t->next;
+      if (t->cb == cb && t->arg == argp) timeout_release(t);
+      t = next;
+    }
+    return;
+  }
+  // a NULL argument matches all timeouts of cb, look at every one of them
+  int n = 0;
+  for (int i = 0; i < timeout_count; i++) {
+    Timeout* t = timeout_heap[i];
+    if (t->cb == cb) {
+      timeout_unhash(t);
       t->next = free_timeout;
       free_timeout = t;
     } else {
-      p = &(t->next);
+      timeout_heap_set(n++, t);
     }
   }
+  timeout_count = n;
+  for (int i = n / 2 - 1; i >= 0; i--) timeout_sift_down(i);
 }
 
 int Fl_X11_Screen_Driver::compose(int& del) {
@@ -59,6 +59,11 @@
 #if HAVE_XRENDER
 #include <X11/extensions/Xrender.h>
 #endif
+#if HAVE_XSHM
+#  include <X11/extensions/XShm.h>
+#  include <sys/ipc.h>
+#  include <sys/shm.h>
+#endif
 
 static XImage xi;	// template used to pass info to X
 static int bytes_per_pixel;
@@ -358,6 +363,179 @@ mono32_converter(const uchar *from,uchar *to,int w, int delta) {
     (*from << fl_redshift)+(*from << fl_greenshift)+(*from << fl_blueshift));
 }
 
+////////////////////////////////////////////////////////////////
+// SIMD versions of the common 32 bit converters, for pixels of 3 or 4
+// bytes (delta 3 or 4) on little endian machines. They convert as many
+// pixels as they can at once and leave the rest of the row, and any other
+// delta, to the converters above. figure_out_visual() picks them at run
+// time: x86 uses SSSE3 byte shuffles if the CPU has them and SSE2 for the
+// premultiplied converter, ARM uses NEON.
+
+#if !WORDS_BIGENDIAN && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#  include <emmintrin.h>
+#  include <tmmintrin.h>
+#  define FL_X11_SSE 1
+#elif !WORDS_BIGENDIAN && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#  include <arm_neon.h>
+#  define FL_X11_NEON 1
+#endif
+
+#if defined(FL_X11_SSE) || defined(FL_X11_NEON)
+
+// Source byte (0-2 for r, g, b) of each byte of an output pixel, -1 for 0
+static const signed char xbgr_order[4] = { 0, 1, 2, -1 };
+static const signed char xrgb_order[4] = { 2, 1, 0, -1 };
+static const signed char rgbx_order[4] = { -1, 2, 1, 0 };
+static const signed char bgrx_order[4] = { -1, 0, 1, 2 };
+
+#  if defined(FL_X11_SSE)
+
+// Converts pixels with one pshufb per 4 pixels, returns how many it did
+__attribute__((target("ssse3")))
+static int shuffle32_ssse3(const uchar *from, uchar *to, int w, int delta,
+                           const signed char *order) {
+  char m[16];
+  for (int i = 0; i < 16; i++) {
+    int k = order[i & 3];
+    m[i] = (char)(k < 0 ? 0x80 : (i >> 2) * delta + k);
+  }
+  const __m128i mask = _mm_loadu_si128((const __m128i *)m);
+  // 16 bytes are loaded for 4 pixels, which must not go past the row
+  int stop = w - (delta == 3 ? 6 : 4);
+  int i = 0;
+  for (; i <= stop; i += 4, from += 4 * delta, to += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)from);
+    _mm_storeu_si128((__m128i *)to, _mm_shuffle_epi8(v, mask));
+  }
+  return i;
+}
+
+// Premultiplies 4 RGBA pixels at a time into ARGB, returns how many it did
+static int argb_premul_sse2(const uchar *from, uchar *to, int w) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i c257 = _mm_set1_epi16(257);
+  // keeps the alpha of each pixel: it is multiplied by 255 / 255
+  const __m128i alpha_lane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+  const __m128i c255 = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+  int i = 0;
+  for (; i + 4 <= w; i += 4, from += 16, to += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)from);
+    __m128i p[2];
+    for (int k = 0; k < 2; k++) {
+      __m128i x = k ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+      __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xff), 0xff);
+      a = _mm_or_si128(_mm_andnot_si128(alpha_lane, a), c255);
+      x = _mm_mullo_epi16(x, a);
+      // x / 255, truncated like the scalar converter
+      x = _mm_mulhi_epu16(_mm_add_epi16(x, one), c257);
+      // r g b a -> b g r a
+      p[k] = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xc6), 0xc6);
+    }
+    _mm_storeu_si128((__m128i *)to, _mm_packus_epi16(p[0], p[1]));
+  }
+  return i;
+}
+
+static int have_ssse3() {
+  static int ssse3 = -1;
+  if (ssse3 < 0) {
+    __builtin_cpu_init();
+    ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+  }
+  return ssse3;
+}
+
+#    define SHUFFLE32(from, to, w, delta, order) \
+  (have_ssse3() ? shuffle32_ssse3(from, to, w, delta, order) : 0)
+#    define ARGB_PREMUL(from, to, w) argb_premul_sse2(from, to, w)
+
+#  else // FL_X11_NEON
+
+static int shuffle32_neon(const uchar *from, uchar *to, int w, int delta,
+                          const signed char *order) {
+  const uint8x16_t zero = vdupq_n_u8(0);
+  int i = 0;
+  for (; i + 16 <= w; i += 16, from += 16 * delta, to += 64) {
+    uint8x16_t c[3];
+    if (delta == 3) {
+      uint8x16x3_t v = vld3q_u8(from);
+      c[0] = v.val[0]; c[1] = v.val[1]; c[2] = v.val[2];
+    } else {
+      uint8x16x4_t v = vld4q_u8(from);
+      c[0] = v.val[0]; c[1] = v.val[1]; c[2] = v.val[2];
+    }
+    uint8x16x4_t out;
+    for (int k = 0; k < 4; k++) out.val[k] = order[k] < 0 ? zero : c[order[k]];
+    vst4q_u8(to, out);
+  }
+  return i;
+}
+
+// x / 255 for x <= 65025, truncated like the scalar converter
+static inline uint8x8_t div255_neon(uint16x8_t x) {
+  x = vaddq_u16(x, vdupq_n_u16(1));
+  return vshrn_n_u16(vsraq_n_u16(x, x, 8), 8);
+}
+
+static int argb_premul_neon(const uchar *from, uchar *to, int w) {
+  int i = 0;
+  for (; i + 8 <= w; i += 8, from += 32, to += 32) {
+    uint8x8x4_t v = vld4_u8(from);
+    uint8x8x4_t out;
+    out.val[0] = div255_neon(vmull_u8(v.val[2], v.val[3]));
+    out.val[1] = div255_neon(vmull_u8(v.val[1], v.val[3]));
+    out.val[2] = div255_neon(vmull_u8(v.val[0], v.val[3]));
+    out.val[3] = v.val[3];
+    vst4_u8(to, out);
+  }
+  return i;
+}
+
+#    define SHUFFLE32(from, to, w, delta, order) \
+  shuffle32_neon(from, to, w, delta, order)
+#    define ARGB_PREMUL(from, to, w) argb_premul_neon(from, to, w)
+
+#  endif // FL_X11_SSE
+
+#  define SIMD_CONVERTER32(name, order) \
+static void name##_simd(const uchar *from, uchar *to, int w, int delta) { \
+  int n = (delta == 3 || delta == 4) ? SHUFFLE32(from, to, w, delta, order) : 0; \
+  name(from + n * delta, to + 4 * n, w - n, delta); \
+}
+
+SIMD_CONVERTER32(xbgr_converter, xbgr_order)
+SIMD_CONVERTER32(xrgb_converter, xrgb_order)
+SIMD_CONVERTER32(rgbx_converter, rgbx_order)
+SIMD_CONVERTER32(bgrx_converter, bgrx_order)
+
+static void argb_premul_converter_simd(const uchar *from, uchar *to, int w, int delta) {
+  int n = (delta == 4) ? ARGB_PREMUL(from, to, w) : 0;
+  argb_premul_converter(from + n * delta, to + 4 * n, w - n, delta);
+}
+
+#endif // FL_X11_SSE || FL_X11_NEON
+
+// the converter used for images with alpha, see innards()
+static void (*premul_converter)(const uchar *from, uchar *to, int w, int delta) =
+  argb_premul_converter;
+
+// Replaces the converters chosen by figure_out_visual() with faster
+// versions that the CPU supports
+static void select_simd_converters() {
+#if defined(FL_X11_SSE) || defined(FL_X11_NEON)
+  premul_converter = argb_premul_converter_simd;
+#  if defined(FL_X11_SSE)
+  if (!have_ssse3()) return;
+#  endif
+  if (converter == xbgr_converter) converter = xbgr_converter_simd;
+  else if (converter == xrgb_converter) converter = xrgb_converter_simd;
+  else if (converter == rgbx_converter) converter = rgbx_converter_simd;
+  else if (converter == bgrx_converter) converter = bgrx_converter_simd;
+#endif
+}
+
 ////////////////////////////////////////////////////////////////
 
 static void figure_out_visual() {
@@ -463,10 +641,117 @@ static void figure_out_visual() {
     Fl::fatal("Can't do %d bits_per_pixel",xi.bits_per_pixel);
   }
 
+  select_simd_converters();
 }
 
 #  define MAXBUFFER 0x40000 // 256k
 
+#if HAVE_XSHM
+
+// Images of at least SHM_MIN_SIZE bytes are converted into a shared memory
+// segment and sent with XShmPutImage(), so that the X server reads the
+// pixels directly instead of through the connection. The segments are
+// used in turn, so that one image can be converted while the server is
+// still reading the previous one.
+
+#  define SHM_MIN_SIZE 0x10000 // 64k
+#  define SHM_SEGMENTS 2
+
+struct Shm_Segment {
+  XShmSegmentInfo info;
+  size_t size;                  // size of the segment, 0 if none
+  unsigned long request;        // serial number of the last XShmPutImage
+};
+
+static Shm_Segment shm_segments[SHM_SEGMENTS];
+static int shm_next;            // segment to use next
+static int shm_state;           // 0 = not checked yet, 1 = usable, -1 = not usable
+static int shm_failed;          // set by shm_error_handler()
+static int shm_opcode;          // major opcode of the MIT-SHM extension
+static XErrorHandler shm_old_handler;
+
+// Errors of MIT-SHM requests while a segment is attached mean that it
+// can't be attached, all other errors go to the previous handler
+static int shm_error_handler(Display *d, XErrorEvent *e) {
+  if (e->request_code == shm_opcode) {
+    shm_failed = 1;
+    return 0;
+  }
+  return shm_old_handler ? shm_old_handler(d, e) : 0;
+}
+
+static void shm_free(Shm_Segment &seg) {
+  if (!seg.size) return;
+  XShmDetach(fl_display, &seg.info);
+  shmdt(seg.info.shmaddr);
+  seg.size = 0;
+}
+
+// Creates a segment and attaches it to the X server. The server fails to
+// attach it if it runs on another machine, which switches shared memory
+// off for good.
+static int shm_alloc(Shm_Segment &seg, size_t size) {
+  seg.info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (seg.info.shmid < 0) return 0;
+  seg.info.shmaddr = (char *)shmat(seg.info.shmid, 0, 0);
+  if (seg.info.shmaddr == (char *)-1) {
+    shmctl(seg.info.shmid, IPC_RMID, 0);
+    return 0;
+  }
+  seg.info.readOnly = True;
+  // errors of earlier requests go to the handler of the program
+  XSync(fl_display, False);
+  shm_failed = 0;
+  shm_old_handler = XSetErrorHandler(shm_error_handler);
+  Status ok = XShmAttach(fl_display, &seg.info);
+  XSync(fl_display, False);
+  XSetErrorHandler(shm_old_handler);
+  // the segment goes away when both sides have detached it
+  shmctl(seg.info.shmid, IPC_RMID, 0);
+  if (!ok || shm_failed) {
+    shmdt(seg.info.shmaddr);
+    shm_state = -1;
+    return 0;
+  }
+  seg.size = size;
+  seg.request = 0;
+  return 1;
+}
+
+// Returns a segment of at least size bytes that the X server no longer
+// reads from, or NULL if shared memory can't be used.
+static Shm_Segment *shm_get(size_t size) {
+  if (shm_state == 0) {
+    int major, minor, event, error;
+    Bool pixmaps;
+    shm_state = XQueryExtension(fl_display, SHMNAME, &shm_opcode, &event, &error) &&
+                XShmQueryVersion(fl_display, &major, &minor, &pixmaps) ? 1 : -1;
+  }
+  if (shm_state < 0) return 0;
+  Shm_Segment &seg = shm_segments[shm_next];
+  if (seg.size && seg.request > LastKnownRequestProcessed(fl_display))
+    XSync(fl_display, False); // the server may still read the segment
+  if (seg.size < size) {
+    shm_free(seg);
+    // round up to limit reallocations while a window is resized
+    size = (size + 0xfffff) & ~(size_t)0xfffff;
+    if (!shm_alloc(seg, size)) return 0;
+  }
+  shm_next = (shm_next + 1) % SHM_SEGMENTS;
+  return &seg;
+}
+
+// Sends the image in the segment, which starts at seg->info.shmaddr
+static void shm_put(Shm_Segment *seg, GC gc, int X, int Y, int w, int h) {
+  xi.data = seg->info.shmaddr;
+  xi.obdata = (char *)&seg->info;
+  XShmPutImage(fl_display, fl_window, gc, &xi, 0, 0, X, Y, w, h, False);
+  seg->request = NextRequest(fl_display) - 1;
+  xi.obdata = 0;
+}
+
+#endif // HAVE_XSHM
+
 static void innards(const uchar *buf, int X, int Y, int W, int H,
 		    int delta, int linedelta, int mono,
 		    Fl_Draw_Image_Cb cb, void* userdata,
@@ -490,7 +775,7 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
   if (alpha) {
     // This flag states the destination format is ARGB32 (big-endian), pre-multiplied.
     bytes_per_pixel = 4;
-    conv = (mono ? depth2_to_argb_premul_converter : argb_premul_converter);
+    conv = (mono ? depth2_to_argb_premul_converter : premul_converter);
     xi.depth = 32;
     xi.bits_per_pixel = 32;
 
@@ -502,6 +787,34 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
     }
   }
 
+#if HAVE_XSHM
+  // Convert large images straight into shared memory...
+  int shm_linesize = (w*bytes_per_pixel+scanline_add)&scanline_mask;
+  Shm_Segment *seg = 0;
+  if ((size_t)shm_linesize * h >= SHM_MIN_SIZE &&
+      (seg = shm_get((size_t)shm_linesize * h)) != 0) {
+    xi.bytes_per_line = shm_linesize;
+    uchar *to = (uchar *)seg->info.shmaddr;
+    if (buf) {
+      buf += delta*dx+linedelta*dy;
+      for (int j=0; j<h; j++) {
+        conv(buf, to, w, delta);
+        buf += linedelta;
+        to += shm_linesize;
+      }
+    } else {
+      STORETYPE* linebuf = new STORETYPE[(W*delta+(sizeof(STORETYPE)-1))/sizeof(STORETYPE)];
+      for (int j=0; j<h; j++) {
+        cb(userdata, dx, dy+j, w, (uchar*)linebuf);
+        conv((uchar*)linebuf, to, w, delta);
+        to += shm_linesize;
+      }
+      delete[] linebuf;
+    }
+    shm_put(seg, gc, X+dx, Y+dy, w, h);
+  } else
+#endif // HAVE_XSHM
+
   // See if the data is already in the right format.  Unfortunately
   // some 32-bit x servers (XFree86) care about the unknown 8 bits
   // and they must be zero.  I can't confirm this for user-supplied
@@ -749,6 +1062,111 @@ void Fl_Xlib_Graphics_Driver::draw_fixed(Fl_RGB_Image *img, int X, int Y, int W,
 
 #if HAVE_XRENDER
 
+/*
+ Pixmaps of RGB images rescaled to the size at which they are drawn.
+
+ Without this cache, Xrender rescales the full size pixmap of an image each
+ time it is drawn with a screen scaling factor or at another size. The
+ pixels are now rescaled once with Fl_RGB_Image::copy(), with the method
+ set by Fl_Image::scaling_algorithm(), and kept in a pixmap per image and
+ size. All pixmaps share the memory budget set by
+ Fl_RGB_Image::scaled_cache_size(); the least recently drawn are freed first.
+ Fl_RGB_Image::uncache() frees all pixmaps of the image.
+
+ Entries are hashed by image, so that all sizes of an image are in the same
+ bucket, and are linked in least recently used order.
+ */
+struct Scaled_Pixmap {
+  const Fl_RGB_Image *img;
+  int w, h;
+  Fl_Offscreen pixmap;
+  Scaled_Pixmap *next;                  // next entry in the bucket
+  Scaled_Pixmap *older, *newer;         // LRU list
+};
+
+#define SCALED_BUCKETS 256
+static Scaled_Pixmap *scaled_table[SCALED_BUCKETS];
+static Scaled_Pixmap *scaled_oldest, *scaled_newest;
+static size_t scaled_bytes = 0;
+
+static unsigned scaled_hash(const Fl_RGB_Image *img) {
+  fl_uintptr_t p = (fl_uintptr_t)img;
+  return (unsigned)((p >> 4) ^ (p >> 12)) % SCALED_BUCKETS;
+}
+
+static void scaled_unlink_lru(Scaled_Pixmap *e) {
+  if (e->older) e->older->newer = e->newer;
+  else scaled_oldest = e->newer;
+  if (e->newer) e->newer->older = e->older;
+  else scaled_newest = e->older;
+}
+
+static void scaled_link_lru(Scaled_Pixmap *e) {
+  e->older = scaled_newest;
+  e->newer = 0;
+  if (scaled_newest) scaled_newest->newer = e;
+  else scaled_oldest = e;
+  scaled_newest = e;
+}
+
+static void scaled_delete(Scaled_Pixmap *e) {
+  Scaled_Pixmap **p = &scaled_table[scaled_hash(e->img)];
+  while (*p != e) p = &(*p)->next;
+  *p = e->next;
+  scaled_unlink_lru(e);
+  XFreePixmap(fl_display, e->pixmap);
+  scaled_bytes -= (size_t)e->w * e->h * 4;
+  delete e;
+}
+
+// Frees all rescaled pixmaps of an image
+static void scaled_uncache(const Fl_RGB_Image *img) {
+  if (!scaled_bytes) return;
+  Scaled_Pixmap *e = scaled_table[scaled_hash(img)];
+  while (e) {
+    Scaled_Pixmap *next = e->next;
+    if (e->img == img) scaled_delete(e);
+    e = next;
+  }
+}
+
+/* Returns a pixmap of the image rescaled to W x H pixels, from the cache or
+ made now, or 0 if it does not fit in the memory budget.
+ */
+Fl_Offscreen Fl_Xlib_Graphics_Driver::scaled_pixmap(Fl_RGB_Image *img, int W, int H) {
+  Scaled_Pixmap **bucket = &scaled_table[scaled_hash(img)];
+  for (Scaled_Pixmap *e = *bucket; e; e = e->next) {
+    if (e->img == img && e->w == W && e->h == H) {
+      scaled_unlink_lru(e);
+      scaled_link_lru(e);
+      return e->pixmap;
+    }
+  }
+  size_t bytes = (size_t)W * H * 4;
+  size_t budget = Fl_RGB_Image::scaled_cache_size();
+  if (bytes > budget) return 0;
+  while (scaled_oldest && scaled_bytes + bytes > budget) scaled_delete(scaled_oldest);
+  Fl_RGB_Scaling keep = Fl_Image::RGB_scaling();
+  Fl_Image::RGB_scaling(Fl_Image::scaling_algorithm());
+  Fl_RGB_Image *img2 = (Fl_RGB_Image*)img->copy(W, H);
+  Fl_Image::RGB_scaling(keep);
+  cache(img2);
+  Fl_Offscreen pixmap = (Fl_Offscreen)*Fl_Graphics_Driver::id(img2);
+  *Fl_Graphics_Driver::id(img2) = 0;
+  delete img2;
+  if (!pixmap) return 0;
+  Scaled_Pixmap *e = new Scaled_Pixmap;
+  e->img = img;
+  e->w = W;
+  e->h = H;
+  e->pixmap = pixmap;
+  e->next = *bucket;
+  *bucket = e;
+  scaled_link_lru(e);
+  scaled_bytes += bytes;
+  return pixmap;
+}
+
 void Fl_Xlib_Graphics_Driver::draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP, int HP, int cx, int cy) {
   if (!fl_can_do_alpha_blending()) {
     Fl_Graphics_Driver::draw_rgb(rgb, XP, YP, WP, HP, cx, cy);
@@ -758,12 +1176,20 @@ void Fl_Xlib_Graphics_Driver::draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP
   if (Fl_Graphics_Driver::start_image(rgb, XP, YP, WP, HP, cx, cy, X, Y, W, H)) {
     return;
   }
-  if (!*Fl_Graphics_Driver::id(rgb)) {
-    cache(rgb);
-  }
   cache_size(rgb, W, H);
   int Wfull = rgb->w(), Hfull = rgb->h();
   cache_size(rgb, Wfull, Hfull);
+  if (Wfull != rgb->data_w() || Hfull != rgb->data_h()) {
+    Fl_Offscreen scaled = scaled_pixmap(rgb, Wfull, Hfull);
+    if (scaled) {
+      scale_and_render_pixmap(scaled, rgb->d(), 1, 1, cx*scale(), cy*scale(),
+                              (X + offset_x_)*scale(), (Y + offset_y_)*scale(), W, H);
+      return;
+    }
+  }
+  if (!*Fl_Graphics_Driver::id(rgb)) {
+    cache(rgb);
+  }
   scale_and_render_pixmap( *Fl_Graphics_Driver::id(rgb), rgb->d(),
                                  rgb->data_w() / double(Wfull), rgb->data_h() / double(Hfull),
                           cx*scale(), cy*scale(), (X + offset_x_)*scale(), (Y + offset_y_)*scale(), W, H);
@@ -807,8 +1233,11 @@ int Fl_Xlib_Graphics_Driver::scale_and_render_pixmap(Fl_Offscreen pixmap, int de
 
 #endif // HAVE_XRENDER
 
-void Fl_Xlib_Graphics_Driver::uncache(Fl_RGB_Image*, fl_uintptr_t &id_, fl_uintptr_t &mask_)
+void Fl_Xlib_Graphics_Driver::uncache(Fl_RGB_Image *img, fl_uintptr_t &id_, fl_uintptr_t &mask_)
 {
+#if HAVE_XRENDER
+  scaled_uncache(img);
+#endif
   if (id_) {
     XFreePixmap(fl_display, (Fl_Offscreen)id_);
     id_ = 0;
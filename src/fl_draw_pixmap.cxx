@@ -109,41 +109,184 @@ void Fl_GDI_Graphics_Driver::make_unused_color_(uchar &r, uchar &g, uchar &b) {
 #endif // FL_CFG_SYS_WIN32
 
 
-int fl_convert_pixmap(const char*const* cdata, uchar* out, Fl_Color bg) {
-  int w, h;
-  const uchar*const* data = (const uchar*const*)(cdata+1);
-  uchar *transparent_c = (uchar *)0; // such that transparent_c[0,1,2] are the RGB of the transparent color
-  
-  if (!fl_measure_pixmap(cdata, w, h))
-    return 0;
-  
-  if ((chars_per_pixel < 1) || (chars_per_pixel > 2))
-    return 0;
-  
-  typedef uchar uchar4[4];
-  uchar4 *colors = new uchar4[1<<(chars_per_pixel*8)];
-  
-  if (Fl_Graphics_Driver::need_pixmap_bg_color) {
+// Color specifications of XPM data that were parsed, so that each color name
+// is only looked up once: fl_parse_color() may ask the X server for names.
+typedef struct Color_Name {
+  char *name;
+  uchar r, g, b, ok;
+  struct Color_Name *next;
+} Color_Name;
+
+#define COLOR_NAME_BUCKETS 256
+#define COLOR_NAME_MAX 4096     // more names are parsed but not kept
+static Color_Name *color_names[COLOR_NAME_BUCKETS];
+static int color_name_count = 0;
+
+static unsigned hash_bytes(const uchar *p, size_t n, unsigned h) {
+  while (n--) h = (h ^ *p++) * 16777619u; // FNV-1a
+  return h;
+}
+
+static int parse_color_cached(const char *p, uchar &r, uchar &g, uchar &b) {
+  size_t n = strlen(p);
+  unsigned h = hash_bytes((const uchar *)p, n, 2166136261u) % COLOR_NAME_BUCKETS;
+  Color_Name *c;
+  for (c = color_names[h]; c; c = c->next) {
+    if (!strcmp(c->name, p)) {
+      r = c->r; g = c->g; b = c->b;
+      return c->ok;
+    }
+  }
+  int ok = fl_parse_color(p, r, g, b);
+  if (color_name_count < COLOR_NAME_MAX) {
+    c = (Color_Name *)malloc(sizeof(Color_Name));
+    c->name = strdup(p);
+    c->r = r; c->g = g; c->b = b;
+    c->ok = (uchar)ok;
+    c->next = color_names[h];
+    color_names[h] = c;
+    color_name_count++;
+  }
+  return ok;
+}
+
+// The colors of a pixmap, mapping the color keys of its pixels to RGBA
+// values in memory order: a direct table for one character per pixel, and
+// a hash table of the two character keys, which are few, for two.
+typedef struct Pixmap_Colors {
+  int cpp;                      // characters per pixel
+  int shift;                    // hash table of 1 << (32 - shift) entries for cpp 2
+  unsigned *keys;               // keys of the hash table, NO_KEY if free
+  U32 *pixels;                  // RGBA pixels
+  int ncolors;                  // number of colors, < 0 if compressed
+  unsigned sum;                 // checksum of cpp, ncolors and the color lines
+  int length;                   // length of the color lines
+  uchar *lines;                 // copy of the color lines, nul separated
+  Fl_Color bg;                  // transparent color
+} Pixmap_Colors;
+
+#define NO_KEY 0xffffffffu
+#define PIXMAP_COLORS_CACHE 16  // number of colormaps kept
+static Pixmap_Colors *colors_cache[PIXMAP_COLORS_CACHE];
+static int colors_cache_next = 0;
+
+static Pixmap_Colors *new_colors(int cpp, int ncolors) {
+  Pixmap_Colors *pc = (Pixmap_Colors *)calloc(1, sizeof(Pixmap_Colors));
+  pc->cpp = cpp;
+  int size;
+  if (cpp == 1) {
+    size = 256;
+  } else {
+    // keep the table at most half full
+    pc->shift = 32 - 2;
+    while ((1 << (32 - pc->shift)) < 2 * ncolors) pc->shift--;
+    size = 1 << (32 - pc->shift);
+    pc->keys = (unsigned *)malloc(size * sizeof(unsigned));
+    for (int i = 0; i < size; i++) pc->keys[i] = NO_KEY;
+  }
+  pc->pixels = (U32 *)calloc(size, sizeof(U32));
+  return pc;
+}
+
+static void delete_colors(Pixmap_Colors *pc) {
+  if (!pc) return;
+  free(pc->keys);
+  free(pc->pixels);
+  free(pc->lines);
+  free(pc);
+}
+
+// Returns the index of a key in the hash table, which is free if the key is not in it
+static inline unsigned colors_index(const Pixmap_Colors *pc, unsigned key) {
+  unsigned mask = (1u << (32 - pc->shift)) - 1;
+  unsigned i = (key * 2654435761u) >> pc->shift;
+  while (pc->keys[i] != key && pc->keys[i] != NO_KEY) i = (i + 1) & mask;
+  return i;
+}
+
+// Returns the RGBA bytes for a key, adding the key if it is new
+static uchar *colors_slot(Pixmap_Colors *pc, unsigned key) {
+  if (pc->cpp == 1) return (uchar *)(pc->pixels + key);
+  unsigned i = colors_index(pc, key);
+  pc->keys[i] = key;
+  return (uchar *)(pc->pixels + i);
+}
+
+// Returns the length of color line i of a pixmap including its nul, the
+// FLTK compressed colormap is a single binary line of 4 bytes per color
+static inline size_t colors_line_length(const uchar*const* data, int i) {
+  return ncolors < 0 ? 4 * (size_t)(-ncolors) : strlen((const char *)data[i]) + 1;
+}
+
+// Computes the checksum and the length of the color lines of a pixmap, the
+// header line is left out so that copies at other sizes match
+static unsigned colors_sum(const uchar*const* data, int &length) {
+  int lines = ncolors < 0 ? 1 : ncolors;
+  unsigned sum = hash_bytes((const uchar *)&chars_per_pixel, sizeof(int), 2166136261u);
+  sum = hash_bytes((const uchar *)&ncolors, sizeof(int), sum);
+  length = 0;
+  for (int i = 0; i < lines; i++) {
+    size_t n = colors_line_length(data, i);
+    sum = hash_bytes(data[i], n, sum);
+    length += (int)n;
+  }
+  return sum;
+}
+
+// Compares the color lines of a pixmap with the ones of a cached colormap
+static int colors_equal(const Pixmap_Colors *pc, const uchar*const* data) {
+  int lines = ncolors < 0 ? 1 : ncolors;
+  const uchar *q = pc->lines;
+  for (int i = 0; i < lines; i++) {
+    size_t n = colors_line_length(data, i);
+    if (memcmp(q, data[i], n)) return 0;
+    q += n;
+  }
+  return 1;
+}
+
+// Copies the color lines of a pixmap into a cached colormap
+static void colors_copy(Pixmap_Colors *pc, const uchar*const* data, int length) {
+  int lines = ncolors < 0 ? 1 : ncolors;
+  uchar *q = pc->lines = (uchar *)malloc(length);
+  for (int i = 0; i < lines; i++) {
+    size_t n = colors_line_length(data, i);
+    memcpy(q, data[i], n);
+    q += n;
+  }
+}
+
+// Parses the colormap of a pixmap, data points at its first color line.
+// If record_colors is set, the colors are put into used_colors and
+// transparent_c is set so that transparent_c[0,1,2] are the RGB of the
+// transparent color, if any.
+static Pixmap_Colors *parse_colors(const uchar*const* data, Fl_Color bg,
+                                   int record_colors, uchar *&transparent_c) {
+  Pixmap_Colors *pc = new_colors(chars_per_pixel, abs(ncolors));
+  int n = ncolors;
+  transparent_c = (uchar *)0;
+
+  if (record_colors) {
     color_count = 0;
-    used_colors = (UsedColor*)malloc(abs(ncolors) * sizeof(UsedColor));
+    used_colors = (UsedColor*)malloc(abs(n) * sizeof(UsedColor));
   }
-  
-  if (ncolors < 0) {	// FLTK (non standard) compressed colormap
-    ncolors = -ncolors;
+
+  if (n < 0) {	// FLTK (non standard) compressed colormap
+    n = -n;
     const uchar *p = *data++;
     // if first color is ' ' it is transparent (put it later to make
     // it not be transparent):
     if (*p == ' ') {
-      uchar* c = colors[(int)' '];
+      uchar* c = colors_slot(pc, ' ');
       Fl::get_color(bg, c[0], c[1], c[2]); c[3] = 0;
-      if (Fl_Graphics_Driver::need_pixmap_bg_color) transparent_c = c;
+      if (record_colors) transparent_c = c;
       p += 4;
-      ncolors--;
+      n--;
     }
     // read all the rest of the colors:
-    for (int i=0; i < ncolors; i++) {
-      uchar* c = colors[*p++];
-      if (Fl_Graphics_Driver::need_pixmap_bg_color) {
+    for (int i=0; i < n; i++) {
+      uchar* c = colors_slot(pc, *p++);
+      if (record_colors) {
         used_colors[color_count].r = *(p+0);
         used_colors[color_count].g = *(p+1);
         used_colors[color_count].b = *(p+2);
@@ -155,14 +298,13 @@ int fl_convert_pixmap(const char*const* cdata, uchar* out, Fl_Color bg) {
       *c = 255;
     }
   } else {	// normal XPM colormap with names
-    for (int i=0; i<ncolors; i++) {
+    for (int i=0; i<n; i++) {
       const uchar *p = *data++;
       // the first 1 or 2 characters are the color index:
-      int ind = *p++;
-      uchar* c;
+      unsigned ind = *p++;
       if (chars_per_pixel>1)
         ind = (ind<<8)|*p++;
-      c = colors[ind];
+      uchar* c = colors_slot(pc, ind);
       // look for "c word", or last word if none:
       const uchar *previous_word = p;
       for (;;) {
@@ -175,10 +317,10 @@ int fl_convert_pixmap(const char*const* cdata, uchar* out, Fl_Color bg) {
         previous_word = p;
         while (*p && !isspace(*p)) p++;
       }
-      int parse = fl_parse_color((const char*)p, c[0], c[1], c[2]);
+      int parse = parse_color_cached((const char*)p, c[0], c[1], c[2]);
       c[3] = 255;
       if (parse) {
-        if (Fl_Graphics_Driver::need_pixmap_bg_color) {
+        if (record_colors) {
           used_colors[color_count].r = c[0];
           used_colors[color_count].g = c[1];
           used_colors[color_count].b = c[2];
@@ -190,34 +332,89 @@ int fl_convert_pixmap(const char*const* cdata, uchar* out, Fl_Color bg) {
         Fl::get_color(bg, c[0], c[1], c[2]);
         //uchar **m = fl_graphics_driver->mask_bitmap();
         c[3] = /*(m && !*m) ? 255 :*/ 0;
-        if (Fl_Graphics_Driver::need_pixmap_bg_color) transparent_c = c;
+        if (record_colors) transparent_c = c;
       } // if parse
     } // for ncolors
   } // if ncolors
-  if (Fl_Graphics_Driver::need_pixmap_bg_color) {
-    if (transparent_c) {
-      fl_graphics_driver->make_unused_color_(transparent_c[0], transparent_c[1], transparent_c[2]);
-    } else {
-      uchar r, g, b;
-      fl_graphics_driver->make_unused_color_(r, g, b);
+  return pc;
+}
+
+int fl_convert_pixmap(const char*const* cdata, uchar* out, Fl_Color bg) {
+  int w, h;
+  const uchar*const* data = (const uchar*const*)(cdata+1);
+  
+  if (!fl_measure_pixmap(cdata, w, h))
+    return 0;
+  
+  if ((chars_per_pixel < 1) || (chars_per_pixel > 2))
+    return 0;
+  
+  // Colormaps are kept unless the graphics driver needs to know the colors
+  // used by each pixmap. Identical colormaps of different pixmaps, like
+  // copies of a pixmap at other sizes, share an entry.
+  Pixmap_Colors *pc = 0;
+  int cached = !Fl_Graphics_Driver::need_pixmap_bg_color;
+  unsigned sum = 0;
+  int length = 0;
+  if (cached) {
+    sum = colors_sum(data, length);
+    for (int i = 0; i < PIXMAP_COLORS_CACHE; i++) {
+      Pixmap_Colors *e = colors_cache[i];
+      if (e && e->sum == sum && e->length == length && e->bg == bg &&
+          e->cpp == chars_per_pixel && e->ncolors == ncolors &&
+          colors_equal(e, data)) {
+        pc = e;
+        break;
+      }
+    }
+  }
+  if (!pc) {
+    uchar *transparent_c;
+    pc = parse_colors(data, bg, !cached, transparent_c);
+    if (Fl_Graphics_Driver::need_pixmap_bg_color) {
+      if (transparent_c) {
+        fl_graphics_driver->make_unused_color_(transparent_c[0], transparent_c[1], transparent_c[2]);
+      } else {
+        uchar r, g, b;
+        fl_graphics_driver->make_unused_color_(r, g, b);
+      }
+    }
+    if (cached) {
+      pc->ncolors = ncolors;
+      pc->sum = sum;
+      pc->length = length;
+      colors_copy(pc, data, length);
+      pc->bg = bg;
+      delete_colors(colors_cache[colors_cache_next]);
+      colors_cache[colors_cache_next] = pc;
+      colors_cache_next = (colors_cache_next + 1) % PIXMAP_COLORS_CACHE;
     }
   }
+  data += (ncolors < 0 ? 1 : ncolors);
   
+  // convert whole rows, pixels are often repeated
   U32 *q = (U32*)out;
+  const U32 *pixels = pc->pixels;
   for (int Y = 0; Y < h; Y++) {
     const uchar* p = data[Y];
     if (chars_per_pixel <= 1) {
       for (int X = 0; X < w; X++)
-        memcpy(q++, colors[*p++], 4);
+        *q++ = pixels[*p++];
     } else {
-      for (int X = 0; X < w; X++) {
-        int ind = (*p++)<<8;
-        ind |= *p++;
-        memcpy(q++, colors[ind], 4);
+      unsigned last = NO_KEY;
+      U32 pixel = 0;
+      for (int X = 0; X < w; X++, p += 2) {
+        unsigned ind = (p[0]<<8) | p[1];
+        if (ind != last) {
+          unsigned i = colors_index(pc, ind);
+          pixel = pc->keys[i] == NO_KEY ? 0 : pixels[i];
+          last = ind;
+        }
+        *q++ = pixel;
       }
     }
   }
-  delete[] colors;
+  if (!cached) delete_colors(pc);
   return 1;
 }
 
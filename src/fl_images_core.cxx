@@ -18,6 +18,7 @@
 // Contents:
 //
 //   fl_register_images() - Register the image formats.
+//   fl_check_gif_rgb()   - Check for a GIF file to load as Fl_GIF_RGB_Image.
 //   fl_check_images()    - Check for a supported image format.
 //
 
@@ -45,6 +46,7 @@
 // the extra image formats that aren't part of the core FLTK library.
 //
 
+static Fl_Image	*fl_check_gif_rgb(const char *name, uchar *header, int headerlen);
 static Fl_Image	*fl_check_images(const char *name, uchar *header, int headerlen);
 
 
@@ -60,6 +62,47 @@ void fl_register_images() {
 }
 
 
+/**
+\brief Register the image formats with options.
+
+ Same as fl_register_images(), but \p flags can select other image
+ classes for some formats:
+
+ - FL_IMAGES_GIF_RGB loads GIF files as Fl_GIF_RGB_Image instead of
+   Fl_GIF_Image. Code that casts shared GIF images to Fl_Pixmap or
+   Fl_GIF_Image must not use this flag.
+
+ Calling this function again with other flags changes the selection.
+
+ \since FLTK 1.4.0
+*/
+void fl_register_images(int flags) {
+  // the GIF handler must come before fl_check_images(), which loads GIF
+  // files as Fl_GIF_Image
+  Fl_Shared_Image::remove_handler(fl_check_gif_rgb);
+  Fl_Shared_Image::remove_handler(fl_check_images);
+  if (flags & FL_IMAGES_GIF_RGB)
+    Fl_Shared_Image::add_handler(fl_check_gif_rgb);
+  Fl_Shared_Image::add_handler(fl_check_images);
+}
+
+
+//
+// 'fl_check_gif_rgb()' - Check for a GIF file to load as Fl_GIF_RGB_Image.
+//
+
+static Fl_Image *				// O - Image, if found
+fl_check_gif_rgb(const char *name,		// I - Filename
+                 uchar      *header,		// I - Header data from file
+		 int) {				// I - Amount of data
+  if (memcmp(header, "GIF87a", 6) == 0 ||
+      memcmp(header, "GIF89a", 6) == 0)	// GIF file
+    return new Fl_GIF_RGB_Image(name);
+
+  return 0;
+}
+
+
 //
 // 'fl_check_images()' - Check for a supported image format.
 //
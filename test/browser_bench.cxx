@@ -0,0 +1,93 @@
+//
+// "$Id$"
+//
+// Fl_Browser sorting and lookup benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Fills an Fl_Browser with 10k, 100k and 1M log-like lines of three
+// columns, then reports the time taken to sort them by the whole text,
+// case-insensitively by numbers, and by a column, and to access random
+// lines by number. It needs a display to measure the lines, but opens
+// no window.
+//
+// Usage: browser_bench [max_lines]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Browser.H>
+#include <FL/platform.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv) {
+  int max_lines = argc > 1 ? atoi(argv[1]) : 1000000;
+  static const char *levels[] = { "@C1INFO", "@bWarning", "error", "Debug" };
+  static const int widths[] = { 80, 80, 0 };
+  unsigned seed = 1;
+
+  fl_open_display();
+  printf("%-8s %8s %8s %8s %8s %8s %12s\n", "lines", "fill", "sort",
+         "numeric", "column", "desc", "text(n)/s");
+  for (int n = 10000; n <= max_lines; n *= 10) {
+    Fl_Browser *b = new Fl_Browser(0, 0, 400, 300);
+    b->column_widths(widths);
+    char line[100];
+    double t = now();
+    for (int i = 0; i < n; i++) {
+      seed = seed * 1103515245 + 12345;
+      sprintf(line, "%s\tpid%u\tmessage %u", levels[(seed >> 8) & 3],
+              (seed >> 12) % 30000, seed >> 16);
+      b->add(line);
+    }
+    double fill = now() - t;
+    t = now();
+    b->sort(FL_SORT_ASCENDING);
+    double sort = now() - t;
+    t = now();
+    b->sort(FL_SORT_CASEINSENSITIVE | FL_SORT_NUMERIC);
+    double numeric = now() - t;
+    t = now();
+    b->sort(FL_SORT_NUMERIC, 1);
+    double column = now() - t;
+    t = now();
+    b->sort(FL_SORT_DESCENDING | FL_SORT_NUMERIC, 2);
+    double desc = now() - t;
+    int lookups = 0;
+    size_t sum = 0;
+    t = now();
+    do {
+      for (int i = 0; i < 10000; i++) {
+        seed = seed * 1103515245 + 12345;
+        sum += (size_t)b->text(1 + (int)((seed >> 8) % n));
+      }
+      lookups += 10000;
+    } while (now() - t < 0.2);
+    double rate = lookups / (now() - t);
+    printf("%-8d %8.3f %8.3f %8.3f %8.3f %8.3f %12.0f%s\n", n, fill, sort,
+           numeric, column, desc, rate, sum ? "" : " ");
+    delete b;
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,214 @@
+//
+// "$Id$"
+//
+// Fl_Browser line index test program for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Applies random insert, remove, move, swap, text, hide, show and clear
+// calls to an Fl_Browser and to a plain array of lines, and checks that
+// the browser's line index agrees with a linear walk over the array:
+// the text of a line, the line number and y position of an item, the
+// item at a y position, and the full height. Line heights depend on the
+// text, so that changing the text of a line changes the heights in the
+// index. It needs no display and opens no window.
+//
+// Usage: browser_index_test [iterations]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Browser.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int model_height(const char *text) {
+  return 10 + (int)(strlen(text) % 5);
+}
+
+// gives the test access to the protected index functions
+class Test_Browser : public Fl_Browser {
+protected:
+  int item_height(void *item) const { return model_height(item_text(item)); }
+  int item_width(void *) const { return 10; }
+  void item_draw(void *, int, int, int, int) const { }
+public:
+  Test_Browser() : Fl_Browser(0, 0, 200, 200) { }
+  void *line_item(int line) const { return find_line(line); }
+  int item_line(void *item) const { return lineno(item); }
+  int position(void *item) const { return item_position(item); }
+  void *at_position(int pos, int *item_pos) const {
+    return item_at_position(pos, item_pos);
+  }
+  int total_height() const { return full_height(); }
+};
+
+struct Ref_Line {
+  char *text;
+  int hidden;
+};
+
+// the reference model, lines[0] is browser line 1
+static Ref_Line *lines = 0;
+static int nlines = 0, alloc = 0;
+
+static void ref_insert(int i, const char *text, int hidden) {
+  if (nlines >= alloc) {
+    alloc = alloc ? 2 * alloc : 1024;
+    lines = (Ref_Line *)realloc(lines, alloc * sizeof(Ref_Line));
+  }
+  memmove(lines + i + 1, lines + i, (nlines - i) * sizeof(Ref_Line));
+  lines[i].text = strdup(text);
+  lines[i].hidden = hidden;
+  nlines++;
+}
+
+static void ref_remove(int i) {
+  free(lines[i].text);
+  memmove(lines + i, lines + i + 1, (nlines - i - 1) * sizeof(Ref_Line));
+  nlines--;
+}
+
+static int ref_height(int i) {
+  return lines[i].hidden ? 0 : model_height(lines[i].text);
+}
+
+static unsigned seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)n);
+}
+
+// checks one random line and one random y position, returns 0 on success
+static int check(Test_Browser &b, int it) {
+  if (b.size() != nlines) {
+    printf("iteration %d: size %d, expected %d\n", it, b.size(), nlines);
+    return 1;
+  }
+  if (!nlines) return 0;
+  int line = rnd(nlines) + 1;
+  void *item = b.line_item(line);
+  if (strcmp(b.text(line), lines[line - 1].text)) {
+    printf("iteration %d: line %d is \"%s\", expected \"%s\"\n",
+           it, line, b.text(line), lines[line - 1].text);
+    return 1;
+  }
+  if (b.item_line(item) != line) {
+    printf("iteration %d: lineno %d, expected %d\n", it, b.item_line(item), line);
+    return 1;
+  }
+  int pos = 0, total = 0, i;
+  for (i = 0; i < nlines; i++) {
+    if (i == line - 1) pos = total;
+    total += ref_height(i);
+  }
+  if (b.position(item) != pos) {
+    printf("iteration %d: line %d at y %d, expected %d\n",
+           it, line, b.position(item), pos);
+    return 1;
+  }
+  if (b.total_height() != total) {
+    printf("iteration %d: full height %d, expected %d\n",
+           it, b.total_height(), total);
+    return 1;
+  }
+  // the item at y is the one it falls into, or the last line below the end
+  int y = rnd(total + 20), item_y, found_y = 0;
+  void *found = b.at_position(y, &item_y);
+  for (i = 0; i < nlines; i++) {
+    if (y < found_y + ref_height(i)) break;
+    found_y += ref_height(i);
+  }
+  if (i == nlines) {
+    i = nlines - 1;
+    found_y = total - ref_height(i);
+  }
+  if (found != b.line_item(i + 1) || item_y != found_y) {
+    printf("iteration %d: y %d is in line %d at %d, expected line %d at %d\n",
+           it, y, found ? b.item_line(found) : 0, item_y, i + 1, found_y);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+  Test_Browser b;
+  char buf[64];
+
+  for (int it = 0; it < iterations; it++) {
+    int op = rnd(100), n = nlines;
+    if (op < 40 || n < 5) {
+      // insert before line 1..n+1, or out of range at either end
+      int at = rnd(n + 2) + (rnd(3) ? 0 : n);
+      sprintf(buf, "line %d-%d", it, rnd(1000));
+      b.insert(at, buf);
+      ref_insert(at < 1 ? 0 : (at > n ? n : at - 1), buf, 0);
+    } else if (op < 60) {
+      int line = rnd(n) + 1;
+      b.remove(line);
+      ref_remove(line - 1);
+    } else if (op < 65) {
+      int from = rnd(n) + 1, to = rnd(n) + 1;
+      if (lines[from - 1].hidden) continue;  // only visible lines are moved
+      b.move(to, from);
+      Ref_Line l = lines[from - 1];
+      memmove(lines + from - 1, lines + from, (n - from) * sizeof(Ref_Line));
+      to = to > n - 1 ? n - 1 : to - 1;
+      memmove(lines + to + 1, lines + to, (n - 1 - to) * sizeof(Ref_Line));
+      lines[to] = l;
+    } else if (op < 70) {
+      int a = rnd(n) + 1, c = rnd(n) + 1;
+      b.swap(a, c);
+      Ref_Line l = lines[a - 1];
+      lines[a - 1] = lines[c - 1];
+      lines[c - 1] = l;
+    } else if (op < 78) {
+      int line = rnd(n) + 1;
+      if (lines[line - 1].hidden) continue;  // only visible lines are edited
+      sprintf(buf, "text %d %d xxxxxxxxxxxxxxxxxxxxxxxx", it, rnd(100));
+      buf[rnd(30) + 3] = 0;
+      b.text(line, buf);
+      free(lines[line - 1].text);
+      lines[line - 1].text = strdup(buf);
+    } else if (op < 84) {
+      int line = rnd(n) + 1;
+      b.hide(line);
+      lines[line - 1].hidden = 1;
+    } else if (op < 88) {
+      int line = rnd(n) + 1;
+      b.show(line);
+      lines[line - 1].hidden = 0;
+    } else if (op < 89 && !rnd(200)) {
+      b.clear();
+      while (nlines) ref_remove(nlines - 1);
+    } else if (check(b, it)) {
+      return 1;
+    }
+  }
+
+  for (int line = 1; line <= nlines; line++) {
+    if (strcmp(b.text(line), lines[line - 1].text) ||
+        b.item_line(b.line_item(line)) != line) {
+      printf("line %d differs after %d iterations\n", line, iterations);
+      return 1;
+    }
+  }
+  printf("ok, %d iterations, %d lines\n", iterations, nlines);
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,188 @@
+//
+// "$Id$"
+//
+// Fl_Browser sort test program for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Fills an Fl_Browser with random lines of three columns, some with
+// format codes and some hidden, sorts them with random flags by the whole
+// text or by one column, and compares the result with std::stable_sort()
+// of the same lines using a separate implementation of the comparison.
+// Every fourth round reorders the lines through the generic
+// Fl_Browser_::item_reorder() that swaps items. It also checks that the
+// line index is still right after sorting. It needs no display and opens
+// no window.
+//
+// Usage: browser_sort_test [rounds]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Browser.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+
+static int model_height(const char *text) {
+  return 10 + (int)(strlen(text) % 5);
+}
+
+class Test_Browser : public Fl_Browser {
+protected:
+  int item_height(void *item) const { return model_height(item_text(item)); }
+  int item_width(void *) const { return 10; }
+  void item_draw(void *, int, int, int, int) const { }
+  void item_reorder(void **items, int n) {
+    if (use_swap) Fl_Browser_::item_reorder(items, n);
+    else Fl_Browser::item_reorder(items, n);
+  }
+public:
+  int use_swap;
+  Test_Browser() : Fl_Browser(0, 0, 200, 200), use_swap(0) { }
+  void *line_item(int line) const { return item_at(line); }
+  int item_line(void *item) const { return lineno(item); }
+  int position(void *item) const { return item_position(item); }
+  int total_height() const { return full_height(); }
+};
+
+struct Ref_Line {
+  char text[64];
+  long id;
+};
+
+// Returns the text of a column after the format codes at its start, up to
+// the next tab, in buf:
+static const char *ref_column(const char *s, int column, char *buf) {
+  for (; column > 0; column--) {
+    s = strchr(s, '\t');
+    if (!s) { buf[0] = 0; return buf; }
+    s++;
+  }
+  while (s[0] == '@' && s[1] && s[1] != '@') {
+    char c = s[1];
+    s += 2;
+    if (c == 'B' || c == 'C' || c == 'F' || c == 'S')
+      while (isdigit(*s & 255)) s++;
+    else if (c == '.')
+      break;
+  }
+  int n = 0;
+  while (s[n] && s[n] != '\t') n++;
+  memcpy(buf, s, n);
+  buf[n] = 0;
+  return buf;
+}
+
+// Compares two strings, runs of digits by their value if numeric is set:
+static int ref_compare(const char *a, const char *b, int nocase, int numeric) {
+  for (;;) {
+    if (numeric && isdigit(*a & 255) && isdigit(*b & 255)) {
+      char *ea, *eb;
+      // the test numbers are short, so they fit into a long
+      long va = strtol(a, &ea, 10), vb = strtol(b, &eb, 10);
+      if (va != vb) return va < vb ? -1 : 1;
+      a = ea; b = eb;
+      continue;
+    }
+    int ca = *a & 255, cb = *b & 255;
+    if (nocase) { ca = tolower(ca); cb = tolower(cb); }
+    if (ca != cb) return ca - cb;
+    if (!ca) return 0;
+    a++; b++;
+  }
+}
+
+// The "less than" of std::stable_sort() for one sort() call:
+struct Ref_Less {
+  int flags, column;
+  bool operator()(const Ref_Line &x, const Ref_Line &y) const {
+    char bx[64], by[64];
+    const char *a = x.text, *b = y.text;
+    if (column >= 0) {
+      a = ref_column(a, column, bx);
+      b = ref_column(b, column, by);
+    }
+    int c = ref_compare(a, b, flags & FL_SORT_CASEINSENSITIVE,
+                        flags & FL_SORT_NUMERIC);
+    return (flags & FL_SORT_DESCENDING) ? c > 0 : c < 0;
+  }
+};
+
+static unsigned seed = 7;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)n);
+}
+
+static const char *words[] = {
+  "apple", "Apple", "banana", "file9", "file10", "file009", "File2",
+  "z", "", "x100y", "x20y"
+};
+#define NWORDS (int)(sizeof(words) / sizeof(words[0]))
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 200;
+  for (int round = 0; round < rounds; round++) {
+    Test_Browser b;
+    b.use_swap = (round % 4 == 3);
+    int n = rnd(round < rounds / 2 ? 50 : 3000) + 1;
+    Ref_Line *lines = new Ref_Line[n];
+    int i;
+    for (i = 0; i < n; i++) {
+      sprintf(lines[i].text, "%s%s\t%s%s\t%d",
+              rnd(3) ? "" : "@b@C12", words[rnd(NWORDS)],
+              rnd(2) ? "@." : "", words[rnd(NWORDS)], rnd(50));
+      lines[i].id = i + 1;
+      b.add(lines[i].text, (void *)lines[i].id);
+    }
+    for (i = 0; i < n / 10; i++) b.hide(rnd(n) + 1);
+
+    Ref_Less less;
+    less.flags = rnd(8);
+    less.column = rnd(4) - 1;
+    if (less.column < 0) b.sort(less.flags);
+    else b.sort(less.flags, less.column);
+    std::stable_sort(lines, lines + n, less);
+
+    int pos = 0;
+    for (i = 1; i <= n; i++) {
+      if (strcmp(b.text(i), lines[i - 1].text) ||
+          (long)b.data(i) != lines[i - 1].id) {
+        printf("round %d, flags %d, column %d, line %d: \"%s\", expected \"%s\"\n",
+               round, less.flags, less.column, i, b.text(i), lines[i - 1].text);
+        return 1;
+      }
+      void *item = b.line_item(i);
+      if (b.item_line(item) != i || b.position(item) != pos) {
+        printf("round %d: index of line %d is wrong after sorting\n", round, i);
+        return 1;
+      }
+      if (b.visible(i)) pos += model_height(b.text(i));
+    }
+    if (pos != b.total_height()) {
+      printf("round %d: full height %d, expected %d\n",
+             round, b.total_height(), pos);
+      return 1;
+    }
+    delete[] lines;
+  }
+  printf("ok, %d rounds\n", rounds);
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,229 @@
+//
+// "$Id$"
+//
+// Fl_Browser virtual mode test program for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Applies random select, deselect, topline(), lineposition(), position()
+// and virtual_lines() calls that grow and shrink the browser to multi and
+// hold browsers in virtual mode and to a plain model of the selection and
+// scroll position, and checks the selection, value(), position(),
+// topline(), the line found under random mouse positions and that the
+// callback is only asked for existing lines. It also checks that
+// Fl_File_Browser refuses virtual mode. It needs a display to measure the
+// lines, but opens no window.
+//
+// Usage: browser_virtual_test [rounds]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Browser.H>
+#include <FL/Fl_File_Browser.H>
+#include <FL/platform.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINES 200000
+
+// gives the test access to the protected members
+class Test_Browser : public Fl_Browser {
+public:
+  Test_Browser(int t) : Fl_Browser(0, 0, 200, 300) { type(t); }
+  int model_height() const { return item_height(0); }
+  int box_height() { int X, Y, W, H; bbox(X, Y, W, H); return H; }
+  int box_y() { int X, Y, W, H; bbox(X, Y, W, H); return Y; }
+  int line_at(int y) { void *item = find_item(y); return item ? lineno(item) : 0; }
+};
+
+static int nlines = 0;          // number of lines the callback knows
+static int bad_line = 0;        // a line the callback should not be asked for
+
+static void line_cb(int line, Fl_Browser_Line *info, void *) {
+  static char buf[32];
+  if (line < 1 || line > nlines) bad_line = line;
+  sprintf(buf, "line %d", line);
+  info->text = buf;
+}
+
+static int errors = 0;
+
+static void count_error(const char *, ...) {
+  errors++;
+}
+
+static unsigned seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)n);
+}
+
+// the model, selected[i] is the selection of line i
+static char selected[MAX_LINES + 1];
+static int value, pos;
+
+// Returns the scroll position that lineposition() gives:
+static int ref_lineposition(int line, Fl_Browser::Fl_Line_Position where,
+                            int h, int H) {
+  if (line < 1) line = 1;
+  if (line > nlines) line = nlines;
+  int p = nlines ? (line - 1) * h : 0;
+  if (nlines && where == Fl_Browser::BOTTOM) p += h;
+  if (where == Fl_Browser::BOTTOM) p -= H;
+  if (where == Fl_Browser::MIDDLE) p -= H / 2;
+  if (p > nlines * h - H) p = nlines * h - H;
+  return p < 0 ? 0 : p;
+}
+
+// checks the browser against the model, returns 0 on success
+static int check(Test_Browser &b, int round, int step) {
+  if (b.size() != nlines) {
+    printf("round %d, step %d: size %d, expected %d\n", round, step, b.size(), nlines);
+    return 1;
+  }
+  for (int k = 0; k < 10 && nlines; k++) {
+    int line = rnd(nlines) + 1;
+    if (!b.selected(line) != !selected[line]) {
+      printf("round %d, step %d: line %d is %sselected\n",
+             round, step, line, selected[line] ? "not " : "");
+      return 1;
+    }
+  }
+  if (b.value() != value) {
+    printf("round %d, step %d: value %d, expected %d\n", round, step, b.value(), value);
+    return 1;
+  }
+  if (b.position() != pos) {
+    printf("round %d, step %d: position %d, expected %d\n",
+           round, step, b.position(), pos);
+    return 1;
+  }
+  // the list is scrolled to the position, or to the last line below the end
+  int h = b.model_height(), Y = b.box_y(), H = b.box_height();
+  int real_pos = pos;
+  if (nlines && real_pos > nlines * h - 1) real_pos = nlines * h - 1;
+  for (int k = 0; k < 10; k++) {
+    int y = Y + 1 + rnd(H), line = b.line_at(y);
+    int p = real_pos + y - Y - 1, expected = p / h + 1;
+    if (!nlines || expected > nlines) expected = 0;
+    if (line != expected) {
+      printf("round %d, step %d: y %d is in line %d, expected %d\n",
+             round, step, y, line, expected);
+      return 1;
+    }
+  }
+  int top = nlines ? real_pos / h + 1 : 0;
+  if (b.topline() != top) {
+    printf("round %d, step %d: top line %d, expected %d\n",
+           round, step, b.topline(), top);
+    return 1;
+  }
+  if (nlines) {
+    int line = rnd(nlines) + 1;
+    char buf[32];
+    sprintf(buf, "line %d", line);
+    if (strcmp(b.text(line), buf)) {
+      printf("round %d, step %d: line %d is \"%s\"\n", round, step, line, b.text(line));
+      return 1;
+    }
+  }
+  if (bad_line) {
+    printf("round %d, step %d: the callback was asked for line %d of %d\n",
+           round, step, bad_line, nlines);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 200;
+  fl_open_display();
+
+  Fl::error = count_error;
+  Fl_File_Browser fb(0, 0, 200, 300);
+  fb.virtual_lines(10, line_cb);
+  if (errors != 1 || fb.size() || fb.virtual_lines()) {
+    printf("Fl_File_Browser did not refuse virtual mode\n");
+    return 1;
+  }
+
+  for (int round = 0; round < rounds; round++) {
+    int multi = round % 2;
+    Test_Browser b(multi ? FL_MULTI_BROWSER : FL_HOLD_BROWSER);
+    nlines = rnd(3) ? rnd(2000) : rnd(MAX_LINES + 1);
+    b.virtual_lines(nlines, line_cb);
+    memset(selected, 0, sizeof(selected));
+    value = pos = 0;
+    int data = 0;
+
+    for (int step = 0; step < 300; step++) {
+      int op = rnd(100), h = b.model_height(), H = b.box_height();
+      if (op < 30 && nlines) {
+        int line = rnd(nlines) + 1, val = rnd(3) ? 1 : 0;
+        b.select(line, val);
+        if (multi) {
+          selected[line] = (char)val;
+          value = line;
+        } else if (val && value != line) {
+          selected[value] = 0;
+          selected[line] = 1;
+          value = line;
+          pos = b.position();     // display() scrolled to the line
+        } else if (!val && value == line) {
+          selected[line] = 0;
+          value = 0;
+        }
+      } else if (op < 45) {
+        int n = rnd(4) ? rnd(nlines + 1) : rnd(MAX_LINES + 1);
+        if (n < nlines) {
+          memset(selected + n + 1, 0, nlines - n);
+          if (value > n) value = 0;
+          if (pos > n * h - H) pos = n * h - H;
+          if (pos < 0) pos = 0;
+        }
+        nlines = n;
+        b.virtual_lines(n, line_cb, data ? &data : 0);
+      } else if (op < 48) {
+        // another callback clears the browser
+        data = !data;
+        nlines = rnd(2000);
+        b.virtual_lines(nlines, line_cb, data ? &data : 0);
+        memset(selected, 0, sizeof(selected));
+        value = pos = 0;
+      } else if (op < 58) {
+        int line = rnd(nlines + 2);
+        b.topline(line);
+        pos = ref_lineposition(line, Fl_Browser::TOP, h, H);
+      } else if (op < 68) {
+        int line = rnd(nlines + 2);
+        Fl_Browser::Fl_Line_Position where = (Fl_Browser::Fl_Line_Position)rnd(3);
+        b.lineposition(line, where);
+        pos = ref_lineposition(line, where, h, H);
+      } else if (op < 75) {
+        int p = rnd(nlines * h + 100) - 50;
+        b.position(p);
+        pos = p < 0 ? 0 : p;
+      } else if (check(b, round, step)) {
+        return 1;
+      }
+    }
+  }
+  printf("ok, %d rounds\n", rounds);
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
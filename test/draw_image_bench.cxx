@@ -0,0 +1,89 @@
+//
+// "$Id$"
+//
+// Image drawing throughput benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Draws RGB, RGBA and gray images of several sizes into an offscreen
+// surface with fl_draw_image(), fl_draw_image_mono() and Fl_RGB_Image and
+// reports the throughput, which includes converting the pixels to the
+// format of the display and sending them to it. It needs a display, but
+// opens no window.
+//
+// Usage: draw_image_bench [seconds]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Image_Surface.H>
+#include <FL/fl_draw.H>
+#include <FL/platform.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+  static const int sizes[][2] = { {256, 256}, {1920, 1080}, {3840, 2160} };
+  static const char *names[] = { "", "gray", "gray+alpha", "rgb", "rgba" };
+  unsigned seed = 1;
+
+  fl_open_display();
+  printf("%-10s %-11s %10s %12s\n", "size", "format", "frames/s", "Mpixels/s");
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    int W = sizes[s][0], H = sizes[s][1];
+    uchar *data = new uchar[W * H * 4];
+    for (int i = 0; i < W * H * 4; i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (uchar)(seed >> 24);
+    }
+    Fl_Image_Surface *surf = new Fl_Image_Surface(W, H);
+    surf->set_current();
+    for (int d = 1; d <= 4; d++) {
+      if (d == 2) continue; // no fl_draw_image() variant for gray+alpha
+      int frames = 0;
+      double start = now(), t;
+      do {
+        if (d == 1) fl_draw_image_mono(data, 0, 0, W, H, 1);
+        else if (d == 3) fl_draw_image(data, 0, 0, W, H, 3);
+        else {
+          // RGBA data is drawn through Fl_RGB_Image, like in a program
+          Fl_RGB_Image img(data, W, H, 4);
+          img.draw(0, 0);
+        }
+        frames++;
+        uchar pixel[3];
+        fl_read_image(pixel, 0, 0, 1, 1); // waits until the image is drawn
+        t = now() - start;
+      } while (t < seconds);
+      char size[32];
+      sprintf(size, "%dx%d", W, H);
+      printf("%-10s %-11s %10.1f %12.1f\n", size, names[d], frames / t,
+             frames * (double)W * H / t / 1000000);
+    }
+    Fl_Display_Device::display_device()->set_current();
+    delete surf;
+    delete[] data;
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
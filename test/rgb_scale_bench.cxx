@@ -0,0 +1,84 @@
+//
+// "$Id$"
+//
+// RGB image scaling benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Times Fl_RGB_Image::copy() with each scaling method for several image
+// sizes and depths: a thumbnail, half size and double size. This is a
+// command line program that does not open a window.
+//
+// Usage: rgb_scale_bench [repeats]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Image.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static const char *method_names[] = { "nearest", "bilinear", "area" };
+
+int main(int argc, char **argv) {
+  int repeats = argc > 1 ? atoi(argv[1]) : 3;
+  if (repeats < 1) repeats = 1;
+  static const int sizes[][2] = { {640, 480}, {1920, 1080}, {4000, 3000} };
+  unsigned seed = 1;
+
+  printf("%-10s %2s %-9s %10s %10s %10s\n", "size", "d", "method",
+         "thumbnail", "half", "double");
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    int W = sizes[s][0], H = sizes[s][1];
+    for (int D = 1; D <= 4; D++) {
+      // a smooth gradient with some noise, like a photo
+      uchar *data = new uchar[W * H * D];
+      uchar *p = data;
+      for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+          for (int c = 0; c < D; c++) {
+            seed = seed * 1103515245 + 12345;
+            *p++ = (uchar)((x * 255 / W + y * (c + 1) * 255 / H + (seed >> 28)) & 255);
+          }
+      Fl_RGB_Image img(data, W, H, D);
+      for (int m = FL_RGB_SCALING_NEAREST; m <= FL_RGB_SCALING_AREA; m++) {
+        Fl_Image::RGB_scaling((Fl_RGB_Scaling)m);
+        static const int factors[][2] = { {0, 0}, {1, 2}, {2, 1} };
+        double t[3];
+        for (int f = 0; f < 3; f++) {
+          int w = f ? W * factors[f][0] / factors[f][1] : 160;
+          int h = f ? H * factors[f][0] / factors[f][1] : 120;
+          double start = now();
+          for (int r = 0; r < repeats; r++) delete img.copy(w, h);
+          t[f] = (now() - start) / repeats * 1000;
+        }
+        char size[32];
+        sprintf(size, "%dx%d", W, H);
+        printf("%-10s %2d %-9s %8.2fms %8.2fms %8.2fms\n", size, D,
+               method_names[m], t[0], t[1], t[2]);
+      }
+      delete[] data;
+    }
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
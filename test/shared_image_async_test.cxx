@@ -0,0 +1,184 @@
+//
+// "$Id$"
+//
+// Fl_Shared_Image::get_async() test program for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Writes a few PPM files and a file in no known format, then loads them
+// many times with Fl_Shared_Image::get_async() on several threads, at the
+// file size and at other sizes, and releases some of them before they are
+// loaded. It checks that the loaded images have the right size and pixels,
+// that images which could not be loaded are removed from the cache, and
+// that all images in use are found in the cache. It needs no display and
+// opens no window.
+//
+// Usage: shared_image_async_test [rounds]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Shared_Image.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NFILES 8
+
+static char names[NFILES + 1][32];
+
+static unsigned seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)n);
+}
+
+// Image i is (i+1)*5 x (i+2)*3 pixels of red i, green x, blue y:
+static int file_w(int i) { return (i + 1) * 5; }
+static int file_h(int i) { return (i + 2) * 3; }
+
+static void write_files() {
+  int i, x, y;
+  for (i = 0; i < NFILES; i++) {
+    sprintf(names[i], "async_test_%d.ppm", i);
+    FILE *fp = fopen(names[i], "wb");
+    if (!fp) { perror(names[i]); exit(1); }
+    fprintf(fp, "P6\n%d %d\n255\n", file_w(i), file_h(i));
+    for (y = 0; y < file_h(i); y++)
+      for (x = 0; x < file_w(i); x++) {
+        putc(i, fp);
+        putc(x, fp);
+        putc(y, fp);
+      }
+    fclose(fp);
+  }
+  strcpy(names[NFILES], "async_test_bad.img");
+  FILE *fp = fopen(names[NFILES], "wb");
+  if (!fp) { perror(names[NFILES]); exit(1); }
+  fputs("this is no image file\n", fp);
+  fclose(fp);
+}
+
+static void remove_files() {
+  for (int i = 0; i <= NFILES; i++) remove(names[i]);
+}
+
+// Waits until none of the images is loading, returns 0 on timeout:
+static int wait_loaded(Fl_Shared_Image **img, int n) {
+  for (int tries = 0; tries < 2000; tries++) {
+    int i;
+    for (i = 0; i < n; i++)
+      if (img[i] && img[i]->loading()) break;
+    if (i == n) return 1;
+    Fl::wait(0.01);
+  }
+  return 0;
+}
+
+// Checks a loaded image of file i at the size W x H (0 for the file size):
+static int check_image(Fl_Shared_Image *img, int i, int W, int H) {
+  if (i == NFILES) {
+    if (img->w() || img->h() || img->count()) {
+      printf("%s: empty image expected, got %dx%d\n", names[i], img->w(), img->h());
+      return 1;
+    }
+    if (Fl_Shared_Image::find(names[i])) {
+      printf("%s: failed image is still in the cache\n", names[i]);
+      return 1;
+    }
+    return 0;
+  }
+  Fl_Shared_Image *found = Fl_Shared_Image::find(names[i], W, H);
+  if (!found) {
+    printf("%s: image in use is not in the cache\n", names[i]);
+    return 1;
+  }
+  found->release();
+  if (!W) { W = file_w(i); H = file_h(i); }
+  if (img->w() != W || img->h() != H || img->d() != 3 || img->count() != 1) {
+    printf("%s: %dx%dx%d image with %d data, expected %dx%dx3\n", names[i],
+           img->w(), img->h(), img->d(), img->count(), W, H);
+    return 1;
+  }
+  if (W == file_w(i) && H == file_h(i)) {
+    const uchar *p = (const uchar *)img->data()[0];
+    int ld = img->ld() ? img->ld() : W * 3;
+    for (int y = 0; y < H; y++)
+      for (int x = 0; x < W; x++) {
+        const uchar *q = p + y * ld + x * 3;
+        if (q[0] != i || q[1] != x || q[2] != y) {
+          printf("%s: wrong pixel at %d,%d\n", names[i], x, y);
+          return 1;
+        }
+      }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 50;
+  fl_register_images();
+  Fl::lock();
+  Fl_Shared_Image::async_threads(4);
+  write_files();
+
+  for (int round = 0; round < rounds; round++) {
+    Fl_Shared_Image::cache_size(round % 2 ? 1000000 : 0);
+    const int N = 40;
+    Fl_Shared_Image *img[N];
+    int file[N], W[N], H[N], k;
+    for (k = 0; k < N; k++) {
+      file[k] = rnd(NFILES + 1);
+      W[k] = H[k] = 0;
+      if (!rnd(3) && file[k] < NFILES) {
+        W[k] = 1 + rnd(40);
+        H[k] = 1 + rnd(40);
+      }
+      img[k] = Fl_Shared_Image::get_async(names[file[k]], W[k], H[k]);
+      if (!img[k]) {
+        printf("get_async(%s) returned NULL\n", names[file[k]]);
+        return 1;
+      }
+      if (!rnd(4)) {   // cancel some of them
+        img[k]->release();
+        img[k] = 0;
+      }
+    }
+    if (!wait_loaded(img, N)) {
+      printf("round %d: images are not loaded after 20 seconds\n", round);
+      return 1;
+    }
+    for (k = 0; k < N; k++) {
+      if (!img[k]) continue;
+      if (check_image(img[k], file[k], W[k], H[k])) return 1;
+    }
+    if (Fl_Shared_Image::get(names[NFILES])) {
+      printf("get(%s) did not return NULL\n", names[NFILES]);
+      return 1;
+    }
+    for (k = 0; k < N; k++)
+      if (img[k]) img[k]->release();
+  }
+  Fl_Shared_Image::cache_size(0);
+  if (Fl_Shared_Image::num_images()) {
+    printf("%d images left in the cache\n", Fl_Shared_Image::num_images());
+    return 1;
+  }
+  remove_files();
+  printf("ok, %d rounds\n", rounds);
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
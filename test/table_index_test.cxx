@@ -0,0 +1,220 @@
+//
+// "$Id$"
+//
+// Fl_Table row and column index test program for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Gives Fl_Tables random row heights and column widths, including zero,
+// set one by one or with row_heights() and col_widths(), changes some of
+// them, and scrolls to random positions. Then it checks the positions
+// from the row and column index against linear sums over the sizes: the
+// table height, row_scroll_position(), col_scroll_position(), the visible
+// rows and columns, and the row, column and context that cursor2rowcol()
+// finds at random mouse positions. It needs no display and opens no
+// window.
+//
+// Usage: table_index_test [tables]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Table.H>
+#include <FL/Fl_Scrollbar.H>
+#include <stdio.h>
+#include <stdlib.h>
+
+// gives the test access to the protected members
+class Test_Table : public Fl_Table {
+public:
+  Test_Table() : Fl_Table(0, 0, 400, 300) { end(); }
+  using Fl_Table::ResizeFlag;
+  using Fl_Table::cursor2rowcol;
+  using Fl_Table::find_cell;
+  using Fl_Table::get_bounds;
+  using Fl_Table::row_scroll_position;
+  using Fl_Table::col_scroll_position;
+  using Fl_Table::table_scrolled;
+  using Fl_Table::toprow;
+  using Fl_Table::botrow;
+  using Fl_Table::leftcol;
+  using Fl_Table::rightcol;
+  using Fl_Table::table_h;
+  using Fl_Table::tih;
+  using Fl_Table::tiw;
+  using Fl_Table::tox;
+  using Fl_Table::toy;
+  using Fl_Table::tow;
+  using Fl_Table::toh;
+  using Fl_Table::vscrollbar;
+  using Fl_Table::hscrollbar;
+};
+
+static unsigned seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)n);
+}
+
+// Finds the first and last visible row or column like Fl_Table did
+// before it had an index, by summing the sizes from the start:
+static void ref_visible(const int *size, int n, int offset, int view,
+                        int &first, int &last) {
+  int i, pos = 0;
+  for (i = 0; i < n; i++) {
+    pos += size[i];
+    if (pos > offset) { pos -= size[i]; break; }
+  }
+  first = i >= n ? i - 1 : i;
+  for (; i < n; i++) {
+    pos += size[i];
+    if (pos >= offset + view) break;
+  }
+  last = i >= n ? i - 1 : i;
+}
+
+// Finds the context, row and column under the mouse by trying all
+// visible cells, returns the context:
+static int ref_cursor(Test_Table &t, int &row, int &col) {
+  int X, Y, W, H, r, c;
+  row = col = 0;
+  if (t.row_header()) {
+    t.get_bounds(Fl_Table::CONTEXT_ROW_HEADER, X, Y, W, H);
+    if (Fl::event_inside(X, Y, W, H)) {
+      for (r = t.toprow; r <= t.botrow; r++) {
+        t.find_cell(Fl_Table::CONTEXT_ROW_HEADER, r, 0, X, Y, W, H);
+        if (Fl::e_y >= Y && Fl::e_y < Y + H) {
+          row = r;
+          return Fl_Table::CONTEXT_ROW_HEADER;
+        }
+      }
+      return Fl_Table::CONTEXT_NONE;
+    }
+  }
+  if (t.col_header()) {
+    t.get_bounds(Fl_Table::CONTEXT_COL_HEADER, X, Y, W, H);
+    if (Fl::event_inside(X, Y, W, H)) {
+      for (c = t.leftcol; c <= t.rightcol; c++) {
+        t.find_cell(Fl_Table::CONTEXT_COL_HEADER, 0, c, X, Y, W, H);
+        if (Fl::e_x >= X && Fl::e_x < X + W) {
+          col = c;
+          return Fl_Table::CONTEXT_COL_HEADER;
+        }
+      }
+      return Fl_Table::CONTEXT_NONE;
+    }
+  }
+  if (!Fl::event_inside(t.tox, t.toy, t.tow, t.toh))
+    return Fl_Table::CONTEXT_NONE;
+  for (r = t.toprow; r <= t.botrow; r++) {
+    for (c = t.leftcol; c <= t.rightcol; c++) {
+      if (t.find_cell(Fl_Table::CONTEXT_CELL, r, c, X, Y, W, H)) continue;
+      if (Fl::event_inside(X, Y, W, H)) {
+        row = r;
+        col = c;
+        return Fl_Table::CONTEXT_CELL;
+      }
+    }
+  }
+  return Fl_Table::CONTEXT_TABLE;
+}
+
+int main(int argc, char **argv) {
+  int tables = argc > 1 ? atoi(argv[1]) : 300;
+  for (int it = 0; it < tables; it++) {
+    Test_Table t;
+    t.row_header(rnd(2));
+    t.col_header(rnd(2));
+    int R = rnd(200), C = rnd(50), i, k;
+    t.rows(R);
+    t.cols(C);
+    int *rh = new int[R + 1], *cw = new int[C + 1];
+    for (i = 0; i < R; i++) rh[i] = rnd(4) ? 5 + rnd(30) : rnd(2) * 3;
+    for (i = 0; i < C; i++) cw[i] = rnd(4) ? 5 + rnd(90) : 0;
+    if (rnd(2)) {
+      t.row_heights(0, R, rh);
+      t.col_widths(0, C, cw);
+    } else {
+      for (i = 0; i < R; i++) t.row_height(i, rh[i]);
+      for (i = 0; i < C; i++) t.col_width(i, cw[i]);
+    }
+    for (k = 0; k < 5; k++) {
+      if (R && rnd(2)) { i = rnd(R); rh[i] = rnd(40); t.row_height(i, rh[i]); }
+      if (C && rnd(2)) { i = rnd(C); cw[i] = rnd(100); t.col_width(i, cw[i]); }
+    }
+
+    long pos = 0;
+    for (i = 0; i <= R; i++) {
+      if (t.row_scroll_position(i) != pos) {
+        printf("table %d: row %d at %ld, expected %ld\n",
+               it, i, t.row_scroll_position(i), pos);
+        return 1;
+      }
+      if (i < R) pos += rh[i];
+    }
+    if (t.table_h != pos) {
+      printf("table %d: height %d, expected %ld\n", it, t.table_h, pos);
+      return 1;
+    }
+    pos = 0;
+    for (i = 0; i <= C; i++) {
+      if (t.col_scroll_position(i) != pos) {
+        printf("table %d: column %d at %ld, expected %ld\n",
+               it, i, t.col_scroll_position(i), pos);
+        return 1;
+      }
+      if (i < C) pos += cw[i];
+    }
+
+    for (k = 0; k < 20; k++) {
+      int vmax = (int)t.vscrollbar->maximum(), hmax = (int)t.hscrollbar->maximum();
+      ((Fl_Valuator *)t.vscrollbar)->value(vmax > 0 ? rnd(vmax + 1) : 0);
+      ((Fl_Valuator *)t.hscrollbar)->value(hmax > 0 ? rnd(hmax + 1) : 0);
+      t.table_scrolled();
+      int top, bot, left, right;
+      ref_visible(rh, R, (int)t.vscrollbar->value(), t.tih, top, bot);
+      ref_visible(cw, C, (int)t.hscrollbar->value(), t.tiw, left, right);
+      if (t.toprow != top || t.botrow != bot ||
+          t.leftcol != left || t.rightcol != right) {
+        printf("table %d: rows %d-%d, columns %d-%d visible, "
+               "expected rows %d-%d, columns %d-%d\n", it,
+               t.toprow, t.botrow, t.leftcol, t.rightcol, top, bot, left, right);
+        return 1;
+      }
+      for (int m = 0; m < 30; m++) {
+        Fl::e_x = rnd(420) - 10;
+        Fl::e_y = rnd(320) - 10;
+        int r, c, er, ec;
+        Test_Table::ResizeFlag flag;
+        int ctx = t.cursor2rowcol(r, c, flag);
+        int ectx = ref_cursor(t, er, ec);
+        if (ctx != ectx || (ctx != Fl_Table::CONTEXT_NONE &&
+                            ctx != Fl_Table::CONTEXT_TABLE &&
+                            (r != er || c != ec))) {
+          printf("table %d: mouse at %d,%d finds context %d, row %d, column %d, "
+                 "expected context %d, row %d, column %d\n",
+                 it, Fl::e_x, Fl::e_y, ctx, r, c, ectx, er, ec);
+          return 1;
+        }
+      }
+    }
+    delete[] rh;
+    delete[] cw;
+  }
+  printf("ok, %d tables\n", tables);
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
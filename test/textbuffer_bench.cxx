@@ -0,0 +1,108 @@
+//
+// "$Id$"
+//
+// Fl_Text_Buffer storage benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Compares the GAP_BUFFER and PIECE_TABLE storage modes of Fl_Text_Buffer
+// for random edits in a large buffer. This is a command line program.
+//
+// Usage: textbuffer_bench [megabytes [edits]]
+
+#include <FL/Fl_Text_Buffer.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static unsigned seed;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)(n > 0 ? n : 1));
+}
+
+static double seconds(clock_t t) {
+  return (double)(clock() - t) / CLOCKS_PER_SEC;
+}
+
+static char *run(int mode, const char *text, int edits) {
+  Fl_Text_Buffer buf;
+  buf.canUndo(0);
+  buf.storage(mode);
+  const char *name = mode == Fl_Text_Buffer::PIECE_TABLE ? "piece table" : "gap buffer ";
+
+  clock_t t = clock();
+  buf.text(text);
+  printf("%s  load      %8.3f s\n", name, seconds(t));
+
+  seed = 1;
+  t = clock();
+  for (int i = 0; i < edits; i++) {
+    int pos = rnd(buf.length());
+    if (rnd(3) == 0) {
+      buf.remove(pos, pos + rnd(64));
+    } else {
+      buf.insert(pos, "inserted text\n");
+    }
+  }
+  printf("%s  %d edits %8.3f s\n", name, edits, seconds(t));
+
+  t = clock();
+  int lines = buf.count_lines(0, buf.length());
+  printf("%s  %d lines %8.3f s\n", name, lines, seconds(t));
+
+  t = clock();
+  int check = 0;
+  for (int i = 0; i < edits; i++) {
+    int pos = rnd(buf.length());
+    check += buf.skip_lines(pos, rnd(1000)) - buf.rewind_lines(pos, rnd(1000));
+  }
+  printf("%s  %d skip/rewind %8.3f s\n", name, edits, seconds(t));
+  if (check == 1) printf("\n");   // keep the loop from being optimized away
+
+  t = clock();
+  char *result = buf.text();
+  printf("%s  text()    %8.3f s\n", name, seconds(t));
+  return result;
+}
+
+int main(int argc, char **argv) {
+  int mb = argc > 1 ? atoi(argv[1]) : 32;
+  int edits = argc > 2 ? atoi(argv[2]) : 20000;
+  if (mb < 1) mb = 1;
+
+  // ASCII text with lines of 80 characters
+  int size = mb * 1024 * 1024;
+  char *text = (char *)malloc(size + 1);
+  for (int i = 0; i < size; i++)
+    text[i] = (i % 81 == 80) ? '\n' : (char)('a' + i % 26);
+  text[size] = 0;
+
+  printf("%d MB, %d random edits\n", mb, edits);
+  char *gap = run(Fl_Text_Buffer::GAP_BUFFER, text, edits);
+  char *pieces = run(Fl_Text_Buffer::PIECE_TABLE, text, edits);
+  int same = !strcmp(gap, pieces);
+  printf("results %s\n", same ? "match" : "DIFFER");
+
+  free(gap);
+  free(pieces);
+  free(text);
+  return same ? 0 : 1;
+}
+
+//
+// End of "$Id$".
+//
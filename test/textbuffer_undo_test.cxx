@@ -0,0 +1,162 @@
+//
+// "$Id$"
+//
+// Fl_Text_Buffer undo test program for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Maps random files with CP1252 characters and nul bytes into
+// Fl_Text_Buffers with mapfile(), makes random edits, undos and redos
+// before and after the idle callback transcodes the text, and checks that
+// undoing all edits gives the transcoded file and redoing them gives the
+// edited text again. It also undoes and redoes the removal of text that
+// still contains a nul byte. It needs no display and opens no window.
+//
+// Usage: textbuffer_undo_test [files]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Text_Buffer.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)n);
+}
+
+static const char *file_name = "textbuffer_undo_test.txt";
+
+static void write_file(const char *text, int len) {
+  FILE *fp = fopen(file_name, "wb");
+  if (!fp || fwrite(text, 1, len, fp) != (size_t)len) {
+    perror(file_name);
+    exit(1);
+  }
+  fclose(fp);
+}
+
+// Returns 1 if the buffer holds exactly len bytes of text:
+static int same_text(Fl_Text_Buffer &b, const char *text, int len) {
+  if (b.length() != len) return 0;
+  for (int i = 0; i < len; i++)
+    if (b.byte_at(i) != text[i]) return 0;
+  return 1;
+}
+
+// Returns 1 if the bytes from start to end are ASCII characters other
+// than nul, which the test may remove without removing bytes that are
+// transcoded later:
+static int plain(Fl_Text_Buffer &b, int start, int end) {
+  for (int i = start; i < end; i++)
+    if (!b.byte_at(i) || (b.byte_at(i) & 0x80)) return 0;
+  return 1;
+}
+
+static int nul_test() {
+  static const char text[] = "ab\0cd\n";
+  write_file(text, 6);
+  Fl_Text_Buffer b;
+  b.transcoding_warning_action = 0;
+  b.mapfile(file_name);
+  b.remove(0, 6);
+  if (!b.undo(0) || !same_text(b, text, 6)) {
+    printf("undoing the removal of a nul byte failed\n");
+    return 1;
+  }
+  if (!b.redo(0) || b.length() != 0) {
+    printf("redoing the removal of a nul byte failed\n");
+    return 1;
+  }
+  b.undo(0);
+  Fl::check();        // transcodes the text
+  if (!same_text(b, "ab cd\n", 6)) {
+    printf("the nul byte was not replaced by a space\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int files = argc > 1 ? atoi(argv[1]) : 400;
+  if (nul_test()) return 1;
+
+  for (int it = 0; it < files; it++) {
+    // the file, and what it looks like when transcoded
+    int nlines = 1 + rnd(300), len = 0, tlen = 0, i;
+    char *text = (char *)malloc(nlines * 32), *utf8 = (char *)malloc(nlines * 32);
+    for (i = 0; i < nlines; i++) {
+      const char *word = "ok", *tword = "ok";
+      int k = rnd(20), wlen = 2;
+      if (k == 0) { word = "caf\xe9"; tword = "caf\xc3\xa9"; wlen = 4; }
+      if (k == 1) { word = "a\0b"; tword = "a b"; wlen = 3; }
+      len += sprintf(text + len, "line %d ", i);
+      memcpy(text + len, word, wlen);
+      len += wlen;
+      text[len++] = '\n';
+      tlen += sprintf(utf8 + tlen, "line %d %s\n", i, tword);
+    }
+    write_file(text, len);
+
+    Fl_Text_Buffer b;
+    b.transcoding_warning_action = 0;
+    b.mapfile(file_name);
+    int edits = 0;
+    while (edits < 40) {
+      if (edits == 20) Fl::check();   // transcodes the text
+      if (rnd(2)) {
+        int pos = rnd(b.length() + 1);
+        if ((pos < b.length() && (b.byte_at(pos) & 0x80)) ||
+            (pos > 0 && (b.byte_at(pos - 1) & 0x80)))
+          continue;
+        b.insert(pos, rnd(2) ? "abc" : "x\ny");
+      } else {
+        int start = rnd(b.length() + 1), end = start + rnd(20);
+        if (end > b.length()) end = b.length();
+        if (!plain(b, start, end) ||
+            (start > 0 && (b.byte_at(start - 1) & 0x80)))
+          continue;
+        b.remove(start, end);
+      }
+      edits++;
+      if (!rnd(7)) b.undo(0);
+      if (!rnd(9)) b.redo(0);
+    }
+    while (b.redo(0)) { }
+    char *edited = b.text();
+    int elen = b.length();
+    while (b.undo(0)) { }
+    if (!same_text(b, utf8, tlen)) {
+      printf("file %d: undoing all edits does not give the transcoded file\n", it);
+      return 1;
+    }
+    while (b.redo(0)) { }
+    if (!same_text(b, edited, elen)) {
+      printf("file %d: redoing all edits does not give the edited text\n", it);
+      return 1;
+    }
+    free(edited);
+    free(text);
+    free(utf8);
+  }
+  remove(file_name);
+  printf("ok, %d files\n", files);
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,123 @@
+//
+// "$Id$"
+//
+// Timeout scheduling benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2019 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Adds, queries and removes many timeouts and then runs them as repeating
+// timers, the way many animated widgets would. This is a command line
+// program that does not open a window.
+//
+// Usage: timeout_bench [timers [repeats]]
+
+#include <FL/Fl.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static unsigned seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (unsigned)(n > 0 ? n : 1));
+}
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+struct Timer {
+  double interval;
+  double due;
+  int left;
+};
+
+static int running;
+static double late_sum, late_max;
+static long calls;
+
+static void tick_cb(void *data) {
+  Timer *t = (Timer *)data;
+  double late = now() - t->due;
+  if (late < 0) late = 0;
+  late_sum += late;
+  if (late > late_max) late_max = late;
+  calls++;
+  if (--t->left > 0) {
+    t->due += t->interval;
+    Fl::repeat_timeout(t->interval, tick_cb, data);
+  } else {
+    running--;
+  }
+}
+
+static void unused_cb(void *) { }
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 10000;
+  int repeats = argc > 2 ? atoi(argv[2]) : 20;
+  if (n < 1) n = 1;
+  if (repeats < 1) repeats = 1;
+  Timer *timers = new Timer[n];
+  int i;
+
+  printf("%d timers\n", n);
+
+  double t = now();
+  for (i = 0; i < n; i++)
+    Fl::add_timeout(1 + rnd(1000) / 100.0, unused_cb, timers + i);
+  printf("add_timeout      %8.3f s\n", now() - t);
+
+  t = now();
+  int found = 0;
+  for (i = 0; i < n; i++)
+    found += Fl::has_timeout(unused_cb, timers + rnd(n));
+  printf("has_timeout      %8.3f s\n", now() - t);
+
+  t = now();
+  for (i = 0; i < n; i++)
+    Fl::remove_timeout(unused_cb, timers + i);
+  printf("remove_timeout   %8.3f s\n", now() - t);
+
+  // repeating timers with intervals from 10 to 50 ms, all started at once
+  for (i = 0; i < n; i++) {
+    timers[i].interval = (10 + rnd(41)) / 1000.0;
+    timers[i].left = repeats;
+  }
+  t = now();
+  for (i = 0; i < n; i++) {
+    timers[i].due = now() + timers[i].interval;
+    Fl::add_timeout(timers[i].interval, tick_cb, timers + i);
+  }
+  running = n;
+  int waits = 0;
+  while (running > 0) {
+    Fl::wait(1.0);
+    waits++;
+  }
+  t = now() - t;
+  printf("%ld callbacks in %.3f s, %d waits\n", calls, t, waits);
+  printf("late by          %8.3f ms average, %.3f ms max\n",
+         1000 * late_sum / calls, 1000 * late_max);
+
+  delete[] timers;
+  return found < 0;
+}
+
+//
+// End of "$Id$".
+//